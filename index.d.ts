@@ -1,6 +1,7 @@
 /// <reference types="node" />
 
 import {EventEmitter} from "events";
+import {Readable} from "stream";
 
 export enum DataType{
     BOOLEAN,
@@ -24,13 +25,174 @@ export enum DataType{
 }
 
 export namespace norc {
+    /**
+     * Column values as returned by Reader.readColumns.
+     * BOOLEAN, TINYINT, SMALLINT, INT and DATE (days since epoch) are Int32Array, BIGINT is BigInt64Array,
+     * FLOAT, DOUBLE and DECIMAL are Float64Array, TIMESTAMP is a Float64Array of epoch milliseconds.
+     * STRING, VARCHAR and CHAR are string arrays, BINARY is an array of Buffers.
+     * A 1 in nulls marks the value at that index as null.
+     */
+    export type ColumnData = {
+        values: Int32Array | BigInt64Array | Float64Array | Array<string | null> | Array<Buffer | null>
+        nulls: Uint8Array
+    }
+    /**
+     * A STRING, VARCHAR or CHAR column read with the dictionary option: every distinct value once in dictionary,
+     * and the position of the value of each row in it in indices (0 for a null).
+     */
+    export type DictionaryColumnData = {
+        dictionary: string[]
+        indices: Int32Array
+        nulls: Uint8Array
+    }
+    /**
+     * Column values as accepted by Writer.addColumns, the same layout Reader.readColumns returns.
+     * Integer columns take integer typed arrays (BigInt64Array holds any BIGINT losslessly), FLOAT, DOUBLE and DECIMAL
+     * any numeric typed array, DATE an Int32Array of days since epoch and TIMESTAMP a Float64Array of epoch milliseconds
+     * or a BigInt64Array of epoch nanoseconds. Arrays take the same values as Writer.add, null for a null value.
+     */
+    export type ColumnValues = Int8Array | Uint8Array | Int16Array | Uint16Array | Int32Array | Uint32Array | Float32Array |
+        Float64Array | BigInt64Array | BigUint64Array | Array<string | number | bigint | boolean | Date | Buffer | null>
+    /**
+     * A string column packed in the Arrow layout: the UTF-8 bytes of every value in data, value i runs from offsets[i]
+     * to offsets[i + 1]. Writer.addColumns copies the bytes of each batch in one block, instead of converting a JS string
+     * per value, so data can be reused once the call returns.
+     */
+    export type PackedStrings = {
+        data: Buffer | Uint8Array
+        offsets: Int32Array
+    }
+    export type PredicateValue = string | number | bigint | boolean
+    /**
+     * Comparisons of a single column, DATE and TIMESTAMP values are given in the same format they are read back as.
+     */
+    export type PredicateOps = {
+        eq?: PredicateValue
+        ne?: PredicateValue
+        lt?: PredicateValue
+        lte?: PredicateValue
+        gt?: PredicateValue
+        gte?: PredicateValue
+        in?: PredicateValue[]
+        between?: [PredicateValue, PredicateValue]
+        isNull?: boolean
+    }
+    /**
+     * Predicate on top level columns, all conditions of an object must hold. A value is shorthand for {eq: value}
+     * and null for {isNull: true}.
+     * Stripes and row groups (10,000 rows) whose statistics rule out a match are skipped without being decoded,
+     * the rows of the remaining row groups are filtered natively so only matching rows are returned. Columns of the
+     * predicate that are not in opts.columns are decoded to evaluate it but left out of the rows. A comparison with
+     * null never matches, not even under $not.
+     */
+    export type Where = {
+        $and?: Where[]
+        $or?: Where[]
+        $not?: Where
+        [column: string]: PredicateValue | PredicateOps | null | Where | Where[] | undefined
+    }
+    /**
+     * Statistics of a column, min and max have the type values of the column are read as. min, max and sum are only
+     * present when the writer recorded them (sum is left out once it overflows, strings have no sum).
+     */
+    export type ColumnStatistics = {
+        count: number
+        hasNull: boolean
+        min?: string | number | boolean
+        max?: string | number | boolean
+        sum?: number
+    }
+    export type AggregateOp = 'count' | 'sum' | 'min' | 'max' | 'avg'
+    /**
+     * Aggregates of the non null values of a column. sum, min, max and avg are null when there are none.
+     */
+    export type ColumnAggregate = {
+        count?: number
+        sum?: number | null
+        min?: string | number | boolean | null
+        max?: string | number | boolean | null
+        avg?: number | null
+    }
+    export type AggregateResult = {
+        // number of rows matching opts.where
+        rows: number
+        columns: {[column: string]: ColumnAggregate}
+    }
+    export type GroupByResult = {
+        // values of the key columns shared by the rows of the group, null for null values
+        keys: ORC_ROW
+        // number of rows of the group matching opts.where
+        rows: number
+        columns: {[column: string]: ColumnAggregate}
+    }[]
+    /**
+     * Data quality figures of a column. distinct is an approximate count (HyperLogLog), quantiles are approximate
+     * (KLL) and listed in the order of opts.quantiles, dates are formatted as strings. Quantiles are only computed for
+     * numbers and dates, lengths only for strings and binaries.
+     */
+    export type ColumnProfile = {
+        nulls: number
+        nullRatio: number | null
+        distinct?: number
+        quantiles?: (number | string)[] | null
+        minLength?: number | null
+        maxLength?: number | null
+        avgLength?: number | null
+    }
+    export type ProfileResult = {
+        // number of rows matching opts.where
+        rows: number
+        columns: {[column: string]: ColumnProfile}
+    }
+    export type FileStatistics = {
+        rows: number
+        columns: {[column: string]: ColumnStatistics}
+    }
+    export type StripeStatistics = FileStatistics & {
+        stripe: number
+        firstRow: number
+        offset: number
+        length: number
+    }
+    export type RowGroupStatistics = FileStatistics & {
+        stripe: number
+        rowGroup: number
+        firstRow: number
+    }
+    export type StripeInformation = {
+        index: number
+        offset: number
+        length: number
+        indexLength: number
+        dataLength: number
+        footerLength: number
+        firstRow: number
+        rows: number
+    }
     export class Reader extends EventEmitter {
         readonly type: string
         readonly writeVersion: string
         readonly formatVersion: string
         readonly compressions: string
 
-        constructor(input: string|Buffer)
+        /**
+         * @param input - path of a local file, or the contents of a file. In memory contents are read in place and kept
+         * alive for the lifetime of the reader, ArrayBuffer, SharedArrayBuffer and typed array inputs are not copied.
+         * The tails (postscript and footer) of opened files are cached by path, modification time and size, opening the
+         * same file again does not read its tail from disk, the cached copy is still parsed. The stripe statistics (file
+         * metadata) are not part of the tail, they are read from the file when first needed.
+         * Local files are memory mapped and must not be modified in place while a reader is open: reads from a file
+         * whose size changed fail with an error, but one truncated during a read can crash the process. Replace files
+         * by writing a new file and renaming it instead.
+         * @param opts.tail - the serializedTail() of the same file, the footer is not read from the input at all
+         */
+        constructor(input: string|Buffer|ArrayBuffer|SharedArrayBuffer|ArrayBufferView, opts?: {tail?: Buffer})
+
+        /**
+         * Byte budget of the process wide tail cache (32MB by default), least recently used tails are evicted first.
+         */
+        static setTailCacheSize(bytes: number): void
+        static clearTailCache(): void
 
         /**
          * Read all contents into memory and emit on Reader.on('data', (data:string) => void): void
@@ -43,33 +205,202 @@ export namespace norc {
         /**
          * Read only columns defined in opts.columns, get contents back as either an event(data:string) or an array iterator
          * The iterator will return the contents as an object, whereas the event will return a string which will subsequently need to be JSON parse(d).
-         * The event is more performant, but the iterator offers more control.
+         * Events are emitted as soon as each batch of opts.chunkSize rows (default 1024) is decoded, so memory use
+         * stays at a few batches regardless of the file size.
+         * The iterator is only returned once the whole file has been read.
+         * With opts.parallel the stripes are split into that many ranges (true for one per core), each decoded on its own
+         * thread. Events are emitted in file order unless opts.ordered is false, in which case a chunk is emitted as soon
+         * as it is decoded.
+         * opts.offset (a row number of the file) seeks straight to the row group holding that row and decoding stops once
+         * opts.limit rows were read, a read with either option always runs on a single thread. With opts.where, offset
+         * and limit count matching rows instead.
          * @param opts
          * @param cb
          */
-        read(opts: {resultType?: 'iterator'|'event', columns?: string[]}, cb?:(err:Error, data: Iterator<object>|null) => void): void
+        read(opts: {resultType?: 'iterator'|'event', columns?: string[], chunkSize?: number, where?: Where, parallel?: number|boolean, ordered?: boolean, offset?: number, limit?: number}, cb?:(err:Error, data: Iterator<object>|null) => void): void
+
+        /**
+         * Read the selected columns into typed arrays, skipping the row object conversion entirely.
+         * opts.parallel decodes ranges of stripes on that many threads (true for one per core).
+         * opts.dictionary returns string columns as DictionaryColumnData, each distinct value is a single string.
+         * If no callback is provided a promise is returned.
+         * @param opts
+         * @param cb
+         */
+        readColumns(opts: {columns?: string[], where?: Where, parallel?: number|boolean, offset?: number, limit?: number, dictionary: true}, cb: (err: Error, data: {[column: string]: ColumnData | DictionaryColumnData}) => void): void
+        readColumns(opts: {columns?: string[], where?: Where, parallel?: number|boolean, offset?: number, limit?: number, dictionary: true}): Promise<{[column: string]: ColumnData | DictionaryColumnData}>
+        readColumns(opts: {columns?: string[], where?: Where, parallel?: number|boolean, offset?: number, limit?: number}, cb: (err: Error, data: {[column: string]: ColumnData}) => void): void
+        readColumns(opts?: {columns?: string[], where?: Where, parallel?: number|boolean, offset?: number, limit?: number}): Promise<{[column: string]: ColumnData}>
+
+        /**
+         * Create an object mode Readable of rows. A batch of opts.chunkSize rows (default 1024) is only decoded when
+         * the stream is read from, a slow consumer will pause decoding.
+         * @param opts
+         */
+        createReadStream(opts?: {columns?: string[], chunkSize?: number, where?: Where, offset?: number, limit?: number}): Readable
+
+        /**
+         * Open a cursor over the file, rows are decoded one batch of opts.chunkSize rows (default 1024) at a time
+         * as they are pulled.
+         * @param opts
+         */
+        cursor(opts?: {columns?: string[], chunkSize?: number, where?: Where, offset?: number, limit?: number}): Cursor
+
+        /**
+         * Rows whose column equals one of values. Only the row groups that may contain a value are decoded, they are
+         * found with the bloom filters of the column (see Writer.schema) or the row index when the file has none.
+         * The key column is part of the rows even if opts.columns leaves it out.
+         * If no callback is provided a promise is returned.
+         */
+        lookup(column: string, values: PredicateValue[], opts?: {columns?: string[]}): Promise<ORC_ROW[]>
+        lookup(column: string, values: PredicateValue[], opts: {columns?: string[]}, cb: (err: Error, rows: ORC_ROW[]) => void): void
 
         columnStatistics(column:string): string
+
+        /**
+         * Position, size and row count of every stripe, taken from the file footer.
+         */
+        stripes(): StripeInformation[]
+
+        /**
+         * Typed statistics of opts.columns (all columns by default) for the whole file, every stripe, or every row group
+         * of every stripe. Row group statistics read the row index of each stripe.
+         * If no callback is provided a promise is returned.
+         */
+        statistics(opts?: {level?: 'file', columns?: string[]}): Promise<FileStatistics>
+        statistics(opts: {level: 'stripe', columns?: string[]}): Promise<StripeStatistics[]>
+        statistics(opts: {level: 'rowGroup', columns?: string[]}): Promise<RowGroupStatistics[]>
+        statistics(opts: {level?: 'file'|'stripe'|'rowGroup', columns?: string[]}, cb: (err: Error, data: FileStatistics|StripeStatistics[]|RowGroupStatistics[]) => void): void
+
+        /**
+         * Compute opts.ops (all by default) over opts.columns (every column they apply to by default) of the rows
+         * matching opts.where, without handing rows to JS. sum and avg apply to numbers and booleans, min and max to
+         * everything but binary columns. Stripes the statistics of the file answer are not decoded.
+         * If no callback is provided a promise is returned.
+         */
+        aggregate(opts?: {columns?: string[], ops?: AggregateOp[], where?: Where, parallel?: number|boolean, chunkSize?: number}): Promise<AggregateResult>
+        aggregate(opts: {columns?: string[], ops?: AggregateOp[], where?: Where, parallel?: number|boolean, chunkSize?: number}, cb: (err: Error, data: AggregateResult) => void): void
+
+        /**
+         * Compute opts.aggs for every distinct combination of values of opts.keys among the rows matching opts.where,
+         * without handing rows to JS. Rows are grouped natively in a hash table, string keys are interned straight
+         * from the decoded batches. sum and avg apply to numbers and booleans, min and max also to dates, other
+         * columns are counted only. Groups are listed in the order they are first seen.
+         * If no callback is provided a promise is returned.
+         */
+        groupBy(opts: {keys: string[], aggs?: {[column: string]: AggregateOp[]}, where?: Where, parallel?: number|boolean, chunkSize?: number}): Promise<GroupByResult>
+        groupBy(opts: {keys: string[], aggs?: {[column: string]: AggregateOp[]}, where?: Where, parallel?: number|boolean, chunkSize?: number}, cb: (err: Error, data: GroupByResult) => void): void
+
+        /**
+         * The opts.k first rows matching opts.where ordered by opts.column, 'desc' (the default) for the highest values
+         * first, 'asc' for the lowest. Equal values keep file order, null and NaN values are left out. Only the ordered
+         * column is decoded to rank the rows, opts.columns (all by default) are then decoded for the k rows alone.
+         * If no callback is provided a promise is returned.
+         */
+        topK(opts: {column: string, k: number, order?: 'asc'|'desc', columns?: string[], where?: Where, parallel?: number|boolean, chunkSize?: number}): Promise<ORC_ROW[]>
+        topK(opts: {column: string, k: number, order?: 'asc'|'desc', columns?: string[], where?: Where, parallel?: number|boolean, chunkSize?: number}, cb: (err: Error, data: ORC_ROW[]) => void): void
+
+        /**
+         * Profile opts.columns (all by default) in a single native pass over the rows matching opts.where. Accepts the
+         * column titles alone in place of opts. opts.quantiles are the ranks to estimate, [0, 0.25, 0.5, 0.75, 1] by
+         * default. If no callback is provided a promise is returned.
+         */
+        profile(opts?: string[] | {columns?: string[], quantiles?: number[], where?: Where, parallel?: number|boolean, chunkSize?: number}): Promise<ProfileResult>
+        profile(opts: string[] | {columns?: string[], quantiles?: number[], where?: Where, parallel?: number|boolean, chunkSize?: number}, cb: (err: Error, data: ProfileResult) => void): void
+
+        /**
+         * The serialized postscript and footer of the file (not the stripe statistics), can be persisted and passed back as
+         * opts.tail
+         */
+        serializedTail(): Buffer
+    }
+    export interface Cursor extends AsyncIterable<ORC_ROW> {
+        /**
+         * Decode the next batch of rows, resolves to null once the file is exhausted.
+         */
+        nextBatch(): Promise<ORC_ROW[] | null>
+        /**
+         * Release the underlying row reader, called automatically when a for await loop exits.
+         */
+        close(): void
     }
-    export type ORC_ROW = {[key: string]: string|boolean|number|null}
+    export type ORC_ROW = {[key: string]: string|boolean|number|Buffer|null}
+    export type JoinOptions = {
+        // key columns, with the same titles on both sides
+        on: string | string[]
+        // 'left' keeps the left rows without a match, with nulls for the right columns
+        type?: 'inner' | 'left'
+        // joined columns, looked up on the left side first (all left columns and the non key right columns by default)
+        columns?: string[]
+        // 'columns' returns typed columns like Reader.readColumns instead of row objects
+        resultType?: 'rows' | 'columns'
+        parallel?: number | boolean
+        chunkSize?: number
+    }
+    /**
+     * Hash join of two files. The file with fewer rows is decoded into a native hash table of its key and joined
+     * columns, the other one is streamed batch by batch and probes it, so neither side is turned into JS rows. Rows
+     * are listed in the order of the streamed side, unmatched left rows of a left join held in the table come last.
+     * If no callback is provided a promise is returned.
+     */
+    export function join(left: Reader, right: Reader, opts: JoinOptions & {resultType?: 'rows'}): Promise<ORC_ROW[]>
+    export function join(left: Reader, right: Reader, opts: JoinOptions & {resultType: 'columns'}): Promise<{[column: string]: ColumnData}>
+    export function join(left: Reader, right: Reader, opts: JoinOptions, cb: (err: Error, data: ORC_ROW[] | {[column: string]: ColumnData}) => void): void
     export class Writer {
         constructor(output?: string)
         fromCsv(file: string, cb: (err: Error, norc: Writer) => void): void
-        schema(v: {[key:string]: DataType}|string): void
         /**
-         * Add a single entry (struct) to the file
+         * @param v - the schema
+         * @param opts.bloomFilter - columns to write bloom filters for, used by Reader.lookup to skip row groups
+         * @param opts.bloomFilterFpp - false positive probability of the bloom filters (0.05 by default)
+         */
+        schema(v: {[key:string]: DataType}|string, opts?: {bloomFilter?: string[], bloomFilterFpp?: number}): void
+        /**
+         * Add a single entry (struct) to the file. A column set to null or undefined is written as null, a column the
+         * object does not have throws a TypeError naming it. Keys that are not columns are ignored.
          * @param row - struct
          */
         add(row: ORC_ROW): void
         /**
          * Add a collection of structs to the file.
-         * This is the preferred method of adding data to a file.
+         * This is the preferred method of adding data to a file. Rows are checked as with add(row). On a value a
+         * column cannot hold or a missing column, the rows before it are added and a TypeError naming the column is
+         * thrown, as with addRows and addColumns.
          */
         add(rows: ORC_ROW[]): void
         /**
-         * Close the file stream.
+         * Add a row given as its values in schema order, without property lookups.
          */
-        close(): void
+        addRow(values: Array<string|boolean|number|Buffer|null>): void
+        /**
+         * Add rows given as their values in schema order. On a value a column cannot hold, the rows before it are
+         * added and a TypeError naming the column is thrown.
+         */
+        addRows(rows: Array<Array<string|boolean|number|Buffer|null>>): void
+        /**
+         * Add whole columns at once, every column of the schema with the same number of values. Typed arrays are
+         * copied into the batches in bulk, without a JS object per row.
+         * @param columns - values by column title, STRING, VARCHAR, CHAR and BINARY columns can be PackedStrings
+         * @param opts.nulls - a Uint8Array per column, 1 marks a null row (as returned by Reader.readColumns)
+         * @throws TypeError on a value a column cannot hold, once the rows before it were added
+         */
+        addColumns(columns: {[column: string]: ColumnValues | PackedStrings}, opts?: {nulls?: {[column: string]: Uint8Array}}): void
+        /**
+         * Resolves once every row added so far was encoded. Full batches are encoded on a background thread while
+         * the next ones are filled, flush also queues the rows of a batch that is not full yet.
+         */
+        flush(): Promise<void>
+        flush(cb: (err: Error) => void): void
+        /**
+         * Encode the remaining rows and close the file stream, without blocking the event loop. From the call on,
+         * adding rows, flushing or closing again throws, even before the returned promise resolves.
+         */
+        close(): Promise<void>
+        close(cb: (err: Error) => void): void
+        /**
+         * Close the file stream, blocks until every row was encoded.
+         */
+        closeSync(): void
 
         /**
          * This method is memory intensive as the conditional (if defined) will call back into the JS runtime to execute
@@ -79,9 +410,9 @@ export namespace norc {
          * @param condition
          * @todo update to execute in seperate thread.
          */
-        merge(file: string|Buffer, condition?: (r: ORC_ROW) => boolean): void
+        merge(file: string|Buffer|ArrayBuffer|SharedArrayBuffer|ArrayBufferView, condition?: (r: ORC_ROW) => boolean): void
         /**
-         * If the file is writing to a buffer, retrieve the buffer, must be called after a call to close
+         * If the file is writing to a buffer, retrieve the buffer, must be called once close resolved
          */
         data(): Buffer
     }
@@ -1,10 +1,36 @@
-const {Reader: InternalReader, Writer}= require('bindings')('norc')
+const {Reader: InternalReader, Writer: InternalWriter}= require('bindings')('norc')
 const {EventEmitter} = require('events')
+const {Readable} = require('stream')
 const {inherits} = require('util')
 inherits(InternalReader, EventEmitter)
+/**
+ * Invoke fn with a node style callback, when cb is not a function a promise
+ * is returned instead.
+ */
+function callbackOrPromise(cb, fn) {
+    if (typeof(cb) === 'function') {
+        fn(cb)
+        return
+    }
+    return new Promise((resolve, reject) => fn((err, data) => err ? reject(err) : resolve(data)))
+}
+/**
+ * ArrayBuffer, SharedArrayBuffer and typed array inputs are passed to the
+ * native side as a Buffer view over the same memory, without a copy.
+ */
+function toBuffer(input) {
+    if (input instanceof ArrayBuffer ||
+        (typeof(SharedArrayBuffer) !== 'undefined' && input instanceof SharedArrayBuffer)) {
+        return Buffer.from(input)
+    }
+    if (ArrayBuffer.isView(input) && !Buffer.isBuffer(input)) {
+        return Buffer.from(input.buffer, input.byteOffset, input.byteLength)
+    }
+    return input
+}
 class Reader extends InternalReader {
-    constructor(input) {
-        super(input)
+    constructor(input, opts) {
+        super(toBuffer(input), opts)
     }
     read(opts, cb) {
         if(!opts && !cb) {
@@ -18,10 +44,117 @@ class Reader extends InternalReader {
             super.read(Object.assign(opts, {resultType: 'iterator'}), cb)
         }
     }
+    readColumns(opts, cb) {
+        if (typeof(opts) === 'function') {
+            cb = opts
+            opts = {}
+        }
+        return callbackOrPromise(cb, done => super.readColumns(opts || {}, done))
+    }
+    statistics(opts, cb) {
+        if (typeof(opts) === 'function') {
+            cb = opts
+            opts = {}
+        }
+        return callbackOrPromise(cb, done => super.statistics(opts || {}, done))
+    }
+    aggregate(opts, cb) {
+        if (typeof(opts) === 'function') {
+            cb = opts
+            opts = {}
+        }
+        return callbackOrPromise(cb, done => super.aggregate(opts || {}, done))
+    }
+    groupBy(opts, cb) {
+        return callbackOrPromise(cb, done => super.groupBy(opts, done))
+    }
+    topK(opts, cb) {
+        return callbackOrPromise(cb, done => super.topK(opts, done))
+    }
+    profile(opts, cb) {
+        if (typeof(opts) === 'function') {
+            cb = opts
+            opts = {}
+        }
+        if (Array.isArray(opts)) {
+            opts = {columns: opts}
+        }
+        return callbackOrPromise(cb, done => super.profile(opts || {}, done))
+    }
+    lookup(column, values, opts, cb) {
+        if (typeof(opts) === 'function') {
+            cb = opts
+            opts = {}
+        }
+        return callbackOrPromise(cb, done => super.lookup(column, values, opts || {}, done))
+    }
+    cursor(opts) {
+        return new Cursor(super.cursor(opts || {}))
+    }
+    createReadStream(opts) {
+        const cursor = this.cursor(opts)
+        return new Readable({
+            objectMode: true,
+            read() {
+                // only decode the next batch once the consumer asks for more
+                cursor.nextBatch().then(rows => {
+                    if (!rows) {
+                        return this.push(null)
+                    }
+                    for (let i = 0; i < rows.length; i++) {
+                        this.push(rows[i])
+                    }
+                }, err => this.destroy(err))
+            },
+            destroy(err, cb) {
+                cursor.close()
+                cb(err)
+            }
+        })
+    }
+}
+/**
+ * Pull based reader, every call to nextBatch decodes a single batch of rows.
+ */
+class Cursor {
+    constructor(native) {
+        this.native = native
+    }
+    nextBatch() {
+        return callbackOrPromise(null, done => this.native.next(done))
+    }
+    close() {
+        this.native.close()
+    }
+    async *[Symbol.asyncIterator]() {
+        try {
+            let rows
+            while ((rows = await this.nextBatch()) !== null) {
+                yield* rows
+            }
+        } finally {
+            // release the row reader when the loop exits early
+            this.close()
+        }
+    }
+}
+class Writer extends InternalWriter {
+    flush(cb) {
+        return callbackOrPromise(cb, done => super.flush(done))
+    }
+    close(cb) {
+        return callbackOrPromise(cb, done => super.close(done))
+    }
+    merge(input, condition) {
+        return super.merge(toBuffer(input), condition)
+    }
 }
 let exp = {}
 exp.Reader = Reader
 exp.Writer = Writer
+exp.join = function join(left, right, opts, cb) {
+    return callbackOrPromise(cb, done => InternalReader.join(left, right, opts || {}, done))
+}
 exports.norc = exp
 
 Object.defineProperty(exports, "__esModule", {value: true})
@@ -36,6 +36,23 @@ export class ReaderSpec {
         })
     }
 
+    @AsyncTest("Read in chunks of rows")
+    public async readerChunks() {
+        let total = 0
+        await new Promise((resolve, reject) => {
+            const reader = new norc.Reader(join(__dirname, './test_files/test_data.orc'))
+            reader.on('data', chunk => {
+                chunk = JSON.parse(chunk)
+                Expect(chunk.length).toBeLessThan(101)
+                total += chunk.length
+            })
+            reader.on('error', reject)
+            reader.on('end', resolve)
+            reader.read({chunkSize: 100})
+        })
+        Expect(total).toEqual(this.eventLength)
+    }
+
     @AsyncTest("Read all into iterator")
     public async readerIterator() {
         await new Promise((resolve, reject) => {
@@ -128,6 +145,486 @@ export class ReaderSpec {
         })
     }
 
+    @AsyncTest("Read selected columns into typed arrays")
+    public async readColumns() {
+        const data = await (this.subject as Reader).readColumns({columns: ['LoanTermMonths', 'APR', 'State']})
+        Expect(Object.keys(data).length).toEqual(3)
+        Expect(data.LoanTermMonths.values instanceof Int32Array).toBeTruthy()
+        Expect(data.APR.values instanceof Float64Array).toBeTruthy()
+        Expect(Array.isArray(data.State.values)).toBeTruthy()
+        Expect(data.APR.values.length).toEqual(this.iteratorLength)
+        Expect(data.APR.nulls.length).toEqual(data.APR.values.length)
+    }
+
+    @AsyncTest("Read a page with offset and limit")
+    public async readPage() {
+        const all = await (this.subject as Reader).readColumns({columns: ['LoanId']})
+        const page = await (this.subject as Reader).readColumns({columns: ['LoanId'], offset: 1500, limit: 25})
+        Expect(page.LoanId.values).toEqual((all.LoanId.values as string[]).slice(1500, 1525))
+        const cursor = (this.subject as Reader).cursor({columns: ['LoanId'], offset: 10, limit: 15, chunkSize: 10})
+        const rows: norc.ORC_ROW[] = []
+        for await (const row of cursor) {
+            rows.push(row)
+        }
+        Expect(rows.map(row => row.LoanId)).toEqual((all.LoanId.values as string[]).slice(10, 25))
+        const past = await (this.subject as Reader).readColumns({columns: ['LoanId'], offset: all.LoanId.values.length})
+        Expect(past.LoanId.values.length).toEqual(0)
+    }
+
+    @AsyncTest("Read stripes in parallel")
+    public async readParallel() {
+        const serial = await (this.subject as Reader).readColumns({columns: ['LoanId', 'APR']})
+        const parallel = await (this.subject as Reader).readColumns({columns: ['LoanId', 'APR'], parallel: 4})
+        Expect(parallel.LoanId.values).toEqual(serial.LoanId.values)
+        Expect(Array.from(parallel.APR.values as Float64Array)).toEqual(Array.from(serial.APR.values as Float64Array))
+        let total = 0
+        await new Promise((resolve, reject) => {
+            const reader = new norc.Reader(join(__dirname, './test_files/test_data.orc'))
+            reader.on('data', chunk => total += JSON.parse(chunk).length)
+            reader.on('error', reject)
+            reader.on('end', resolve)
+            reader.read({parallel: true, ordered: false, chunkSize: 500})
+        })
+        Expect(total).toEqual(this.iteratorLength)
+    }
+
+    @AsyncTest("Read with where skips row groups")
+    public async readWhere() {
+        const none = await (this.subject as Reader).readColumns({
+            columns: ['QualifyingFICO'],
+            where: {QualifyingFICO: {gt: 100000}}
+        })
+        Expect(none.QualifyingFICO.values.length).toEqual(0)
+        const tx = await (this.subject as Reader).readColumns({
+            columns: ['State'],
+            where: {$or: [{State: 'TX'}, {State: {in: ['CA', 'NV']}}]}
+        })
+        Expect(tx.State.values.length).toBeGreaterThan(0)
+        Expect((tx.State.values as string[]).includes('TX')).toBeTruthy()
+    }
+
+    @AsyncTest("Read with where returns matching rows only")
+    public async readWhereExact() {
+        const reader = this.subject as Reader
+        const all = await reader.readColumns({columns: ['State', 'LoanTermMonths']})
+        const states = all.State.values as string[]
+        const terms = all.LoanTermMonths.values as Int32Array
+        const median = Array.from(terms).sort((a, b) => a - b)[terms.length >> 1]
+        const matches = states.map((state, i) => i)
+            .filter(i => ['TX', 'CA'].includes(states[i]) && !all.LoanTermMonths.nulls[i] && terms[i] >= median)
+        const where = {State: {in: ['TX', 'CA']}, LoanTermMonths: {gte: median}}
+        const columns = await reader.readColumns({columns: ['LoanTermMonths'], where})
+        Expect(Object.keys(columns)).toEqual(['LoanTermMonths'])
+        Expect(Array.from(columns.LoanTermMonths.values as Int32Array)).toEqual(matches.map(i => terms[i]))
+        const page = await reader.readColumns({columns: ['State'], where, offset: 2, limit: 3})
+        Expect(page.State.values).toEqual(matches.slice(2, 5).map(i => states[i]))
+        const rows: any[] = []
+        for await (const row of reader.cursor({columns: ['State'], where, chunkSize: 100})) {
+            rows.push(row)
+        }
+        Expect(rows.length).toEqual(matches.length)
+        Expect(Object.keys(rows[0])).toEqual(['State'])
+        let streamed = 0
+        await new Promise((resolve, reject) => {
+            reader.createReadStream({columns: ['State'], where, chunkSize: 100})
+                .on('data', row => {
+                    Expect(['TX', 'CA'].includes(row.State)).toBeTruthy()
+                    Expect(Object.keys(row)).toEqual(['State'])
+                    streamed++
+                })
+                .on('error', reject)
+                .on('end', resolve)
+        })
+        Expect(streamed).toEqual(matches.length)
+    }
+
+    @AsyncTest("Read with an invalid where")
+    public async readInvalidWhere() {
+        let error: Error | null = null
+        try {
+            await (this.subject as Reader).readColumns({where: {NotAColumn: 1}})
+        } catch (e) {
+            error = e
+        }
+        Expect(error).not.toBeNull()
+        Expect((error as Error).message).toEqual('NotAColumn not a valid column header')
+    }
+
+    @AsyncTest("Read as stream")
+    public async readStream() {
+        let total = 0
+        await new Promise((resolve, reject) => {
+            (this.subject as Reader).createReadStream({columns: ['LoanId', 'State'], chunkSize: 500})
+                .on('data', row => {
+                    Expect(Object.keys(row)).toEqual(['LoanId', 'State'])
+                    total++
+                })
+                .on('error', reject)
+                .on('end', resolve)
+        })
+        Expect(total).toEqual(this.iteratorLength)
+    }
+
+    @AsyncTest("Cursor early exit")
+    public async cursorEarlyExit() {
+        const cursor = (this.subject as Reader).cursor({columns: ['LoanId', 'State'], chunkSize: 100})
+        const matches: norc.ORC_ROW[] = []
+        for await (const row of cursor) {
+            if (row.State === 'TX') {
+                matches.push(row)
+            }
+            if (matches.length === 5) {
+                break
+            }
+        }
+        Expect(matches.length).toEqual(5)
+        Expect(await cursor.nextBatch()).toBeNull()
+    }
+
+    @AsyncTest("Cursor batches")
+    public async cursorBatches() {
+        const cursor = (this.subject as Reader).cursor({chunkSize: 250})
+        let total = 0
+        let rows = await cursor.nextBatch()
+        while (rows) {
+            Expect(rows.length).toBeLessThan(251)
+            total += rows.length
+            rows = await cursor.nextBatch()
+        }
+        Expect(total).toEqual(this.iteratorLength)
+    }
+
+    @AsyncTest('Iterator Reader Round Trip')
+    public async iteratorRoundTrip() {
+        const file = new Writer()
+        file.schema({key: DataType.INT, value: DataType.STRING, createdAt: DataType.DATE})
+        // @ts-ignore
+        file.add({key: 7, value: 'seven', createdAt: '2018-11-06'})
+        await file.close()
+        await new Promise(resolve => {
+            new Reader(file.data()).read((err, it) => {
+                Expect(err).toBeNull()
+                Expect((it as Iterator<object>).next().value).toEqual({key: 7, value: 'seven', createdAt: '2018-11-06'})
+                return resolve()
+            })
+        })
+    }
+
+    @AsyncTest("Lookup rows by key")
+    public async lookup() {
+        const data = await (this.subject as Reader).readColumns({columns: ['LoanId', 'State']})
+        const ids = data.LoanId.values as string[]
+        const keys = [ids[3], ids[ids.length - 1]]
+        const rows = await (this.subject as Reader).lookup('LoanId', keys, {columns: ['State']})
+        Expect(rows.map(row => row.LoanId).sort()).toEqual(ids.filter(id => keys.includes(id)).sort())
+        Expect(rows[0].State).toEqual((data.State.values as string[])[ids.indexOf(rows[0].LoanId as string)])
+        Expect((await (this.subject as Reader).lookup('LoanId', ['not a loan'])).length).toEqual(0)
+    }
+
+    @AsyncTest("Lookup with bloom filters")
+    public async lookupBloomFilter() {
+        const file = new Writer()
+        file.schema({key: DataType.INT, value: DataType.STRING}, {bloomFilter: ['key', 'value']})
+        const rows = []
+        for (let i = 0; i < 25000; i++) {
+            rows.push({key: i, value: `v${i}`})
+        }
+        file.add(rows)
+        await file.close()
+        const reader = new Reader(file.data())
+        Expect(await reader.lookup('key', [5, 24999])).toEqual([{key: 5, value: 'v5'}, {key: 24999, value: 'v24999'}])
+        Expect(await reader.lookup('value', ['v12000'])).toEqual([{key: 12000, value: 'v12000'}])
+    }
+
+    @AsyncTest("Read with where on float and decimal values")
+    public async whereFloatDecimal() {
+        const file = new Writer()
+        file.schema('struct<f:float,d:decimal(10,2)>')
+        file.addRows(Array.from({length: 25000}, (_, i) => [i / 10, (i / 100).toFixed(2)]))
+        await file.close()
+        const reader = new Reader(file.data())
+        const values = async (column: string, where: object) =>
+            Array.from((await reader.readColumns({columns: [column], where}))[column].values as Float64Array)
+        Expect(await values('f', {f: {eq: 0.1}})).toEqual([0.1])
+        const gte = await values('f', {f: {gte: 2000.3}})
+        Expect(gte.length).toEqual(4997)
+        Expect(gte[0]).toEqual(2000.3)
+        const gt = await values('d', {d: {gt: 199.985}})
+        Expect(gt.length).toEqual(5001)
+        Expect(gt[0]).toEqual(199.99)
+        const lt = await values('d', {d: {lt: 100.004}})
+        Expect(lt.length).toEqual(10001)
+        Expect(lt[10000]).toEqual(100)
+        Expect(await values('d', {d: {eq: 100.005}})).toEqual([])
+    }
+
+    @AsyncTest("Float results match the values read")
+    public async floatResults() {
+        const file = new Writer()
+        file.schema('struct<f:float,g:int>')
+        file.addRows([[3.99, 1], [1.1, 2], [7.7, 1]])
+        await file.close()
+        const reader = new Reader(file.data())
+        const all = await reader.aggregate({columns: ['f'], ops: ['min', 'max']})
+        Expect(all.columns.f).toEqual({min: 1.1, max: 7.7})
+        const some = await reader.aggregate({columns: ['f'], ops: ['min', 'max'], where: {g: 1}})
+        Expect(some.columns.f).toEqual({min: 3.99, max: 7.7})
+        const groups = await reader.groupBy({keys: ['g'], aggs: {f: ['min', 'max']}})
+        Expect(groups.find(group => group.keys.g === 1)!.columns.f).toEqual({min: 3.99, max: 7.7})
+        const {columns} = await reader.profile({columns: ['f'], quantiles: [0, 1]})
+        Expect(columns.f.quantiles).toEqual([1.1, 7.7])
+    }
+
+    @AsyncTest("Lookup a float key that is not representable")
+    public async lookupFloat() {
+        const file = new Writer()
+        file.schema({key: DataType.FLOAT, value: DataType.STRING}, {bloomFilter: ['key']})
+        file.add(Array.from({length: 25000}, (_, i) => ({key: i / 10, value: `v${i}`})))
+        await file.close()
+        const reader = new Reader(file.data())
+        Expect(await reader.lookup('key', [0.1])).toEqual([{key: 0.1, value: 'v1'}])
+        Expect(await reader.lookup('key', [2000.3])).toEqual([{key: 2000.3, value: 'v20003'}])
+    }
+
+    @AsyncTest("Statistics at every level")
+    public async statistics() {
+        const reader = this.subject as Reader
+        const stripes = reader.stripes()
+        Expect(stripes.length).toBeGreaterThan(0)
+        Expect(stripes.reduce((rows, stripe) => rows + stripe.rows, 0)).toEqual(this.iteratorLength)
+        const file = await reader.statistics({columns: ['LoanTermMonths', 'State']})
+        Expect(file.rows).toEqual(this.iteratorLength)
+        Expect(Object.keys(file.columns)).toEqual(['LoanTermMonths', 'State'])
+        const term = file.columns.LoanTermMonths
+        const data = await reader.readColumns({columns: ['LoanTermMonths']})
+        const values = Array.from(data.LoanTermMonths.values as Int32Array).filter((v, i) => !data.LoanTermMonths.nulls[i])
+        Expect(term.count).toEqual(values.length)
+        Expect(term.min).toEqual(Math.min(...values))
+        Expect(term.max).toEqual(Math.max(...values))
+        Expect(term.sum).toEqual(values.reduce((sum, v) => sum + v, 0))
+        Expect(typeof(file.columns.State.min)).toEqual('string')
+        const perStripe = await reader.statistics({level: 'stripe', columns: ['LoanTermMonths']})
+        Expect(perStripe.length).toEqual(stripes.length)
+        Expect(perStripe[0].offset).toEqual(stripes[0].offset)
+        const rowGroups = await reader.statistics({level: 'rowGroup', columns: ['LoanTermMonths']})
+        Expect(rowGroups.reduce((rows, group) => rows + group.rows, 0)).toEqual(this.iteratorLength)
+        Expect(rowGroups.reduce((count, group) => count + group.columns.LoanTermMonths.count, 0)).toEqual(term.count)
+    }
+
+    @AsyncTest("Aggregate columns")
+    public async aggregate() {
+        const reader = this.subject as Reader
+        const data = await reader.readColumns({columns: ['LoanTermMonths', 'State']})
+        const terms = data.LoanTermMonths
+        const states = data.State.values as string[]
+        const expect = (rows: number[]) => {
+            const values = rows.filter(i => !terms.nulls[i]).map(i => (terms.values as Int32Array)[i])
+            const sum = values.reduce((total, v) => total + v, 0)
+            return {count: values.length, sum, min: Math.min(...values), max: Math.max(...values), avg: sum / values.length}
+        }
+        const all = states.map((state, i) => i)
+        const file = await reader.aggregate({columns: ['LoanTermMonths']})
+        Expect(file.rows).toEqual(this.iteratorLength)
+        Expect(file.columns.LoanTermMonths).toEqual(expect(all))
+        const ca = all.filter(i => !data.State.nulls[i] && states[i] === 'CA')
+        const filtered = await reader.aggregate({
+            columns: ['LoanTermMonths'],
+            where: {State: 'CA'},
+            parallel: 2
+        })
+        Expect(filtered.rows).toEqual(ca.length)
+        Expect(filtered.columns.LoanTermMonths).toEqual(expect(ca))
+        const counts = await reader.aggregate({columns: ['State'], ops: ['count', 'min'], where: {State: {gt: 'zz'}}})
+        Expect(counts).toEqual({rows: 0, columns: {State: {count: 0, min: null}}})
+        let error: Error | null = null
+        try {
+            await reader.aggregate({columns: ['State'], ops: ['sum']})
+        } catch (e) {
+            error = e
+        }
+        Expect(error).not.toBeNull()
+    }
+
+    @AsyncTest("Group by key columns")
+    public async groupBy() {
+        const reader = this.subject as Reader
+        const data = await reader.readColumns({columns: ['LoanTermMonths', 'State']})
+        const terms = data.LoanTermMonths
+        const states = data.State
+        const expected = new Map<string | null, {rows: number, count: number, sum: number}>()
+        for (let i = 0; i < states.values.length; i++) {
+            const state = states.nulls[i] ? null : (states.values as string[])[i]
+            const group = expected.get(state) || {rows: 0, count: 0, sum: 0}
+            group.rows++
+            if (!terms.nulls[i]) {
+                group.count++
+                group.sum += (terms.values as Int32Array)[i]
+            }
+            expected.set(state, group)
+        }
+        for (const parallel of [1, 2]) {
+            const groups = await reader.groupBy({keys: ['State'], aggs: {LoanTermMonths: ['count', 'sum']}, parallel})
+            Expect(groups.length).toEqual(expected.size)
+            for (const {keys, rows, columns} of groups) {
+                const group = expected.get(keys.State as string | null)!
+                Expect(rows).toEqual(group.rows)
+                Expect(columns.LoanTermMonths).toEqual({count: group.count, sum: group.count ? group.sum : null})
+            }
+        }
+        const ca = await reader.groupBy({keys: ['State'], where: {State: 'CA'}})
+        Expect(ca).toEqual([{keys: {State: 'CA'}, rows: expected.get('CA')!.rows, columns: {}}])
+        let error: Error | null = null
+        try {
+            await reader.groupBy({keys: ['State'], aggs: {State: ['sum']}})
+        } catch (e) {
+            error = e
+        }
+        Expect(error).not.toBeNull()
+    }
+
+    @AsyncTest("Group by a wide decimal key")
+    public async groupByWideDecimal() {
+        const file = new Writer()
+        file.schema('struct<key:decimal(38,0)>')
+        file.add([{key: '12345678901234567890'}, {key: '12345678901234567891'}, {key: '12345678901234567890'}])
+        await file.close()
+        const groups = await new Reader(file.data()).groupBy({keys: ['key']})
+        Expect(groups.map(group => group.rows).sort()).toEqual([1, 2])
+    }
+
+    @AsyncTest("Top rows by a column")
+    public async topK() {
+        const reader = this.subject as Reader
+        const data = await reader.readColumns({columns: ['LoanId', 'LoanTermMonths', 'State']})
+        const terms = data.LoanTermMonths
+        const expect = (rows: number[], k: number, desc: boolean) => rows
+            .filter(i => !terms.nulls[i])
+            .sort((a, b) => {
+                const order = (terms.values as Int32Array)[a] - (terms.values as Int32Array)[b]
+                return (desc ? -order : order) || a - b
+            })
+            .slice(0, k)
+            .map(i => ({LoanId: (data.LoanId.values as any)[i], LoanTermMonths: (terms.values as Int32Array)[i]}))
+        const all = Array.from(terms.nulls, (n, i) => i)
+        const columns = ['LoanId', 'LoanTermMonths']
+        Expect(await reader.topK({column: 'LoanTermMonths', k: 5, columns, parallel: 2})).toEqual(expect(all, 5, true))
+        Expect(await reader.topK({column: 'LoanTermMonths', k: 5, order: 'asc', columns})).toEqual(expect(all, 5, false))
+        const ca = all.filter(i => !data.State.nulls[i] && (data.State.values as string[])[i] === 'CA')
+        Expect(await reader.topK({column: 'LoanTermMonths', k: 3, columns, where: {State: 'CA'}})).toEqual(expect(ca, 3, true))
+        Expect(await reader.topK({column: 'LoanTermMonths', k: 0})).toEqual([])
+    }
+
+    @AsyncTest("Profile columns")
+    public async profile() {
+        const reader = this.subject as Reader
+        const data = await reader.readColumns({columns: ['LoanTermMonths', 'State']})
+        const states = data.State.values as string[]
+        const present = states.filter((s, i) => !data.State.nulls[i])
+        const terms = Array.from(data.LoanTermMonths.values as Int32Array)
+            .filter((v, i) => !data.LoanTermMonths.nulls[i])
+            .sort((a, b) => a - b)
+        const {rows, columns} = await reader.profile({columns: ['LoanTermMonths', 'State'], quantiles: [0, 0.5, 1], parallel: 2})
+        Expect(rows).toEqual(this.iteratorLength)
+        const state = columns.State
+        Expect(state.nulls).toEqual(states.length - present.length)
+        Expect(state.nullRatio).toEqual((states.length - present.length) / states.length)
+        const distinct = new Set(present).size
+        Expect(Math.abs(state.distinct! - distinct)).toBeLessThan(distinct * 0.05 + 1)
+        Expect(state.minLength).toEqual(Math.min(...present.map(s => s.length)))
+        Expect(state.maxLength).toEqual(Math.max(...present.map(s => s.length)))
+        const quantiles = columns.LoanTermMonths.quantiles as number[]
+        Expect(quantiles[0]).toEqual(terms[0])
+        Expect(quantiles[2]).toEqual(terms[terms.length - 1])
+        Expect(quantiles[1]).toBeGreaterThan(terms[Math.floor(terms.length * 0.45)] - 1)
+        Expect(quantiles[1]).toBeLessThan(terms[Math.ceil(terms.length * 0.55)] + 1)
+        const byTitles = await reader.profile(['State'])
+        Expect(Object.keys(byTitles.columns)).toEqual(['State'])
+    }
+
+    @AsyncTest("Join two readers")
+    public async joinReaders() {
+        const loans = this.subject as Reader
+        const data = await loans.readColumns({columns: ['LoanId', 'State']})
+        const file = new Writer()
+        file.schema({State: DataType.STRING, Region: DataType.STRING})
+        file.add([{State: 'CA', Region: 'West'}, {State: 'NY', Region: 'East'}, {State: 'ZZ', Region: 'None'}])
+        await file.close()
+        const regions = new Reader(file.data())
+        const region: {[state: string]: string} = {CA: 'West', NY: 'East'}
+        const expected = (data.LoanId.values as string[])
+            .map((LoanId, i) => ({LoanId, State: data.State.nulls[i] ? null : (data.State.values as string[])[i]}))
+            .map(row => ({...row, Region: row.State !== null && row.State in region ? region[row.State] : null}))
+        const columns = ['LoanId', 'State', 'Region']
+        const inner = await norc.join(loans, regions, {on: 'State', columns, parallel: 2})
+        Expect(inner).toEqual(expected.filter(row => row.Region !== null))
+        const left = await norc.join(loans, regions, {on: 'State', type: 'left', columns})
+        Expect(left).toEqual(expected)
+        // the left side is the smaller one, unmatched rows come last
+        const reverse = await norc.join(regions, loans, {on: 'State', type: 'left', columns: ['State', 'Region', 'LoanId'], resultType: 'columns'})
+        const zz = (reverse.State.values as string[]).indexOf('ZZ')
+        Expect(zz).toEqual(reverse.State.values.length - 1)
+        Expect(reverse.LoanId.nulls[zz]).toEqual(1)
+        Expect(reverse.State.values.length).toEqual(inner.length + 1)
+    }
+
+    @AsyncTest("Read strings as a dictionary")
+    public async readDictionary() {
+        const reader = this.subject as Reader
+        const plain = await reader.readColumns({columns: ['State', 'LoanId', 'APR'], parallel: 2})
+        const data = await reader.readColumns({columns: ['State', 'LoanId', 'APR'], parallel: 2, dictionary: true})
+        for (const title of ['State', 'LoanId']) {
+            const column = data[title] as norc.DictionaryColumnData
+            Expect(new Set(column.dictionary).size).toEqual(column.dictionary.length)
+            const values = Array.from(column.indices).map((index, i) => column.nulls[i] ? null : column.dictionary[index])
+            Expect(values).toEqual(plain[title].values)
+            Expect(Array.from(column.nulls)).toEqual(Array.from(plain[title].nulls))
+        }
+        Expect((data.State as norc.DictionaryColumnData).dictionary.length).toBeLessThan(100)
+        Expect(data.APR.nulls.length).toEqual(plain.APR.nulls.length)
+        // rows share the strings of the dictionary
+        const rows: any[] = []
+        for await (const row of reader.cursor({columns: ['State'], where: {State: {in: ['TX', 'CA']}}})) {
+            rows.push(row)
+        }
+        Expect(rows.length).toEqual((plain.State.values as string[]).filter(state => state === 'TX' || state === 'CA').length)
+    }
+
+    @AsyncTest('Open with a serialized tail')
+    public async serializedTail() {
+        const path = join(__dirname, './test_files/test_data.orc')
+        const tail = (this.subject as Reader).serializedTail()
+        Expect(tail.length).toBeGreaterThan(0)
+        const expected = await (this.subject as Reader).readColumns({columns: ['LoanId']})
+        const reader = new Reader(path, {tail})
+        Expect(reader.type).toEqual((this.subject as Reader).type)
+        Expect((await reader.readColumns({columns: ['LoanId']})).LoanId.values).toEqual(expected.LoanId.values)
+        Reader.clearTailCache()
+        Reader.setTailCacheSize(0)
+        Expect(new Reader(path).type).toEqual(reader.type)
+        Reader.setTailCacheSize(32 * 1024 * 1024)
+    }
+
+    @AsyncTest('Read from an ArrayBuffer and a typed array view')
+    public async arrayBufferInput() {
+        const file = new Writer()
+        file.schema({key: DataType.INT, value: DataType.STRING})
+        // @ts-ignore
+        file.add([{key: 1, value: 'one'}, {key: 2, value: 'two'}])
+        await file.close()
+        const data = file.data()
+        // copy into an offset view to make sure byteOffset is respected
+        const backing = new ArrayBuffer(data.length + 16)
+        const view = new Uint8Array(backing, 16, data.length)
+        view.set(data)
+        const copy = new ArrayBuffer(data.length)
+        new Uint8Array(copy).set(data)
+        for (const input of [view, copy]) {
+            const columns = await new Reader(input).readColumns({columns: ['key', 'value']})
+            Expect(Array.from(columns.key.values as Int32Array)).toEqual([1, 2])
+            Expect(columns.value.values).toEqual(['one', 'two'])
+        }
+    }
+
     @AsyncTest('Event Reader Single Entry')
     @Timeout(500000)
     public async singleReader() {
@@ -140,7 +637,7 @@ export class ReaderSpec {
             file.schema(schema)
             // @ts-ignore
             file.add({key: 0, value: 'zero'})
-            file.close()
+            file.closeSync()
             const src = file.data()
             const reader = new Reader(src)
             reader.on('data', chunk => {
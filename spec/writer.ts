@@ -50,8 +50,7 @@ export class WriterSpec {
                     })
                 })
                 .on('end', () => {
-                    file.close()
-                    return resolve()
+                    file.close().then(() => resolve())
                 })
         })
     }
@@ -66,11 +65,185 @@ export class WriterSpec {
         file.schema(schema)
         // @ts-ignore
         file.add({key: 0, value: 'zero'})
-        file.close()
+        await file.close()
         Expect(file.data()).toBeDefined()
         Expect(file.data().length).toEqual(340)
     }
 
+    @AsyncTest('Add rows as objects and tuples')
+    public async addRows() {
+        const writer = new Writer()
+        writer.schema('struct<id:int,name:string,score:double>')
+        const rows = Array.from({length: 2100}, (_, i) => ({id: i, name: i % 9 === 0 ? null : `row ${i}`, score: i / 2}))
+        writer.add(rows.slice(0, 1000))
+        rows.slice(1000, 1500).forEach(row => writer.addRow([row.id, row.name, row.score]))
+        writer.addRows(rows.slice(1500).map(row => [row.id, row.name, row.score]))
+        Expect(() => writer.addRow([1, 'short'])).toThrow()
+        await writer.close()
+        const read: any[] = []
+        for await (const row of new norc.Reader(writer.data()).cursor()) {
+            read.push(row)
+        }
+        Expect(read).toEqual(rows)
+    }
+
+    @AsyncTest('Add negative, wide and decimal values to rows')
+    public async addTypedValues() {
+        const writer = new Writer()
+        writer.schema('struct<n:bigint,price:decimal(10,2),big:decimal(30,4),day:date,ok:boolean>')
+        const rows = [
+            {n: -5, price: 12.5, big: '-123456789012.3456', day: '1970-01-01', ok: true},
+            {n: 2 ** 40, price: '-0.07', big: 3, day: '2019-12-31', ok: false},
+            {n: null, price: null, big: null, day: null, ok: null}
+        ]
+        writer.add(rows)
+        writer.addRow([7, 1, 0.5, '2000-02-29', true])
+        Expect(() => writer.addRow(['seven', 1, 1, '2000-01-01', true])).toThrow()
+        Expect(() => writer.add({n: 1, prise: 1, big: 1, day: '2000-01-01', ok: true})).toThrow()
+        Expect(() => writer.add([{n: 1, price: 1, big: 1, day: '2000-01-01', ok: true}, {n: 2}])).toThrow()
+        Expect(() => writer.addRow([1, '123456789012345678901', 1, '2000-01-01', true])).toThrow()
+        Expect(() => writer.addRow([1, 1e17, 1, '2000-01-01', true])).toThrow()
+        await writer.close()
+        const read: any[] = []
+        for await (const row of new norc.Reader(writer.data()).cursor()) {
+            read.push(row)
+        }
+        Expect(read).toEqual([
+            {n: -5, price: 12.5, big: -123456789012.3456, day: '1970-01-01', ok: true},
+            {n: 2 ** 40, price: -0.07, big: 3, day: '2019-12-31', ok: false},
+            {n: null, price: null, big: null, day: null, ok: null},
+            {n: 7, price: 1, big: 0.5, day: '2000-02-29', ok: true},
+            {n: 1, price: 1, big: 1, day: '2000-01-01', ok: true}
+        ])
+    }
+
+    @AsyncTest('Flush and close while batches encode in the background')
+    public async flushAndClose() {
+        const writer = new Writer()
+        writer.schema('struct<id:int,name:string>')
+        const rows = Array.from({length: 10000}, (_, i) => [i, `name ${i % 13}`])
+        writer.addRows(rows.slice(0, 4500))
+        await writer.flush()
+        writer.addRows(rows.slice(4500))
+        await writer.close()
+        Expect(() => writer.addRows(rows.slice(0, 2000))).toThrow()
+        Expect(() => writer.addRow([1, 'closed'])).toThrow()
+        Expect(() => writer.addColumns({id: Int32Array.of(1), name: ['closed']})).toThrow()
+        let error: Error | null = null
+        try {
+            await writer.close()
+        } catch (e) {
+            error = e
+        }
+        Expect(error).not.toBeNull()
+        const read = await new norc.Reader(writer.data()).readColumns()
+        Expect(Array.from(read.id.values as Int32Array)).toEqual(rows.map(row => row[0]))
+        Expect(read.name.values).toEqual(rows.map(row => row[1]))
+    }
+
+    @AsyncTest('Add columns from typed arrays')
+    public async addColumns() {
+        const writer = new Writer()
+        writer.schema({
+            id: DataType.INT,
+            total: DataType.BIGINT,
+            rate: DataType.DOUBLE,
+            name: DataType.STRING,
+            day: DataType.DATE,
+            at: DataType.TIMESTAMP
+        })
+        const rows = 2500
+        const ids = Int32Array.from({length: rows}, (_, i) => i)
+        const totals = BigInt64Array.from({length: rows}, (_, i) => 9007199254740993n * BigInt(i % 3))
+        const rates = Float64Array.from({length: rows}, (_, i) => i / 8)
+        const names = Array.from({length: rows}, (_, i) => i % 10 === 0 ? null : `name ${i % 7}`)
+        const days = Int32Array.from({length: rows}, (_, i) => 18000 + i)
+        const at = Float64Array.from({length: rows}, (_, i) => 1546300800000 + i * 1500)
+        const nulls = Uint8Array.from({length: rows}, (_, i) => i % 4 === 0 ? 1 : 0)
+        writer.add({id: -1, total: 1, rate: 1, name: 'first', day: '2019-01-01', at: '2019-01-01 00:00:00'})
+        writer.addColumns({id: ids, total: totals, rate: rates, name: names, day: days, at}, {nulls: {rate: nulls}})
+        Expect(() => writer.addColumns({id: ids})).toThrow()
+        await writer.close()
+        const data = await new norc.Reader(writer.data()).readColumns()
+        Expect(data.id.values.length).toEqual(rows + 1)
+        Expect((data.id.values as Int32Array)[0]).toEqual(-1)
+        Expect(Array.from((data.id.values as Int32Array).slice(1))).toEqual(Array.from(ids))
+        Expect(Array.from((data.total.values as BigInt64Array).slice(1))).toEqual(Array.from(totals))
+        Expect(Array.from(data.rate.nulls.slice(1))).toEqual(Array.from(nulls))
+        Expect((data.rate.values as Float64Array)[2]).toEqual(rates[1])
+        Expect((data.name.values as Array<string | null>).slice(1)).toEqual(names)
+        Expect(Array.from((data.day.values as Int32Array).slice(1))).toEqual(Array.from(days))
+        Expect(Array.from((data.at.values as Float64Array).slice(1))).toEqual(Array.from(at))
+    }
+
+    @AsyncTest('Add decimal columns from typed arrays')
+    public async addDecimalColumns() {
+        const writer = new Writer()
+        writer.schema('struct<price:decimal(10,2),big:decimal(30,4)>')
+        const prices = Float64Array.of(12.5, -0.07, 1.25)
+        const bigs = Float32Array.of(3, -0.5, 1024)
+        writer.addColumns({price: prices, big: bigs})
+        Expect(() => writer.addColumns({price: Float64Array.of(1e17), big: Float64Array.of(0)})).toThrow()
+        Expect(() => writer.addColumns({price: Float64Array.of(0), big: Float64Array.of(NaN)})).toThrow()
+        await writer.close()
+        const read = await new norc.Reader(writer.data()).readColumns()
+        Expect(Array.from(read.price.values as Float64Array)).toEqual([12.5, -0.07, 1.25])
+        Expect(Array.from(read.big.values as Float64Array)).toEqual([3, -0.5, 1024])
+    }
+
+    @AsyncTest('Skip typed array values masked null')
+    public async addMaskedColumns() {
+        const writer = new Writer()
+        writer.schema('struct<n:int,price:decimal(10,2),at:timestamp>')
+        const values = Float64Array.of(1, NaN, 3)
+        const nulls = Uint8Array.of(0, 1, 0)
+        writer.addColumns({n: values, price: values, at: values}, {nulls: {n: nulls, price: nulls, at: nulls}})
+        Expect(() => writer.addColumns({n: Float64Array.of(NaN), price: Float64Array.of(0), at: Float64Array.of(0)})).toThrow()
+        Expect(() => writer.addColumns({n: Float64Array.of(1e300), price: Float64Array.of(0), at: Float64Array.of(0)})).toThrow()
+        Expect(() => writer.addColumns({n: Float64Array.of(0), price: Float64Array.of(0), at: Float64Array.of(Infinity)})).toThrow()
+        await writer.close()
+        const read = await new norc.Reader(writer.data()).readColumns()
+        Expect(Array.from(read.n.nulls)).toEqual([0, 1, 0])
+        Expect((read.n.values as Int32Array)[2]).toEqual(3)
+        Expect(Array.from(read.price.nulls)).toEqual([0, 1, 0])
+        Expect((read.price.values as Float64Array)[2]).toEqual(3)
+        Expect(Array.from(read.at.nulls)).toEqual([0, 1, 0])
+        Expect((read.at.values as Float64Array)[2]).toEqual(3)
+    }
+
+    @AsyncTest('Keep the rows before an invalid value')
+    public async addInvalidRows() {
+        const writer = new Writer()
+        writer.schema('struct<id:int,price:decimal(10,2)>')
+        const rows = Array.from({length: 3000}, (_, i) => [i, i === 2500 ? 'none' : i / 4])
+        Expect(() => writer.addRows(rows)).toThrow()
+        const ids = Int32Array.from({length: 3000}, (_, i) => 2500 + i)
+        const prices = Array.from({length: 3000}, (_, i) => i === 2000 ? 'none' : i)
+        Expect(() => writer.addColumns({id: ids, price: prices})).toThrow()
+        await writer.close()
+        const read = await new norc.Reader(writer.data()).readColumns()
+        Expect(Array.from(read.id.values as Int32Array)).toEqual(Array.from({length: 4500}, (_, i) => i))
+        Expect((read.price.values as Float64Array)[2499]).toEqual(2499 / 4)
+    }
+
+    @AsyncTest('Add string columns packed in a buffer')
+    public async addPackedStrings() {
+        const writer = new Writer()
+        writer.schema({name: DataType.STRING, raw: DataType.BINARY})
+        const names = Array.from({length: 3000}, (_, i) => i % 5 === 0 ? '' : `näme ${i}`)
+        const parts = names.map(name => Buffer.from(name))
+        const offsets = new Int32Array(names.length + 1)
+        parts.forEach((part, i) => offsets[i + 1] = offsets[i] + part.length)
+        const data = Buffer.concat(parts)
+        const nulls = Uint8Array.from(names, (_, i) => i % 7 === 0 ? 1 : 0)
+        writer.addColumns({name: {data, offsets}, raw: {data, offsets}}, {nulls: {name: nulls}})
+        Expect(() => writer.addColumns({name: {data, offsets: Int32Array.of(0, data.length + 1)}, raw: []})).toThrow()
+        await writer.close()
+        const read = await new norc.Reader(writer.data()).readColumns()
+        Expect(read.name.values).toEqual(names.map((name, i) => nulls[i] ? null : name))
+        Expect((read.raw.values as Buffer[]).map(value => value.toString())).toEqual(names)
+    }
+
     @AsyncTest('Writer Merge Existing File')
     public async mergeTest() {
         const writer = new Writer()
@@ -93,7 +266,7 @@ export class WriterSpec {
         }
         writer.schema(schema)
         writer.merge(filePath, i => i.State === 'TX')
-        writer.close()
+        await writer.close()
         const mergedFileData = writer.data()
         require('fs').writeFileSync('/tmp/test.orc', mergedFileData)
     }
@@ -0,0 +1,433 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Appender.h"
+#include "Internal.h"
+#include "Writer.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+using namespace Napi;
+using namespace orc;
+
+namespace norc {
+
+/**
+ * The values of one column passed to addColumns: a typed array read in place,
+ * the strings packed in a single buffer, or an Array converted value by value.
+ */
+struct ColumnSource
+{
+  string title;
+  const orc::Type* type;
+  orc::ColumnVectorBatch* batch;
+  napi_typedarray_type arrayType = napi_int8_array;
+  // first element of the typed array, null for an Array
+  const void* elements = nullptr;
+  Napi::Array values;
+  // {data, offsets} of a string column, string i is bytes[offsets[i]] to
+  // bytes[offsets[i + 1]]
+  const char* bytes = nullptr;
+  const int32_t* offsets = nullptr;
+  // 1 marks a null row, from opts.nulls
+  const uint8_t* nulls = nullptr;
+  uint64_t length = 0;
+};
+
+template<typename In, typename Out>
+static void
+Convert(const void* elements, uint64_t start, uint64_t n, Out* out)
+{
+  const In* in = static_cast<const In*>(elements) + start;
+  for (uint64_t i = 0; i < n; i++) {
+    out[i] = static_cast<Out>(in[i]);
+  }
+}
+/**
+ * Copy n elements of a typed array from start into out, converted to Out. The
+ * element type is resolved once, the copy itself is a plain loop.
+ */
+template<typename Out>
+static void
+ConvertTypedArray(const ColumnSource& source,
+                  uint64_t start,
+                  uint64_t n,
+                  Out* out)
+{
+  const void* in = source.elements;
+  switch (source.arrayType) {
+    case napi_int8_array:
+      Convert<int8_t>(in, start, n, out);
+      break;
+    case napi_uint8_array:
+    case napi_uint8_clamped_array:
+      Convert<uint8_t>(in, start, n, out);
+      break;
+    case napi_int16_array:
+      Convert<int16_t>(in, start, n, out);
+      break;
+    case napi_uint16_array:
+      Convert<uint16_t>(in, start, n, out);
+      break;
+    case napi_int32_array:
+      Convert<int32_t>(in, start, n, out);
+      break;
+    case napi_uint32_array:
+      Convert<uint32_t>(in, start, n, out);
+      break;
+    case napi_float32_array:
+      Convert<float>(in, start, n, out);
+      break;
+    case napi_float64_array:
+      Convert<double>(in, start, n, out);
+      break;
+    case napi_bigint64_array:
+      Convert<int64_t>(in, start, n, out);
+      break;
+    case napi_biguint64_array:
+      Convert<uint64_t>(in, start, n, out);
+      break;
+    default:
+      break;
+  }
+}
+static bool
+IsRealArray(napi_typedarray_type type)
+{
+  return type == napi_float32_array || type == napi_float64_array;
+}
+static bool
+IsStringKind(TypeKind kind)
+{
+  return kind == TypeKind::STRING || kind == TypeKind::VARCHAR ||
+         kind == TypeKind::CHAR || kind == TypeKind::BINARY;
+}
+/**
+ * Read a string column given as {data, offsets}, a Buffer (or any typed
+ * array) of the bytes of every string and an Int32Array of n + 1 offsets
+ * into it, as in the Arrow layout. Throws a JS exception and returns false
+ * when the offsets do not fall in the data.
+ */
+static bool
+ParsePackedStrings(Napi::Env env, const Object& packed, ColumnSource& source)
+{
+  Napi::Value data = packed.Get("data");
+  Napi::Value offsets = packed.Get("offsets");
+  if (!data.IsTypedArray() || !offsets.IsTypedArray() ||
+      offsets.As<TypedArray>().TypedArrayType() != napi_int32_array ||
+      offsets.As<TypedArray>().ElementLength() == 0) {
+    TypeError::New(env,
+                   source.title +
+                     " must be an array or {data: Buffer, offsets: "
+                     "Int32Array}")
+      .ThrowAsJavaScriptException();
+    return false;
+  }
+  auto bytes = data.As<TypedArray>();
+  const int32_t* positions = offsets.As<Int32Array>().Data();
+  const uint64_t length = offsets.As<TypedArray>().ElementLength() - 1;
+  const int64_t size = static_cast<int64_t>(bytes.ByteLength());
+  for (uint64_t i = 0; i < length; i++) {
+    if (positions[i] < 0 || positions[i] > positions[i + 1] ||
+        positions[i + 1] > size) {
+      RangeError::New(env,
+                      "offsets of " + source.title +
+                        " must be increasing and within data")
+        .ThrowAsJavaScriptException();
+      return false;
+    }
+  }
+  source.bytes = static_cast<const char*>(bytes.ArrayBuffer().Data()) +
+                 bytes.ByteOffset();
+  source.offsets = positions;
+  source.length = length;
+  return true;
+}
+
+/**
+ * Fill rows [start, start + n) of the column into its batch field. On a value
+ * the column cannot hold, n is cut to the rows before it. Throws a JS
+ * exception and returns false when the column cannot be written at all.
+ */
+static bool
+FillColumn(Napi::Env env,
+           ColumnSource& source,
+           uint64_t start,
+           uint64_t& n,
+           StringArena& strings)
+{
+  ColumnVectorBatch& batch = *source.batch;
+  char* present = batch.notNull.data();
+  memset(present, 1, n);
+  // rows masked null are never converted, whatever their value
+  for (uint64_t i = 0; source.nulls && i < n; i++) {
+    if (source.nulls[start + i]) {
+      present[i] = 0;
+    }
+  }
+  const TypeKind kind = source.type->getKind();
+  auto unsupported = [&]() {
+    TypeError::New(env, "Invalid value for column " + source.title)
+      .ThrowAsJavaScriptException();
+    return false;
+  };
+  if (!source.elements && !source.bytes) {
+    // an Array, converted value by value by the appender of the column
+    auto fill = [&](auto& appender) {
+      for (uint64_t i = 0; i < n; i++) {
+        if (!present[i]) {
+          continue;
+        }
+        Napi::Value value = source.values.Get(start + i);
+        if (IsNullValue(value)) {
+          appender.SetNull(i);
+        } else if (!appender.Set(i, value)) {
+          n = i;
+          return false;
+        }
+      }
+      return true;
+    };
+    try {
+      VisitAppender(*source.type, batch, strings, fill);
+    } catch (std::invalid_argument& ex) {
+      Error::New(env, ex.what()).ThrowAsJavaScriptException();
+      return false;
+    }
+  } else {
+    switch (kind) {
+      case TypeKind::BOOLEAN:
+      case TypeKind::BYTE:
+      case TypeKind::SHORT:
+      case TypeKind::INT:
+      case TypeKind::LONG:
+      case TypeKind::DATE: {
+        // DATE values are days since epoch, as read by readColumns
+        int64_t* data = static_cast<LongVectorBatch&>(batch).data.data();
+        if (!IsRealArray(source.arrayType)) {
+          ConvertTypedArray(source, start, n, data);
+          break;
+        }
+        vector<double> reals(n);
+        ConvertTypedArray(source, start, n, reals.data());
+        for (uint64_t i = 0; i < n; i++) {
+          if (!present[i]) {
+            continue;
+          }
+          if (!FitsInt64(reals[i])) {
+            n = i;
+            break;
+          }
+          data[i] = static_cast<int64_t>(reals[i]);
+        }
+        break;
+      }
+      case TypeKind::FLOAT:
+      case TypeKind::DOUBLE: {
+        double* data = static_cast<DoubleVectorBatch&>(batch).data.data();
+        ConvertTypedArray(source, start, n, data);
+        break;
+      }
+      case TypeKind::DECIMAL: {
+        // rounded to the scale as numbers passed in an Array are
+        vector<double> numbers(n);
+        ConvertTypedArray(source, start, n, numbers.data());
+        auto fill = [&](auto& appender) {
+          if constexpr (std::decay_t<decltype(appender)>::IsDecimal) {
+            for (uint64_t i = 0; i < n; i++) {
+              if (present[i] && !appender.SetDecimal(i, numbers[i])) {
+                n = i;
+                return false;
+              }
+            }
+          }
+          return true;
+        };
+        VisitAppender(*source.type, batch, strings, fill);
+        break;
+      }
+      case TypeKind::TIMESTAMP: {
+        // epoch milliseconds as read by readColumns, BigInt values are epoch
+        // nanoseconds
+        auto& timestamps = static_cast<TimestampVectorBatch&>(batch);
+        int64_t* seconds = timestamps.data.data();
+        int64_t* nanos = timestamps.nanoseconds.data();
+        if (source.arrayType == napi_bigint64_array) {
+          const int64_t* in = static_cast<const int64_t*>(source.elements);
+          for (uint64_t i = 0; i < n; i++) {
+            SplitNanos(in[start + i], seconds[i], nanos[i]);
+          }
+          break;
+        }
+        vector<double> millis(n);
+        ConvertTypedArray(source, start, n, millis.data());
+        for (uint64_t i = 0; i < n; i++) {
+          if (!present[i]) {
+            continue;
+          }
+          if (!FitsInt64(millis[i])) {
+            n = i;
+            break;
+          }
+          SplitMillis(millis[i], seconds[i], nanos[i]);
+        }
+        break;
+      }
+      case TypeKind::STRING:
+      case TypeKind::VARCHAR:
+      case TypeKind::CHAR:
+      case TypeKind::BINARY: {
+        if (!source.bytes) {
+          return unsupported();
+        }
+        // the batch is encoded after addColumns returned, the bytes of the
+        // rows are copied in one block, which the strings point into
+        auto& text = static_cast<StringVectorBatch&>(batch);
+        const int32_t* offsets = source.offsets + start;
+        char* bytes =
+          strings.Copy(source.bytes + offsets[0], offsets[n] - offsets[0]);
+        for (uint64_t i = 0; i < n; i++) {
+          text.data[i] = bytes + (offsets[i] - offsets[0]);
+          text.length[i] = offsets[i + 1] - offsets[i];
+        }
+        break;
+      }
+      default:
+        Error::New(env,
+                   "List, Map, Struct, and Union types are not currently "
+                   "supported")
+          .ThrowAsJavaScriptException();
+        return false;
+    }
+  }
+  return true;
+}
+
+void
+Writer::AddColumns(const CallbackInfo& info)
+{
+  if (!EnsureOpen(info.Env())) {
+    return;
+  }
+  Napi::Env env = info.Env();
+  if (!writer) {
+    Error::New(env, "A schema must be defined before adding columns")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  if (info.Length() < 1 || !info[0].IsObject()) {
+    TypeError::New(env, "columns must be an object of column values")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  auto columns = info[0].As<Object>();
+  Object nulls;
+  if (info.Length() > 1 && info[1].IsObject()) {
+    Napi::Value option = info[1].As<Object>().Get("nulls");
+    if (option.IsObject()) {
+      nulls = option.As<Object>();
+    } else if (!IsNullValue(option)) {
+      TypeError::New(env, "nulls must be an object of Uint8Array")
+        .ThrowAsJavaScriptException();
+      return;
+    }
+  }
+  vector<ColumnSource> sources(type->getSubtypeCount());
+  for (uint64_t i = 0; i < sources.size(); i++) {
+    ColumnSource& source = sources[i];
+    source.title = type->getFieldName(i);
+    source.type = type->getSubtype(i);
+    Napi::Value values = columns.Get(source.title);
+    if (values.IsTypedArray()) {
+      auto typed = values.As<TypedArray>();
+      source.arrayType = typed.TypedArrayType();
+      source.elements =
+        static_cast<const uint8_t*>(typed.ArrayBuffer().Data()) +
+        typed.ByteOffset();
+      source.length = typed.ElementLength();
+    } else if (values.IsArray()) {
+      source.values = values.As<Array>();
+      source.length = source.values.Length();
+    } else if (values.IsObject() && IsStringKind(source.type->getKind())) {
+      if (!ParsePackedStrings(env, values.As<Object>(), source)) {
+        return;
+      }
+    } else {
+      TypeError::New(env, "Missing column: " + source.title)
+        .ThrowAsJavaScriptException();
+      return;
+    }
+    if (source.length != sources[0].length) {
+      RangeError::New(env, "columns must all have the same length")
+        .ThrowAsJavaScriptException();
+      return;
+    }
+    Napi::Value mask =
+      nulls.IsEmpty() ? env.Undefined() : nulls.Get(source.title);
+    if (mask.IsUndefined()) {
+      continue;
+    }
+    if (!mask.IsTypedArray() ||
+        mask.As<TypedArray>().TypedArrayType() != napi_uint8_array ||
+        mask.As<TypedArray>().ElementLength() != source.length) {
+      RangeError::New(env,
+                      "nulls of " + source.title +
+                        " must be a Uint8Array as long as the column")
+        .ThrowAsJavaScriptException();
+      return;
+    }
+    source.nulls = mask.As<Uint8Array>().Data();
+  }
+  // rows added one by one come first
+  if (!FlushRows(env)) {
+    return;
+  }
+  // as with addRows, the rows before the first invalid value are written and
+  // the call throws, whatever the batch they fall in
+  const uint64_t rows = sources.empty() ? 0 : sources[0].length;
+  for (uint64_t start = 0; start < rows; start += batchSize) {
+    uint64_t n = std::min(batchSize, rows - start);
+    size_t invalid = sources.size();
+    auto& fields = static_cast<StructVectorBatch&>(encoder->Batch()).fields;
+    for (size_t i = 0; i < sources.size(); i++) {
+      const uint64_t filled = n;
+      sources[i].batch = fields[i];
+      if (!FillColumn(env, sources[i], start, n, encoder->Strings())) {
+        return;
+      }
+      if (n < filled) {
+        invalid = i;
+      }
+    }
+    if (n > 0) {
+      SealBatch(encoder->Batch(), n);
+      if (!encoder->Submit()) {
+        Error::New(env, encoder->Failure()).ThrowAsJavaScriptException();
+        return;
+      }
+    }
+    if (invalid < sources.size()) {
+      TypeError::New(env, "Invalid value for column " + sources[invalid].title)
+        .ThrowAsJavaScriptException();
+      return;
+    }
+  }
+}
+}
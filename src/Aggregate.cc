@@ -0,0 +1,669 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Aggregate.h"
+#include "Filter.h"
+#include "StripeScan.h"
+#include "ValidateArguments.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+using namespace Napi;
+using namespace orc;
+
+using std::numeric_limits;
+using std::unordered_map;
+
+namespace norc {
+
+/**
+ * Count, sum, minimum and maximum of the rows of a batch where mask is 1.
+ */
+struct LongTotals
+{
+  uint64_t count = 0;
+  __int128 sum = 0;
+  int64_t min = numeric_limits<int64_t>::max();
+  int64_t max = numeric_limits<int64_t>::min();
+};
+struct RealTotals
+{
+  uint64_t count = 0;
+  double sum = 0;
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+};
+
+/**
+ * Masked rows are turned into the neutral value of each total with bit masks
+ * instead of branches, so the loop vectorizes. The sum is split into the low
+ * and high 32 bits of the values, neither half can overflow within a batch.
+ */
+static LongTotals
+SumLongs(const int64_t* values, const char* mask, uint64_t rows)
+{
+  LongTotals out;
+  uint64_t low = 0;
+  int64_t high = 0;
+  int64_t min = out.min;
+  int64_t max = out.max;
+  uint64_t count = 0;
+  for (uint64_t i = 0; i < rows; i++) {
+    const int64_t selected = -static_cast<int64_t>(mask[i]);
+    const int64_t value = values[i] & selected;
+    count += static_cast<uint64_t>(mask[i]);
+    low += static_cast<uint64_t>(value) & 0xffffffffU;
+    high += value >> 32;
+    min = std::min(min, value | (numeric_limits<int64_t>::max() & ~selected));
+    max = std::max(max, value | (numeric_limits<int64_t>::min() & ~selected));
+  }
+  out.count = count;
+  out.sum = static_cast<__int128>(high) * 4294967296 + low;
+  out.min = min;
+  out.max = max;
+  return out;
+}
+/**
+ * Floating point sums are not reassociated by the compiler, four independent
+ * partial sums keep the loop vectorizable.
+ */
+static RealTotals
+SumReals(const double* values, const char* mask, uint64_t rows)
+{
+  RealTotals out;
+  double sums[4] = { 0, 0, 0, 0 };
+  double mins[4] = { out.min, out.min, out.min, out.min };
+  double maxs[4] = { out.max, out.max, out.max, out.max };
+  uint64_t count = 0;
+  uint64_t i = 0;
+  for (; i + 4 <= rows; i += 4) {
+    for (int lane = 0; lane < 4; lane++) {
+      const bool selected = mask[i + lane] != 0;
+      const double value = values[i + lane];
+      sums[lane] += selected ? value : 0.0;
+      mins[lane] = selected && value < mins[lane] ? value : mins[lane];
+      maxs[lane] = selected && value > maxs[lane] ? value : maxs[lane];
+    }
+  }
+  for (; i < rows; i++) {
+    const bool selected = mask[i] != 0;
+    sums[0] += selected ? values[i] : 0.0;
+    mins[0] = selected && values[i] < mins[0] ? values[i] : mins[0];
+    maxs[0] = selected && values[i] > maxs[0] ? values[i] : maxs[0];
+  }
+  for (i = 0; i < rows; i++) {
+    count += static_cast<uint64_t>(mask[i]);
+  }
+  out.count = count;
+  out.sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+  out.min = std::min(std::min(mins[0], mins[1]), std::min(mins[2], mins[3]));
+  out.max = std::max(std::max(maxs[0], maxs[1]), std::max(maxs[2], maxs[3]));
+  return out;
+}
+
+ColumnAggregate::ColumnAggregate(const NorcColumnMetadata& column, uint32_t ops)
+  : ops(ops)
+{
+  values.column = column.title;
+  values.kind = column.type;
+}
+uint32_t
+ColumnAggregate::Supported(orc::TypeKind kind)
+{
+  switch (kind) {
+    case TypeKind::BOOLEAN:
+    case TypeKind::BYTE:
+    case TypeKind::SHORT:
+    case TypeKind::INT:
+    case TypeKind::LONG:
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+    case TypeKind::DECIMAL:
+      return ALL;
+    case TypeKind::DATE:
+    case TypeKind::TIMESTAMP:
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR:
+      return COUNT | MIN | MAX;
+    case TypeKind::BINARY:
+      return COUNT;
+    default:
+      return 0;
+  }
+}
+bool
+ColumnAggregate::ParseOps(Napi::Env env,
+                          const Napi::Array& names,
+                          uint32_t& ops)
+{
+  ops = 0;
+  for (uint32_t i = 0; i < names.Length(); i++) {
+    string name = names.Get(i).ToString();
+    if (name == "count") {
+      ops |= COUNT;
+    } else if (name == "sum") {
+      ops |= SUM;
+    } else if (name == "min") {
+      ops |= MIN;
+    } else if (name == "max") {
+      ops |= MAX;
+    } else if (name == "avg") {
+      ops |= AVG;
+    } else {
+      RangeError::New(env,
+                      name + " is not an aggregate, expected count, sum, "
+                             "min, max or avg")
+        .ThrowAsJavaScriptException();
+      return false;
+    }
+  }
+  return true;
+}
+bool
+ColumnAggregate::IsReal() const
+{
+  return values.kind == TypeKind::FLOAT || values.kind == TypeKind::DOUBLE ||
+         values.kind == TypeKind::DECIMAL;
+}
+bool
+ColumnAggregate::Covers(const ColumnSummary& stats) const
+{
+  if (stats.count == 0) {
+    return true;
+  }
+  if ((ops & (SUM | AVG)) != 0 && !stats.hasSum) {
+    return false;
+  }
+  return (ops & (MIN | MAX)) == 0 || stats.hasMinMax;
+}
+void
+ColumnAggregate::AddBounds(const ColumnSummary& other)
+{
+  if (!other.hasMinMax) {
+    return;
+  }
+  if (!values.hasMinMax) {
+    values.hasMinMax = true;
+    values.minInteger = other.minInteger;
+    values.maxInteger = other.maxInteger;
+    values.minNanos = other.minNanos;
+    values.maxNanos = other.maxNanos;
+    values.minReal = other.minReal;
+    values.maxReal = other.maxReal;
+    values.minText = other.minText;
+    values.maxText = other.maxText;
+    return;
+  }
+  switch (values.kind) {
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+    case TypeKind::DECIMAL:
+      values.minReal = std::min(values.minReal, other.minReal);
+      values.maxReal = std::max(values.maxReal, other.maxReal);
+      break;
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR:
+      if (other.minText < values.minText) {
+        values.minText = other.minText;
+      }
+      if (other.maxText > values.maxText) {
+        values.maxText = other.maxText;
+      }
+      break;
+    case TypeKind::TIMESTAMP:
+      if (std::make_pair(other.minInteger, other.minNanos) <
+          std::make_pair(values.minInteger, values.minNanos)) {
+        values.minInteger = other.minInteger;
+        values.minNanos = other.minNanos;
+      }
+      if (std::make_pair(other.maxInteger, other.maxNanos) >
+          std::make_pair(values.maxInteger, values.maxNanos)) {
+        values.maxInteger = other.maxInteger;
+        values.maxNanos = other.maxNanos;
+      }
+      break;
+    default:
+      values.minInteger = std::min(values.minInteger, other.minInteger);
+      values.maxInteger = std::max(values.maxInteger, other.maxInteger);
+      break;
+  }
+}
+void
+ColumnAggregate::Add(const ColumnSummary& stats)
+{
+  values.count += stats.count;
+  values.hasNull = values.hasNull || stats.hasNull;
+  if (stats.count > 0) {
+    AddBounds(stats);
+  }
+  if (stats.hasSum) {
+    if (IsReal()) {
+      realSum += stats.sumReal;
+    } else {
+      integerSum += stats.sumInteger;
+    }
+  }
+}
+void
+ColumnAggregate::Add(const orc::ColumnVectorBatch& batch, const char* selected)
+{
+  const uint64_t rows = batch.numElements;
+  const char* present = batch.hasNulls ? batch.notNull.data() : nullptr;
+  mask.resize(rows);
+  char* m = mask.data();
+  char nulls = 0;
+  if (present != nullptr && selected != nullptr) {
+    for (uint64_t i = 0; i < rows; i++) {
+      m[i] = static_cast<char>(present[i] & selected[i]);
+      nulls |= static_cast<char>(selected[i] & (present[i] ^ 1));
+    }
+  } else if (present != nullptr) {
+    for (uint64_t i = 0; i < rows; i++) {
+      m[i] = present[i];
+      nulls |= static_cast<char>(present[i] ^ 1);
+    }
+  } else if (selected != nullptr) {
+    std::memcpy(m, selected, rows);
+  } else {
+    std::memset(m, 1, rows);
+  }
+  values.hasNull = values.hasNull || nulls != 0;
+  ColumnSummary totals;
+  totals.kind = values.kind;
+  switch (values.kind) {
+    case TypeKind::BOOLEAN:
+    case TypeKind::BYTE:
+    case TypeKind::SHORT:
+    case TypeKind::INT:
+    case TypeKind::LONG:
+    case TypeKind::DATE: {
+      LongTotals t = SumLongs(
+        dynamic_cast<const LongVectorBatch&>(batch).data.data(), m, rows);
+      totals.count = t.count;
+      totals.minInteger = t.min;
+      totals.maxInteger = t.max;
+      integerSum += t.sum;
+      break;
+    }
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+    case TypeKind::DECIMAL: {
+      const double* data = nullptr;
+      if (values.kind != TypeKind::DECIMAL) {
+        data = dynamic_cast<const DoubleVectorBatch&>(batch).data.data();
+      } else if (auto d64 = dynamic_cast<const Decimal64VectorBatch*>(&batch)) {
+        reals.resize(rows);
+        const double divisor = std::pow(10.0, d64->scale);
+        for (uint64_t i = 0; i < rows; i++) {
+          reals[i] = static_cast<double>(d64->values[i]) / divisor;
+        }
+        data = reals.data();
+      } else {
+        auto& d128 = dynamic_cast<const Decimal128VectorBatch&>(batch);
+        reals.resize(rows);
+        for (uint64_t i = 0; i < rows; i++) {
+          reals[i] =
+            m[i] ? strtod(d128.values[i].toDecimalString(d128.scale).c_str(),
+                          nullptr)
+                 : 0;
+        }
+        data = reals.data();
+      }
+      RealTotals t = SumReals(data, m, rows);
+      totals.count = t.count;
+      totals.minReal = t.min;
+      totals.maxReal = t.max;
+      realSum += t.sum;
+      break;
+    }
+    case TypeKind::TIMESTAMP: {
+      auto& timestamps = dynamic_cast<const TimestampVectorBatch&>(batch);
+      const int64_t* seconds = timestamps.data.data();
+      const int64_t* nanos = timestamps.nanoseconds.data();
+      uint64_t min = rows;
+      uint64_t max = rows;
+      for (uint64_t i = 0; i < rows; i++) {
+        if (!m[i]) {
+          continue;
+        }
+        totals.count++;
+        const auto value = std::make_pair(seconds[i], nanos[i]);
+        if (min == rows || value < std::make_pair(seconds[min], nanos[min])) {
+          min = i;
+        }
+        if (max == rows || value > std::make_pair(seconds[max], nanos[max])) {
+          max = i;
+        }
+      }
+      if (totals.count > 0) {
+        // the representation of the statistics, milliseconds and the
+        // nanoseconds below them
+        totals.minInteger = seconds[min] * 1000 + nanos[min] / 1000000;
+        totals.minNanos = nanos[min] % 1000000;
+        totals.maxInteger = seconds[max] * 1000 + nanos[max] / 1000000;
+        totals.maxNanos = nanos[max] % 1000000;
+      }
+      break;
+    }
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR: {
+      auto& strings = dynamic_cast<const StringVectorBatch&>(batch);
+      const char* min = nullptr;
+      const char* max = nullptr;
+      size_t minLength = 0;
+      size_t maxLength = 0;
+      auto compare = [](const char* a, size_t a_n, const char* b, size_t b_n) {
+        const size_t common = std::min(a_n, b_n);
+        const int order = common == 0 ? 0 : std::memcmp(a, b, common);
+        return order != 0 ? order : (a_n > b_n) - (a_n < b_n);
+      };
+      for (uint64_t i = 0; i < rows; i++) {
+        if (!m[i]) {
+          continue;
+        }
+        const char* value = strings.data[i];
+        const auto length = static_cast<size_t>(strings.length[i]);
+        if (totals.count == 0 || compare(value, length, min, minLength) < 0) {
+          min = value;
+          minLength = length;
+        }
+        if (totals.count == 0 || compare(value, length, max, maxLength) > 0) {
+          max = value;
+          maxLength = length;
+        }
+        totals.count++;
+      }
+      if (totals.count > 0) {
+        totals.minText.assign(min, minLength);
+        totals.maxText.assign(max, maxLength);
+      }
+      break;
+    }
+    default:
+      for (uint64_t i = 0; i < rows; i++) {
+        totals.count += static_cast<uint64_t>(m[i]);
+      }
+      break;
+  }
+  totals.hasMinMax = totals.count > 0 && (Supported(values.kind) & MIN) != 0;
+  values.count += totals.count;
+  AddBounds(totals);
+}
+void
+ColumnAggregate::Merge(const ColumnAggregate& other)
+{
+  values.count += other.values.count;
+  values.hasNull = values.hasNull || other.values.hasNull;
+  AddBounds(other.values);
+  integerSum += other.integerSum;
+  realSum += other.realSum;
+}
+Napi::Object
+ColumnAggregate::ToObject(Napi::Env env) const
+{
+  auto out = Object::New(env);
+  const bool empty = values.count == 0;
+  const double sum =
+    IsReal() ? realSum : static_cast<double>(integerSum);
+  if ((ops & COUNT) != 0) {
+    out.Set("count", static_cast<double>(values.count));
+  }
+  if ((ops & SUM) != 0) {
+    out.Set("sum", empty ? env.Null() : Number::New(env, sum));
+  }
+  if ((ops & MIN) != 0) {
+    out.Set("min", empty ? env.Null() : values.Min(env));
+  }
+  if ((ops & MAX) != 0) {
+    out.Set("max", empty ? env.Null() : values.Max(env));
+  }
+  if ((ops & AVG) != 0) {
+    out.Set("avg",
+            empty ? env.Null()
+                  : Number::New(env, sum / static_cast<double>(values.count)));
+  }
+  return out;
+}
+
+class AggregateWorker : public AsyncWorker
+{
+public:
+  AggregateWorker(Function& cb,
+                  Napi::Value self,
+                  vector<NorcColumnMetadata> columns,
+                  vector<uint32_t> ops,
+                  ScanOptions scan)
+    : AsyncWorker(cb, "aggregate_worker", self.As<Object>())
+    , reader(Reader::Unwrap(self.As<Object>()))
+    , columns(std::move(columns))
+    , ops(std::move(ops))
+    , scan(std::move(scan))
+  {}
+
+protected:
+  void Execute() override
+  {
+    try {
+      const orc::Reader& file = *reader->reader;
+      for (size_t i = 0; i < columns.size(); i++) {
+        totals.emplace_back(columns[i], ops[i]);
+      }
+      if (!scan.where && AddStatistics(*file.getStatistics())) {
+        rows = file.getNumberOfRows();
+        return;
+      }
+      reader->LoadStripeStatistics();
+      // stripes the statistics cannot answer, decoded below
+      vector<uint64_t> decode;
+      const bool hasStripeStatistics =
+        file.getNumberOfStripeStatistics() == file.getNumberOfStripes();
+      std::list<uint64_t> fields;
+      if (scan.where) {
+        scan.where->CollectFields(fields);
+      }
+      for (uint64_t i = 0; i < file.getNumberOfStripes(); i++) {
+        if (!hasStripeStatistics) {
+          decode.emplace_back(i);
+          continue;
+        }
+        // only the stripe summaries are used, not the row indexes
+        unique_ptr<StripeStatistics> stats =
+          file.getStripeStatistics(i, false);
+        Truth truth = Truth::Yes;
+        if (scan.where) {
+          unordered_map<uint64_t, ColumnSummary> summaries;
+          for (auto field : fields) {
+            auto& meta = reader->fileMeta[field];
+            summaries.emplace(
+              field,
+              ColumnSummary::From(*stats->getColumnStatistics(meta.columnId),
+                                  meta));
+          }
+          truth = EvaluateStatistics(*scan.where, summaries);
+        }
+        if (truth == Truth::No) {
+          continue;
+        }
+        if (truth == Truth::Yes && AddStatistics(*stats)) {
+          rows += file.getStripe(i)->getNumberOfRows();
+          continue;
+        }
+        decode.emplace_back(i);
+      }
+      if (!decode.empty()) {
+        Decode(file, decode);
+      }
+    } catch (std::exception& ex) {
+      SetError(ex.what());
+    }
+  }
+  void OnOK() override
+  {
+    auto out = Object::New(Env());
+    out.Set("rows", static_cast<double>(rows));
+    auto values = Object::New(Env());
+    for (auto& total : totals) {
+      values.Set(total.values.column, total.ToObject(Env()));
+    }
+    out.Set("columns", values);
+    Callback().Call({ Env().Null(), out });
+  }
+
+private:
+  Reader* reader;
+  vector<NorcColumnMetadata> columns;
+  vector<uint32_t> ops;
+  ScanOptions scan;
+  vector<ColumnAggregate> totals;
+  uint64_t rows = 0;
+
+  /**
+   * Add the statistics of the file or a stripe when they cover every column,
+   * returns false and adds nothing otherwise.
+   */
+  bool AddStatistics(const orc::Statistics& stats)
+  {
+    vector<ColumnSummary> summaries;
+    for (size_t i = 0; i < columns.size(); i++) {
+      summaries.emplace_back(ColumnSummary::From(
+        *stats.getColumnStatistics(columns[i].columnId), columns[i]));
+      if (!totals[i].Covers(summaries.back())) {
+        return false;
+      }
+    }
+    for (size_t i = 0; i < columns.size(); i++) {
+      totals[i].Add(summaries[i]);
+    }
+    return true;
+  }
+  void Decode(const orc::Reader& file, const vector<uint64_t>& stripes)
+  {
+    StripeScan scanner(file, scan, stripes);
+    // position of every aggregated column in the selected struct
+    const orc::Type& selected = scanner.SelectedType();
+    vector<size_t> positions;
+    for (auto& column : columns) {
+      for (uint64_t i = 0; i < selected.getSubtypeCount(); i++) {
+        if (selected.getFieldName(i) == column.title) {
+          positions.emplace_back(i);
+        }
+      }
+    }
+    struct Partial
+    {
+      vector<ColumnAggregate> totals;
+      uint64_t rows = 0;
+    };
+    vector<Partial> partials(scanner.Size());
+    for (auto& partial : partials) {
+      for (size_t i = 0; i < columns.size(); i++) {
+        partial.totals.emplace_back(columns[i], ops[i]);
+      }
+    }
+    scanner.Run([&](size_t range,
+                    const ColumnVectorBatch& batch,
+                    const Selection* selection) {
+      Partial& partial = partials[range];
+      const char* mask = nullptr;
+      if (selection != nullptr) {
+        partial.rows += selection->rows.size();
+        mask = selection->mask.data();
+      } else {
+        partial.rows += batch.numElements;
+      }
+      auto& fields = dynamic_cast<const StructVectorBatch&>(batch).fields;
+      for (size_t i = 0; i < positions.size(); i++) {
+        partial.totals[i].Add(*fields[positions[i]], mask);
+      }
+    });
+    for (auto& partial : partials) {
+      rows += partial.rows;
+      for (size_t i = 0; i < totals.size(); i++) {
+        totals[i].Merge(partial.totals[i]);
+      }
+    }
+  }
+};
+
+void
+Reader::Aggregate(const CallbackInfo& info)
+{
+  AssertCallbackInfo(info,
+                     { { 0, { option(napi_object) } },
+                       { 1, { option(napi_function) } } });
+  if (info.Env().IsExceptionPending()) {
+    return;
+  }
+  auto options = info[0].As<Object>();
+  auto cb = info[1].As<Function>();
+  ScanOptions scan;
+  if (!ParseScanOptions(info.Env(), options, scan)) {
+    return;
+  }
+  if (scan.offset > 0 || scan.limit != numeric_limits<uint64_t>::max()) {
+    RangeError::New(info.Env(), "aggregate does not support offset and limit")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  uint32_t requested = ColumnAggregate::ALL;
+  const bool explicitOps = options.Has("ops");
+  if (explicitOps) {
+    if (!ColumnAggregate::ParseOps(
+          info.Env(), options.Get("ops").As<Array>(), requested)) {
+      return;
+    }
+  }
+  vector<NorcColumnMetadata> columns;
+  vector<uint32_t> ops;
+  for (auto& column : fileMeta) {
+    const bool listed =
+      std::find(scan.includes.begin(), scan.includes.end(), column.index) !=
+        scan.includes.end() &&
+      std::find(scan.hidden.begin(), scan.hidden.end(), column.title) ==
+        scan.hidden.end();
+    if (!scan.includes.empty() && !listed) {
+      continue;
+    }
+    const uint32_t supported = ColumnAggregate::Supported(column.type);
+    if (supported == 0 || (explicitOps && (requested & ~supported) != 0)) {
+      // without a columns option, columns the ops do not apply to are skipped
+      if (!listed) {
+        continue;
+      }
+      TypeError::New(info.Env(),
+                     "Aggregate not supported for column " + column.title +
+                       " of type " +
+                       reader->getType().getSubtype(column.index)->toString())
+        .ThrowAsJavaScriptException();
+      return;
+    }
+    columns.emplace_back(column);
+    ops.emplace_back(requested & supported);
+  }
+  auto worker = new AggregateWorker(
+    cb, info.This(), std::move(columns), std::move(ops), std::move(scan));
+  worker->Queue();
+}
+}
@@ -0,0 +1,95 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NORC_AGGREGATE_H
+#define NORC_AGGREGATE_H
+
+#include "Reader.h"
+#include "Statistics.h"
+#include <napi.h>
+#include <orc/OrcFile.hh>
+#include <vector>
+
+using std::vector;
+
+namespace norc {
+
+/**
+ * Running count, sum, minimum and maximum of the non null values of a column.
+ * Values are added either as the statistics of a whole stripe or as decoded
+ * batches, so stripes the statistics answer are never decoded.
+ */
+struct ColumnAggregate
+{
+  enum Op : uint32_t
+  {
+    COUNT = 1,
+    SUM = 2,
+    MIN = 4,
+    MAX = 8,
+    AVG = 16,
+    ALL = 31
+  };
+
+  ColumnAggregate(const NorcColumnMetadata&, uint32_t ops);
+  /**
+   * The ops that apply to a kind of column, sum and avg need numbers or
+   * booleans (the number of true values), min and max comparable values.
+   */
+  static uint32_t Supported(orc::TypeKind);
+  /**
+   * Parse an array of op names into ops. Throws a JS exception and returns
+   * false on a name that is not an op.
+   */
+  static bool ParseOps(Napi::Env, const Napi::Array& names, uint32_t& ops);
+  /**
+   * Whether the statistics hold everything the ops need.
+   */
+  bool Covers(const ColumnSummary&) const;
+  void Add(const ColumnSummary&);
+  /**
+   * Add the values of a batch of the column, only the rows where selected is
+   * 1 when selected is not null.
+   */
+  void Add(const orc::ColumnVectorBatch&, const char* selected);
+  void Merge(const ColumnAggregate&);
+  /**
+   * {count, sum, min, max, avg} limited to the ops, sum, min, max and avg are
+   * null when there are no values.
+   */
+  Napi::Object ToObject(Napi::Env) const;
+
+  uint32_t ops;
+  // count, hasNull, minimum and maximum
+  ColumnSummary values;
+  // sum of BOOLEAN and integer kinds, wide enough to never overflow
+  __int128 integerSum = 0;
+  // sum of FLOAT, DOUBLE and DECIMAL
+  double realSum = 0;
+
+private:
+  bool IsReal() const;
+  void AddBounds(const ColumnSummary&);
+
+  // scratch space of Add
+  vector<char> mask;
+  vector<double> reals;
+};
+}
+
+#endif // NORC_AGGREGATE_H
@@ -0,0 +1,348 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NORC_APPENDER_H
+#define NORC_APPENDER_H
+
+#include "Internal.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <napi.h>
+#include <orc/OrcFile.hh>
+#include <stdexcept>
+#include <strings.h>
+#include <string>
+#include <type_traits>
+
+namespace norc {
+
+/**
+ * Writes the values of a column of kind Kind into its batch field. The field
+ * is cast to its concrete batch type once, when the appender is created, so
+ * filling a column is a loop of plain stores with the conversion of the kind
+ * compiled in. Wide selects Decimal128VectorBatch for a DECIMAL column.
+ *
+ * Set converts a JS value (add, addRow, addColumns) and Parse a CSV field
+ * (fromCsv), both return false when the value is not one of the column.
+ * numElements and hasNulls are left to SealBatch, once every row was written.
+ */
+template<orc::TypeKind Kind, bool Wide = false>
+class Appender
+{
+public:
+  static constexpr bool IsInteger =
+    Kind == orc::TypeKind::BYTE || Kind == orc::TypeKind::SHORT ||
+    Kind == orc::TypeKind::INT || Kind == orc::TypeKind::LONG;
+  static constexpr bool IsReal =
+    Kind == orc::TypeKind::FLOAT || Kind == orc::TypeKind::DOUBLE;
+  static constexpr bool IsText =
+    Kind == orc::TypeKind::STRING || Kind == orc::TypeKind::VARCHAR ||
+    Kind == orc::TypeKind::CHAR || Kind == orc::TypeKind::BINARY;
+  static constexpr bool IsDecimal = Kind == orc::TypeKind::DECIMAL;
+  using Decimal = std::conditional_t<Wide,
+                                     orc::Decimal128VectorBatch,
+                                     orc::Decimal64VectorBatch>;
+  using Batch = std::conditional_t<
+    IsReal,
+    orc::DoubleVectorBatch,
+    std::conditional_t<
+      IsText,
+      orc::StringVectorBatch,
+      std::conditional_t<
+        Kind == orc::TypeKind::TIMESTAMP,
+        orc::TimestampVectorBatch,
+        std::conditional_t<Kind == orc::TypeKind::DECIMAL,
+                           Decimal,
+                           orc::LongVectorBatch>>>>;
+
+  Appender(orc::ColumnVectorBatch& field,
+           const orc::Type& type,
+           StringArena& strings)
+    : batch(static_cast<Batch&>(field))
+    , notNull(field.notNull.data())
+    , strings(strings)
+  {
+    if constexpr (Kind == orc::TypeKind::DECIMAL) {
+      scale = static_cast<int32_t>(type.getScale());
+      factor = std::pow(10.0, scale);
+      batch.scale = scale;
+      batch.precision = static_cast<int32_t>(type.getPrecision());
+    }
+  }
+
+  void SetNull(uint64_t row) { notNull[row] = 0; }
+
+  bool Set(uint64_t row, const Napi::Value& value)
+  {
+    notNull[row] = 1;
+    if constexpr (Kind == orc::TypeKind::BOOLEAN) {
+      batch.data[row] = value.ToBoolean().Value() ? 1 : 0;
+      return true;
+    } else if constexpr (IsInteger) {
+      return SetInteger(row, value);
+    } else if constexpr (Kind == orc::TypeKind::DATE) {
+      // days since epoch, or a YYYY-mm-dd string or a Date in UTC
+      if (value.IsString()) {
+        return ParseDate(value.As<Napi::String>().Utf8Value(), batch.data[row]);
+      }
+      if (value.IsDate()) {
+        const double millis = value.As<Napi::Date>().ValueOf();
+        batch.data[row] = static_cast<int64_t>(std::floor(millis / 86400000));
+        return true;
+      }
+      return SetInteger(row, value);
+    } else if constexpr (IsReal) {
+      if (!value.IsNumber()) {
+        return false;
+      }
+      batch.data[row] = value.As<Napi::Number>().DoubleValue();
+      return true;
+    } else if constexpr (Kind == orc::TypeKind::TIMESTAMP) {
+      // epoch milliseconds, epoch nanoseconds as a BigInt, a Date or a
+      // YYYY-mm-dd HH:MM:SS[.n] string in UTC
+      int64_t& seconds = batch.data[row];
+      int64_t& nanos = batch.nanoseconds[row];
+      if (value.IsNumber() || value.IsDate()) {
+        const double millis = value.IsDate()
+                                ? value.As<Napi::Date>().ValueOf()
+                                : value.As<Napi::Number>().DoubleValue();
+        if (!FitsInt64(millis)) {
+          return false;
+        }
+        SplitMillis(millis, seconds, nanos);
+      } else if (value.IsBigInt()) {
+        bool lossless;
+        SplitNanos(
+          value.As<Napi::BigInt>().Int64Value(&lossless), seconds, nanos);
+      } else {
+        return value.IsString() &&
+               ParseTimestamp(
+                 value.As<Napi::String>().Utf8Value(), seconds, nanos);
+      }
+      return true;
+    } else if constexpr (Kind == orc::TypeKind::DECIMAL) {
+      if (value.IsNumber()) {
+        return SetDecimal(row, value.As<Napi::Number>().DoubleValue());
+      }
+      orc::Int128 unscaled;
+      return value.IsString() &&
+             ParseDecimal(
+               value.As<Napi::String>().Utf8Value(), scale, unscaled) &&
+             SetUnscaled(row, unscaled);
+    } else {
+      static_assert(IsText, "unsupported kind");
+      if (value.IsBuffer()) {
+        auto bytes = value.As<Napi::Buffer<char>>();
+        batch.data[row] = strings.Copy(bytes.Data(), bytes.Length());
+        batch.length[row] = static_cast<int64_t>(bytes.Length());
+        return true;
+      }
+      // encoded straight into the arena, with room for the terminator napi
+      // writes, other values are written as their string conversion
+      Napi::Value text = value.IsString() ? value : value.ToString();
+      size_t length = 0;
+      napi_get_value_string_utf8(text.Env(), text, nullptr, 0, &length);
+      char* out = strings.Allocate(length + 1);
+      napi_get_value_string_utf8(text.Env(), text, out, length + 1, &length);
+      batch.data[row] = out;
+      batch.length[row] = static_cast<int64_t>(length);
+      return true;
+    }
+  }
+
+  bool Parse(uint64_t row, const std::string& text)
+  {
+    notNull[row] = 1;
+    if constexpr (Kind == orc::TypeKind::BOOLEAN) {
+      batch.data[row] = strcasecmp(text.c_str(), "true") == 0 ||
+                        strcasecmp(text.c_str(), "t") == 0 || text == "1";
+      return true;
+    } else if constexpr (IsInteger) {
+      char* end;
+      batch.data[row] = strtoll(text.c_str(), &end, 10);
+      return end != text.c_str();
+    } else if constexpr (Kind == orc::TypeKind::DATE) {
+      return ParseDate(text, batch.data[row]);
+    } else if constexpr (IsReal) {
+      char* end;
+      batch.data[row] = strtod(text.c_str(), &end);
+      return end != text.c_str();
+    } else if constexpr (Kind == orc::TypeKind::TIMESTAMP) {
+      return ParseTimestamp(
+        text, batch.data[row], batch.nanoseconds[row]);
+    } else if constexpr (Kind == orc::TypeKind::DECIMAL) {
+      orc::Int128 unscaled;
+      return ParseDecimal(text, scale, unscaled) && SetUnscaled(row, unscaled);
+    } else {
+      static_assert(IsText, "unsupported kind");
+      batch.data[row] = strings.Copy(text.data(), text.size());
+      batch.length[row] = static_cast<int64_t>(text.size());
+      return true;
+    }
+  }
+
+  /**
+   * Write a number into a DECIMAL column, rounded to its scale. Returns false
+   * when the number is not finite or its unscaled value does not fit in 64
+   * bits.
+   */
+  bool SetDecimal(uint64_t row, double number)
+  {
+    static_assert(IsDecimal, "not a decimal column");
+    const double scaled = number * factor;
+    if (!std::isfinite(scaled) || std::fabs(scaled) >= 9.2e18) {
+      return false;
+    }
+    return SetUnscaled(row, orc::Int128(std::llround(scaled)));
+  }
+
+private:
+  bool SetInteger(uint64_t row, const Napi::Value& value)
+  {
+    if (value.IsNumber()) {
+      batch.data[row] = value.As<Napi::Number>().Int64Value();
+    } else if (value.IsBigInt()) {
+      bool lossless;
+      batch.data[row] = value.As<Napi::BigInt>().Int64Value(&lossless);
+    } else if (value.IsBoolean()) {
+      batch.data[row] = value.As<Napi::Boolean>().Value() ? 1 : 0;
+    } else {
+      return false;
+    }
+    return true;
+  }
+  // false when the value needs more digits than a Decimal64VectorBatch holds
+  bool SetUnscaled(uint64_t row, const orc::Int128& unscaled)
+  {
+    if constexpr (Wide) {
+      batch.values[row] = unscaled;
+    } else {
+      if (!unscaled.fitsInLong()) {
+        return false;
+      }
+      batch.values[row] = unscaled.toLong();
+    }
+    return true;
+  }
+
+  Batch& batch;
+  char* notNull;
+  StringArena& strings;
+  int32_t scale = 0;
+  double factor = 1;
+};
+
+/**
+ * Call visit with the appender of a column, the kind is switched on once per
+ * call, not once per value. Returns what visit returns, throws
+ * std::invalid_argument for the kinds that cannot be written.
+ */
+template<typename Visit>
+bool
+VisitAppender(const orc::Type& type,
+              orc::ColumnVectorBatch& field,
+              StringArena& strings,
+              Visit&& visit)
+{
+  using orc::TypeKind;
+  switch (type.getKind()) {
+    case TypeKind::BOOLEAN: {
+      Appender<TypeKind::BOOLEAN> appender(field, type, strings);
+      return visit(appender);
+    }
+    case TypeKind::BYTE: {
+      Appender<TypeKind::BYTE> appender(field, type, strings);
+      return visit(appender);
+    }
+    case TypeKind::SHORT: {
+      Appender<TypeKind::SHORT> appender(field, type, strings);
+      return visit(appender);
+    }
+    case TypeKind::INT: {
+      Appender<TypeKind::INT> appender(field, type, strings);
+      return visit(appender);
+    }
+    case TypeKind::LONG: {
+      Appender<TypeKind::LONG> appender(field, type, strings);
+      return visit(appender);
+    }
+    case TypeKind::DATE: {
+      Appender<TypeKind::DATE> appender(field, type, strings);
+      return visit(appender);
+    }
+    case TypeKind::FLOAT: {
+      Appender<TypeKind::FLOAT> appender(field, type, strings);
+      return visit(appender);
+    }
+    case TypeKind::DOUBLE: {
+      Appender<TypeKind::DOUBLE> appender(field, type, strings);
+      return visit(appender);
+    }
+    case TypeKind::TIMESTAMP: {
+      Appender<TypeKind::TIMESTAMP> appender(field, type, strings);
+      return visit(appender);
+    }
+    case TypeKind::DECIMAL: {
+      // same choice of batch as orc::Type::createRowBatch
+      if (type.getPrecision() == 0 || type.getPrecision() > 18) {
+        Appender<TypeKind::DECIMAL, true> appender(field, type, strings);
+        return visit(appender);
+      }
+      Appender<TypeKind::DECIMAL> appender(field, type, strings);
+      return visit(appender);
+    }
+    case TypeKind::STRING: {
+      Appender<TypeKind::STRING> appender(field, type, strings);
+      return visit(appender);
+    }
+    case TypeKind::VARCHAR: {
+      Appender<TypeKind::VARCHAR> appender(field, type, strings);
+      return visit(appender);
+    }
+    case TypeKind::CHAR: {
+      Appender<TypeKind::CHAR> appender(field, type, strings);
+      return visit(appender);
+    }
+    case TypeKind::BINARY: {
+      Appender<TypeKind::BINARY> appender(field, type, strings);
+      return visit(appender);
+    }
+    default:
+      throw std::invalid_argument(
+        "List, Map, Struct, and Union types are not currently supported");
+  }
+}
+
+/**
+ * Set the number of rows of a struct batch and of its fields, and whether
+ * each field holds a null, once the appenders wrote rows [0, rows).
+ */
+inline void
+SealBatch(orc::ColumnVectorBatch& batch, uint64_t rows)
+{
+  auto& row = static_cast<orc::StructVectorBatch&>(batch);
+  row.numElements = rows;
+  for (auto field : row.fields) {
+    field->numElements = rows;
+    field->hasNulls = memchr(field->notNull.data(), 0, rows) != nullptr;
+  }
+}
+}
+
+#endif // NORC_APPENDER_H
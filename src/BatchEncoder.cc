@@ -0,0 +1,154 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BatchEncoder.h"
+
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+namespace norc {
+
+BatchEncoder::BatchEncoder(orc::Writer& writer, uint64_t batchSize)
+  : writer(writer)
+  , batches(BATCHES)
+{
+  for (size_t i = 0; i < batches.size(); i++) {
+    batches[i].batch = writer.createRowBatch(batchSize);
+    if (i != current) {
+      idle.push_back(i);
+    }
+  }
+  thread = std::thread(&BatchEncoder::Run, this);
+}
+BatchEncoder::~BatchEncoder()
+{
+  Stop();
+}
+void
+BatchEncoder::Run()
+{
+  unique_lock<mutex> guard(lock);
+  while (true) {
+    changed.wait(guard, [this] { return stopping || !queued.empty(); });
+    if (queued.empty()) {
+      return;
+    }
+    const size_t slot = queued.front();
+    const bool failed = !failure.empty();
+    guard.unlock();
+    std::string error;
+    if (!failed) {
+      // after a failed add the file is broken, the rest is dropped
+      try {
+        lock_guard<mutex> serial(adding);
+        writer.add(*batches[slot].batch);
+      } catch (std::exception& ex) {
+        error = ex.what();
+      }
+    }
+    guard.lock();
+    queued.pop_front();
+    idle.push_back(slot);
+    if (!error.empty() && failure.empty()) {
+      failure = error;
+    }
+    changed.notify_all();
+  }
+}
+bool
+BatchEncoder::Submit()
+{
+  unique_lock<mutex> guard(lock);
+  if (stopping) {
+    failure = failure.empty() ? "The writer is closed" : failure;
+    return false;
+  }
+  queued.push_back(current);
+  changed.notify_all();
+  changed.wait(guard, [this] { return !idle.empty(); });
+  current = idle.back();
+  idle.pop_back();
+  batches[current].strings.Clear();
+  return failure.empty();
+}
+bool
+BatchEncoder::Wait()
+{
+  unique_lock<mutex> guard(lock);
+  changed.wait(guard, [this] { return queued.empty(); });
+  return failure.empty();
+}
+bool
+BatchEncoder::Encode(orc::ColumnVectorBatch& batch)
+{
+  if (!Wait()) {
+    return false;
+  }
+  lock_guard<mutex> serial(adding);
+  {
+    lock_guard<mutex> guard(lock);
+    if (stopping) {
+      return false;
+    }
+  }
+  try {
+    writer.add(batch);
+  } catch (std::exception& ex) {
+    lock_guard<mutex> guard(lock);
+    failure = ex.what();
+    return false;
+  }
+  return true;
+}
+bool
+BatchEncoder::Stop()
+{
+  {
+    lock_guard<mutex> guard(lock);
+    stopping = true;
+    changed.notify_all();
+  }
+  if (thread.joinable()) {
+    thread.join();
+  }
+  return Wait();
+}
+bool
+BatchEncoder::Close()
+{
+  if (!Stop()) {
+    return false;
+  }
+  try {
+    lock_guard<mutex> serial(adding);
+    writer.close();
+  } catch (std::exception& ex) {
+    lock_guard<mutex> guard(lock);
+    failure = ex.what();
+    return false;
+  }
+  return true;
+}
+std::string
+BatchEncoder::Failure()
+{
+  lock_guard<mutex> guard(lock);
+  return failure;
+}
+}
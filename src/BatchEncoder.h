@@ -0,0 +1,103 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NORC_BATCHENCODER_H
+#define NORC_BATCHENCODER_H
+
+#include "Internal.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <orc/OrcFile.hh>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace norc {
+
+/**
+ * Runs orc::Writer::add, the encoding and compression of a batch, on a thread
+ * of its own. The JS thread fills the current batch while the batches queued
+ * before it are encoded, and only waits when every batch is still queued.
+ *
+ * Each batch has its StringArena, the string bytes of a batch stay valid
+ * until it was encoded. Submit, Wait and Stop return false once an add failed,
+ * with Failure describing the error.
+ */
+class BatchEncoder
+{
+public:
+  static const size_t BATCHES = 3;
+  BatchEncoder(orc::Writer& writer, uint64_t batchSize);
+  ~BatchEncoder();
+  /**
+   * The batch being filled, and the storage of its strings.
+   */
+  orc::ColumnVectorBatch& Batch() { return *batches[current].batch; }
+  StringArena& Strings() { return batches[current].strings; }
+  /**
+   * Queue the current batch, numElements set, and move on to a free one.
+   */
+  bool Submit();
+  /**
+   * Block until every queued batch was encoded.
+   */
+  bool Wait();
+  /**
+   * Encode a batch that is not one of ours (fromCsv) on the calling thread,
+   * never at the same time as a queued one. Also returns false, with an empty
+   * Failure, once Stop was called.
+   */
+  bool Encode(orc::ColumnVectorBatch& batch);
+  /**
+   * Encode the queued batches and end the thread.
+   */
+  bool Stop();
+  /**
+   * Stop, then close the writer. A batch Encode is adding is finished first,
+   * the ones it is given afterwards are refused.
+   */
+  bool Close();
+  std::string Failure();
+
+private:
+  struct Slot
+  {
+    std::unique_ptr<orc::ColumnVectorBatch> batch;
+    StringArena strings;
+  };
+  void Run();
+
+  orc::Writer& writer;
+  std::vector<Slot> batches;
+  size_t current = 0;
+  std::deque<size_t> queued;
+  std::vector<size_t> idle;
+  bool stopping = false;
+  std::string failure;
+  // guards queued, idle, stopping and failure
+  std::mutex lock;
+  std::condition_variable changed;
+  // one orc::Writer::add at a time
+  std::mutex adding;
+  std::thread thread;
+};
+}
+
+#endif // NORC_BATCHENCODER_H
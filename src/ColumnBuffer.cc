@@ -0,0 +1,726 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ColumnBuffer.h"
+#include "Filter.h"
+#include "Internal.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace Napi;
+using namespace orc;
+
+using std::move;
+using std::runtime_error;
+
+namespace norc {
+
+/**
+ * Hand ownership of values to a JS ArrayBuffer without copying, the vector is
+ * released when the ArrayBuffer is garbage collected.
+ */
+template<typename T>
+static Napi::ArrayBuffer
+ExternalArrayBuffer(Napi::Env env, vector<T>&& values)
+{
+  if (values.empty()) {
+    return Napi::ArrayBuffer::New(env, 0);
+  }
+  auto owned = new vector<T>(move(values));
+  return Napi::ArrayBuffer::New(
+    env,
+    owned->data(),
+    owned->size() * sizeof(T),
+    [](Napi::Env, void*, vector<T>* hint) { delete hint; },
+    owned);
+}
+
+ColumnBuffer::ColumnBuffer(string title, const orc::Type* type)
+  : title(move(title))
+  , kind(type->getKind())
+{
+  switch (kind) {
+    case TypeKind::LIST:
+    case TypeKind::MAP:
+    case TypeKind::STRUCT:
+    case TypeKind::UNION:
+      throw runtime_error(
+        "List, Map, Struct, and Union types are not currently supported");
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR:
+    case TypeKind::BINARY:
+      offsets.emplace_back(0);
+      break;
+    default:
+      break;
+  }
+}
+void
+ColumnBuffer::Reserve(uint64_t rows)
+{
+  notNull.reserve(rows);
+  switch (kind) {
+    case TypeKind::BOOLEAN:
+    case TypeKind::BYTE:
+    case TypeKind::SHORT:
+    case TypeKind::INT:
+    case TypeKind::DATE:
+      ints.reserve(rows);
+      break;
+    case TypeKind::LONG:
+      longs.reserve(rows);
+      break;
+    case TypeKind::TIMESTAMP:
+      longs.reserve(rows);
+      ints.reserve(rows);
+      break;
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+    case TypeKind::DECIMAL:
+      doubles.reserve(rows);
+      break;
+    default:
+      if (dictionaryEncoded) {
+        ints.reserve(rows);
+      } else {
+        offsets.reserve(rows + 1);
+      }
+      break;
+  }
+}
+void
+ColumnBuffer::Append(const orc::ColumnVectorBatch& batch)
+{
+  AppendRows(batch, batch.numElements, [](uint64_t i) { return i; });
+}
+void
+ColumnBuffer::Append(const orc::ColumnVectorBatch& batch,
+                     const vector<uint32_t>& rows)
+{
+  const uint32_t* selected = rows.data();
+  AppendRows(batch, rows.size(), [selected](uint64_t i) -> uint64_t {
+    return selected[i];
+  });
+}
+template<typename Index>
+void
+ColumnBuffer::AppendRows(const orc::ColumnVectorBatch& batch,
+                         uint64_t n,
+                         Index row)
+{
+  const size_t start = notNull.size();
+  notNull.resize(start + n, 1);
+  char* present = notNull.data() + start;
+  if (batch.hasNulls) {
+    const char* source = batch.notNull.data();
+    for (uint64_t i = 0; i < n; i++) {
+      present[i] = source[row(i)];
+    }
+  }
+  switch (kind) {
+    case TypeKind::BOOLEAN:
+    case TypeKind::BYTE:
+    case TypeKind::SHORT:
+    case TypeKind::INT:
+    case TypeKind::DATE: {
+      const int64_t* data =
+        dynamic_cast<const LongVectorBatch&>(batch).data.data();
+      ints.resize(start + n);
+      int32_t* out = ints.data() + start;
+      for (uint64_t i = 0; i < n; i++) {
+        out[i] = static_cast<int32_t>(data[row(i)]);
+      }
+      break;
+    }
+    case TypeKind::LONG: {
+      const int64_t* data =
+        dynamic_cast<const LongVectorBatch&>(batch).data.data();
+      longs.resize(start + n);
+      int64_t* out = longs.data() + start;
+      for (uint64_t i = 0; i < n; i++) {
+        out[i] = data[row(i)];
+      }
+      break;
+    }
+    case TypeKind::FLOAT: {
+      // FLOAT values are widened to double by orc, round them back to
+      // float precision
+      const double* data =
+        dynamic_cast<const DoubleVectorBatch&>(batch).data.data();
+      doubles.resize(start + n);
+      double* out = doubles.data() + start;
+      for (uint64_t i = 0; i < n; i++) {
+        out[i] = RoundFloat(data[row(i)]);
+      }
+      break;
+    }
+    case TypeKind::DOUBLE: {
+      const double* data =
+        dynamic_cast<const DoubleVectorBatch&>(batch).data.data();
+      doubles.resize(start + n);
+      double* out = doubles.data() + start;
+      for (uint64_t i = 0; i < n; i++) {
+        out[i] = data[row(i)];
+      }
+      break;
+    }
+    case TypeKind::DECIMAL: {
+      doubles.resize(start + n);
+      double* out = doubles.data() + start;
+      if (auto d64 = dynamic_cast<const Decimal64VectorBatch*>(&batch)) {
+        const double divisor = std::pow(10.0, d64->scale);
+        for (uint64_t i = 0; i < n; i++) {
+          out[i] = static_cast<double>(d64->values[row(i)]) / divisor;
+        }
+      } else {
+        auto& d128 = dynamic_cast<const Decimal128VectorBatch&>(batch);
+        for (uint64_t i = 0; i < n; i++) {
+          out[i] =
+            present[i]
+              ? strtod(
+                  d128.values[row(i)].toDecimalString(d128.scale).c_str(),
+                  nullptr)
+              : 0;
+        }
+      }
+      break;
+    }
+    case TypeKind::TIMESTAMP: {
+      auto& tsBatch = dynamic_cast<const TimestampVectorBatch&>(batch);
+      longs.resize(start + n);
+      ints.resize(start + n);
+      int64_t* seconds = longs.data() + start;
+      int32_t* nanos = ints.data() + start;
+      for (uint64_t i = 0; i < n; i++) {
+        seconds[i] = tsBatch.data[row(i)];
+        nanos[i] = static_cast<int32_t>(tsBatch.nanoseconds[row(i)]);
+      }
+      break;
+    }
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR:
+    case TypeKind::BINARY: {
+      auto& strBatch = dynamic_cast<const StringVectorBatch&>(batch);
+      auto encoded = dynamic_cast<const EncodedStringVectorBatch*>(&batch);
+      if (encoded && !encoded->isEncoded) {
+        encoded = nullptr;
+      }
+      if (start == 0) {
+        // the storage of the column follows the encoding of its first batch
+        dictionaryEncoded = encoded && kind != TypeKind::BINARY;
+      }
+      if (dictionaryEncoded) {
+        ints.resize(start + n);
+        int32_t* codes = ints.data() + start;
+        for (uint64_t i = 0; i < n; i++) {
+          const uint64_t r = row(i);
+          uint32_t id = 0;
+          if (present[i]) {
+            id = encoded ? Intern(*encoded, encoded->index[r])
+                         : entries.Intern(strBatch.data[r], strBatch.length[r]);
+          }
+          codes[i] = static_cast<int32_t>(id);
+        }
+        break;
+      }
+      for (uint64_t i = 0; i < n; i++) {
+        if (present[i]) {
+          const uint64_t r = row(i);
+          char* data = strBatch.data[r];
+          int64_t length = strBatch.length[r];
+          if (encoded) {
+            encoded->dictionary->getValueByIndex(
+              encoded->index[r], data, length);
+          }
+          chars.insert(chars.end(), data, data + length);
+        }
+        offsets.emplace_back(chars.size());
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+uint32_t
+ColumnBuffer::Intern(const orc::EncodedStringVectorBatch& batch, int64_t index)
+{
+  if (batch.dictionary != dictionary) {
+    dictionary = batch.dictionary;
+    ids.clear();
+  }
+  const size_t i = static_cast<size_t>(index);
+  if (i >= ids.size()) {
+    ids.resize(i + 1, StringPool::MISSING);
+  }
+  if (ids[i] == StringPool::MISSING) {
+    char* data;
+    int64_t length;
+    dictionary->getValueByIndex(index, data, length);
+    ids[i] = entries.Intern(data, static_cast<size_t>(length));
+  }
+  return ids[i];
+}
+void
+ColumnBuffer::Encode()
+{
+  if (dictionaryEncoded) {
+    return;
+  }
+  ints.resize(Size());
+  for (uint64_t i = 0; i < Size(); i++) {
+    ints[i] = 0;
+    if (notNull[i]) {
+      auto value = View(i);
+      ints[i] =
+        static_cast<int32_t>(entries.Intern(value.data(), value.size()));
+    }
+  }
+  chars.clear();
+  offsets.resize(1);
+  dictionaryEncoded = true;
+}
+std::string_view
+ColumnBuffer::View(uint64_t row) const
+{
+  if (dictionaryEncoded) {
+    const uint32_t id = static_cast<uint32_t>(ints[row]);
+    return notNull[row] ? std::string_view(entries.Data(id), entries.Length(id))
+                        : std::string_view();
+  }
+  return std::string_view(chars.data() + offsets[row],
+                          offsets[row + 1] - offsets[row]);
+}
+void
+ColumnBuffer::Concat(const ColumnBuffer& other)
+{
+  if (Size() == 0) {
+    dictionaryEncoded = other.dictionaryEncoded;
+  }
+  if (dictionaryEncoded != other.dictionaryEncoded) {
+    for (uint64_t i = 0; i < other.Size(); i++) {
+      AppendFrom(other, i);
+    }
+    return;
+  }
+  if (dictionaryEncoded) {
+    // codes of the other column are translated to ids of this one
+    vector<int32_t> translated(other.entries.Size());
+    for (uint32_t id = 0; id < translated.size(); id++) {
+      translated[id] = static_cast<int32_t>(
+        entries.Intern(other.entries.Data(id), other.entries.Length(id)));
+    }
+    notNull.insert(notNull.end(), other.notNull.begin(), other.notNull.end());
+    for (uint64_t i = 0; i < other.Size(); i++) {
+      ints.emplace_back(other.notNull[i] ? translated[other.ints[i]] : 0);
+    }
+    return;
+  }
+  notNull.insert(notNull.end(), other.notNull.begin(), other.notNull.end());
+  ints.insert(ints.end(), other.ints.begin(), other.ints.end());
+  longs.insert(longs.end(), other.longs.begin(), other.longs.end());
+  doubles.insert(doubles.end(), other.doubles.begin(), other.doubles.end());
+  if (!offsets.empty()) {
+    const uint64_t base = chars.size();
+    chars.insert(chars.end(), other.chars.begin(), other.chars.end());
+    for (size_t i = 1; i < other.offsets.size(); i++) {
+      offsets.emplace_back(base + other.offsets[i]);
+    }
+  }
+}
+void
+ColumnBuffer::AppendFrom(const ColumnBuffer& other, uint64_t row)
+{
+  notNull.emplace_back(other.notNull[row]);
+  switch (kind) {
+    case TypeKind::BOOLEAN:
+    case TypeKind::BYTE:
+    case TypeKind::SHORT:
+    case TypeKind::INT:
+    case TypeKind::DATE:
+      ints.emplace_back(other.ints[row]);
+      break;
+    case TypeKind::LONG:
+      longs.emplace_back(other.longs[row]);
+      break;
+    case TypeKind::TIMESTAMP:
+      longs.emplace_back(other.longs[row]);
+      ints.emplace_back(other.ints[row]);
+      break;
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+    case TypeKind::DECIMAL:
+      doubles.emplace_back(other.doubles[row]);
+      break;
+    default: {
+      auto value = other.View(row);
+      if (dictionaryEncoded) {
+        ints.emplace_back(
+          other.notNull[row]
+            ? static_cast<int32_t>(entries.Intern(value.data(), value.size()))
+            : 0);
+      } else {
+        chars.insert(chars.end(), value.begin(), value.end());
+        offsets.emplace_back(chars.size());
+      }
+      break;
+    }
+  }
+}
+void
+ColumnBuffer::AppendNull()
+{
+  notNull.emplace_back(0);
+  switch (kind) {
+    case TypeKind::BOOLEAN:
+    case TypeKind::BYTE:
+    case TypeKind::SHORT:
+    case TypeKind::INT:
+    case TypeKind::DATE:
+      ints.emplace_back(0);
+      break;
+    case TypeKind::LONG:
+      longs.emplace_back(0);
+      break;
+    case TypeKind::TIMESTAMP:
+      longs.emplace_back(0);
+      ints.emplace_back(0);
+      break;
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+    case TypeKind::DECIMAL:
+      doubles.emplace_back(0);
+      break;
+    default:
+      if (dictionaryEncoded) {
+        ints.emplace_back(0);
+      } else {
+        offsets.emplace_back(chars.size());
+      }
+      break;
+  }
+}
+void
+ColumnBuffer::Clear()
+{
+  notNull.clear();
+  ints.clear();
+  longs.clear();
+  doubles.clear();
+  chars.clear();
+  if (!offsets.empty()) {
+    offsets.resize(1);
+  }
+  dictionaryEncoded = false;
+  entries = StringPool();
+  dictionary.reset();
+  ids.clear();
+}
+Napi::Object
+ColumnBuffer::ToTypedArray(Napi::Env env)
+{
+  const size_t n = Size();
+  auto out = Object::New(env);
+  auto nulls = Uint8Array::New(env, n);
+  uint8_t* nullData = nulls.Data();
+  for (size_t i = 0; i < n; i++) {
+    nullData[i] = static_cast<uint8_t>(notNull[i] == 0);
+  }
+  switch (kind) {
+    case TypeKind::BOOLEAN:
+    case TypeKind::BYTE:
+    case TypeKind::SHORT:
+    case TypeKind::INT:
+    case TypeKind::DATE: {
+      out.Set("values",
+              Int32Array::New(env, n, ExternalArrayBuffer(env, move(ints)), 0));
+      break;
+    }
+    case TypeKind::LONG: {
+      out.Set(
+        "values",
+        BigInt64Array::New(env, n, ExternalArrayBuffer(env, move(longs)), 0));
+      break;
+    }
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+    case TypeKind::DECIMAL: {
+      out.Set(
+        "values",
+        Float64Array::New(env, n, ExternalArrayBuffer(env, move(doubles)), 0));
+      break;
+    }
+    case TypeKind::TIMESTAMP: {
+      // epoch milliseconds, same unit as Date.prototype.getTime
+      vector<double> millis(n);
+      for (size_t i = 0; i < n; i++) {
+        millis[i] = static_cast<double>(longs[i]) * 1000.0 + ints[i] / 1000000.0;
+      }
+      out.Set(
+        "values",
+        Float64Array::New(env, n, ExternalArrayBuffer(env, move(millis)), 0));
+      break;
+    }
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR: {
+      auto values = Array::New(env, n);
+      if (dictionaryEncoded) {
+        auto strings = Entries(env);
+        for (uint32_t i = 0; i < n; i++) {
+          values.Set(i,
+                     notNull[i] ? Napi::Value(env, strings[ints[i]])
+                                : env.Null());
+        }
+        out.Set("values", values);
+        break;
+      }
+      for (uint32_t i = 0; i < n; i++) {
+        if (notNull[i]) {
+          values.Set(i,
+                     String::New(env,
+                                 chars.data() + offsets[i],
+                                 offsets[i + 1] - offsets[i]));
+        } else {
+          values.Set(i, env.Null());
+        }
+      }
+      out.Set("values", values);
+      break;
+    }
+    case TypeKind::BINARY: {
+      auto values = Array::New(env, n);
+      for (uint32_t i = 0; i < n; i++) {
+        if (notNull[i]) {
+          values.Set(i,
+                     Buffer<char>::Copy(env,
+                                        chars.data() + offsets[i],
+                                        offsets[i + 1] - offsets[i]));
+        } else {
+          values.Set(i, env.Null());
+        }
+      }
+      out.Set("values", values);
+      break;
+    }
+    default:
+      break;
+  }
+  out.Set("nulls", nulls);
+  return out;
+}
+Napi::Object
+ColumnBuffer::ToDictionary(Napi::Env env)
+{
+  Encode();
+  const size_t n = Size();
+  auto out = Object::New(env);
+  auto strings = Entries(env);
+  auto dictionary = Array::New(env, strings.size());
+  for (uint32_t id = 0; id < strings.size(); id++) {
+    dictionary.Set(id, Napi::Value(env, strings[id]));
+  }
+  auto nulls = Uint8Array::New(env, n);
+  uint8_t* nullData = nulls.Data();
+  for (size_t i = 0; i < n; i++) {
+    nullData[i] = static_cast<uint8_t>(notNull[i] == 0);
+  }
+  out.Set("dictionary", dictionary);
+  out.Set("indices",
+          Int32Array::New(env, n, ExternalArrayBuffer(env, move(ints)), 0));
+  out.Set("nulls", nulls);
+  return out;
+}
+vector<napi_value>
+ColumnBuffer::Entries(Napi::Env env) const
+{
+  vector<napi_value> strings;
+  strings.reserve(entries.Size());
+  for (uint32_t id = 0; id < entries.Size(); id++) {
+    strings.emplace_back(
+      String::New(env, entries.Data(id), entries.Length(id)));
+  }
+  return strings;
+}
+Napi::Value
+ColumnBuffer::Get(Napi::Env env,
+                  uint64_t row,
+                  const vector<napi_value>& strings) const
+{
+  if (!dictionaryEncoded || !notNull[row]) {
+    return Get(env, row);
+  }
+  return Napi::Value(env, strings[ints[row]]);
+}
+Napi::Value
+ColumnBuffer::Get(Napi::Env env, uint64_t row) const
+{
+  if (!notNull[row]) {
+    return env.Null();
+  }
+  switch (kind) {
+    case TypeKind::BOOLEAN:
+      return Boolean::New(env, ints[row] != 0);
+    case TypeKind::BYTE:
+    case TypeKind::SHORT:
+    case TypeKind::INT:
+      return Number::New(env, ints[row]);
+    case TypeKind::LONG:
+      return Number::New(env, static_cast<double>(longs[row]));
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+    case TypeKind::DECIMAL:
+      return Number::New(env, doubles[row]);
+    case TypeKind::DATE:
+      return String::New(env, FormatDate(ints[row]));
+    case TypeKind::TIMESTAMP:
+      return String::New(env, FormatTimestamp(longs[row], ints[row]));
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR: {
+      auto value = View(row);
+      return String::New(env, value.data(), value.size());
+    }
+    case TypeKind::BINARY:
+      return Buffer<char>::Copy(
+        env, chars.data() + offsets[row], offsets[row + 1] - offsets[row]);
+    default:
+      return env.Undefined();
+  }
+}
+
+RowBuffer::RowBuffer(const orc::Type& selected, const vector<string>& hidden)
+{
+  columns.reserve(selected.getSubtypeCount());
+  for (uint64_t i = 0; i < selected.getSubtypeCount(); i++) {
+    const string& title = selected.getFieldName(i);
+    if (std::find(hidden.begin(), hidden.end(), title) != hidden.end()) {
+      continue;
+    }
+    columns.emplace_back(title, selected.getSubtype(i));
+    fields.emplace_back(i);
+  }
+}
+void
+RowBuffer::Reserve(uint64_t rows)
+{
+  for (auto& column : columns) {
+    column.Reserve(rows);
+  }
+}
+void
+RowBuffer::Append(const orc::ColumnVectorBatch& batch)
+{
+  auto& values = dynamic_cast<const StructVectorBatch&>(batch).fields;
+  for (size_t i = 0; i < columns.size(); i++) {
+    columns[i].Append(*values[fields[i]]);
+  }
+}
+void
+RowBuffer::Append(const orc::ColumnVectorBatch& batch,
+                  const Selection* selection)
+{
+  if (selection == nullptr) {
+    Append(batch);
+    return;
+  }
+  auto& values = dynamic_cast<const StructVectorBatch&>(batch).fields;
+  for (size_t i = 0; i < columns.size(); i++) {
+    columns[i].Append(*values[fields[i]], selection->rows);
+  }
+}
+void
+RowBuffer::Concat(const RowBuffer& other)
+{
+  for (size_t i = 0; i < columns.size(); i++) {
+    columns[i].Concat(other.columns[i]);
+  }
+}
+void
+RowBuffer::AppendFrom(const RowBuffer& other, uint64_t row)
+{
+  for (size_t i = 0; i < columns.size(); i++) {
+    columns[i].AppendFrom(other.columns[i], row);
+  }
+}
+void
+RowBuffer::Clear()
+{
+  for (auto& column : columns) {
+    column.Clear();
+  }
+}
+vector<napi_value>
+RowBuffer::Keys(Napi::Env env) const
+{
+  vector<napi_value> keys;
+  keys.reserve(columns.size());
+  for (auto& column : columns) {
+    keys.emplace_back(String::New(env, column.title));
+  }
+  return keys;
+}
+vector<vector<napi_value>>
+RowBuffer::Entries(Napi::Env env) const
+{
+  vector<vector<napi_value>> entries(columns.size());
+  for (size_t i = 0; i < columns.size(); i++) {
+    if (columns[i].dictionaryEncoded) {
+      entries[i] = columns[i].Entries(env);
+    }
+  }
+  return entries;
+}
+Napi::Object
+RowBuffer::Row(Napi::Env env,
+               uint64_t row,
+               const vector<napi_value>& keys) const
+{
+  auto out = Object::New(env);
+  for (size_t i = 0; i < columns.size(); i++) {
+    out.Set(keys[i], columns[i].Get(env, row));
+  }
+  return out;
+}
+Napi::Object
+RowBuffer::Row(Napi::Env env,
+               uint64_t row,
+               const vector<napi_value>& keys,
+               const vector<vector<napi_value>>& entries) const
+{
+  auto out = Object::New(env);
+  for (size_t i = 0; i < columns.size(); i++) {
+    out.Set(keys[i], columns[i].Get(env, row, entries[i]));
+  }
+  return out;
+}
+Napi::Array
+RowBuffer::ToArray(Napi::Env env) const
+{
+  auto keys = Keys(env);
+  auto entries = Entries(env);
+  auto out = Array::New(env, Size());
+  for (uint32_t i = 0; i < Size(); i++) {
+    out.Set(i, Row(env, i, keys, entries));
+  }
+  return out;
+}
+}
@@ -0,0 +1,192 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NORC_COLUMNBUFFER_H
+#define NORC_COLUMNBUFFER_H
+
+#include "HashTable.h"
+#include <memory>
+#include <napi.h>
+#include <orc/OrcFile.hh>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace norc {
+
+struct Selection;
+
+/**
+ * Native storage for the decoded values of a single top level column.
+ * Batches are appended on the worker thread, JS values are only created once
+ * the column is handed back to the main thread.
+ *
+ * Storage by kind:
+ *  - BOOLEAN, BYTE, SHORT, INT, DATE (days since epoch): ints
+ *  - LONG: longs
+ *  - FLOAT, DOUBLE, DECIMAL: doubles
+ *  - TIMESTAMP: longs (seconds) and ints (nanoseconds)
+ *  - STRING, VARCHAR, CHAR, BINARY: chars, offsets (offsets[i] to offsets[i+1])
+ *
+ * A STRING, VARCHAR or CHAR column whose first batch is dictionary encoded
+ * (an EncodedStringVectorBatch of a scan with lazy decoding) is buffered as
+ * dictionary codes instead: every distinct value is interned in entries once
+ * and rows store the id of their value in ints. Each distinct value is then
+ * created as a JS string once, whatever the number of rows holding it.
+ */
+class ColumnBuffer
+{
+public:
+  ColumnBuffer(string title, const orc::Type* type);
+  void Reserve(uint64_t rows);
+  void Append(const orc::ColumnVectorBatch&);
+  /**
+   * Append the given rows of a batch only, in the order they are listed.
+   */
+  void Append(const orc::ColumnVectorBatch&, const vector<uint32_t>& rows);
+  /**
+   * Append the rows of another buffer of the same column.
+   */
+  void Concat(const ColumnBuffer&);
+  /**
+   * Append a single row of another buffer of the same column.
+   */
+  void AppendFrom(const ColumnBuffer&, uint64_t row);
+  /**
+   * Append a null value, for the missing side of an outer join.
+   */
+  void AppendNull();
+  void Clear();
+  /**
+   * Move the column into a JS object of the form {values, nulls}. Numeric
+   * values are exposed as typed arrays backed by the native buffers, nulls is
+   * a Uint8Array where 1 marks a null value.
+   */
+  Napi::Object ToTypedArray(Napi::Env);
+  /**
+   * Move a string column into a JS object of the form
+   * {dictionary, indices, nulls}, the distinct values as an array of strings
+   * and the position of the value of every row in it as an Int32Array.
+   */
+  Napi::Object ToDictionary(Napi::Env);
+  /**
+   * One JS string per entry of a dictionary encoded column, indexed by code.
+   */
+  vector<napi_value> Entries(Napi::Env) const;
+  /**
+   * The JS value for a single row, dates and timestamps are formatted as
+   * strings, nulls are returned as null.
+   */
+  Napi::Value Get(Napi::Env, uint64_t row) const;
+  /**
+   * Same as Get, the string of a dictionary encoded row is taken from the
+   * entries created by Entries.
+   */
+  Napi::Value Get(Napi::Env,
+                  uint64_t row,
+                  const vector<napi_value>& entries) const;
+  /**
+   * The bytes of a row of a string or binary column, in either storage.
+   */
+  std::string_view View(uint64_t row) const;
+  uint64_t Size() const { return notNull.size(); }
+
+  string title;
+  orc::TypeKind kind;
+  vector<char> notNull;
+  vector<int32_t> ints;
+  vector<int64_t> longs;
+  vector<double> doubles;
+  vector<char> chars;
+  vector<uint64_t> offsets;
+  // rows are codes into entries, see above
+  bool dictionaryEncoded = false;
+  StringPool entries;
+
+private:
+  /**
+   * Id in entries of a value of an orc dictionary, interned the first time
+   * the value is seen. Ids are cached until the batch has a new dictionary,
+   * orc creates one per stripe.
+   */
+  uint32_t Intern(const orc::EncodedStringVectorBatch&, int64_t index);
+  /**
+   * Switch a column of plain strings to dictionary codes.
+   */
+  void Encode();
+
+  /**
+   * Append n rows, row(i) is the row of the batch the i-th appended row is
+   * copied from.
+   */
+  template<typename Index>
+  void AppendRows(const orc::ColumnVectorBatch&, uint64_t n, Index row);
+
+  std::shared_ptr<orc::StringDictionary> dictionary;
+  vector<uint32_t> ids;
+};
+
+/**
+ * Decoded rows of a struct batch, one ColumnBuffer per field of the selected
+ * type. Rows are materialized as JS objects without an intermediate string
+ * representation.
+ */
+class RowBuffer
+{
+public:
+  /**
+   * Buffer the fields of the selected type, except the hidden ones.
+   */
+  explicit RowBuffer(const orc::Type& selected,
+                     const vector<string>& hidden = {});
+  void Reserve(uint64_t rows);
+  void Append(const orc::ColumnVectorBatch&);
+  /**
+   * Append the selected rows of a batch, all of them when selection is null.
+   */
+  void Append(const orc::ColumnVectorBatch&, const Selection* selection);
+  void Concat(const RowBuffer&);
+  void AppendFrom(const RowBuffer&, uint64_t row);
+  void Clear();
+  uint64_t Size() const { return columns.empty() ? 0 : columns[0].Size(); }
+  /**
+   * Create the property keys once, to be reused for every row object.
+   */
+  vector<napi_value> Keys(Napi::Env) const;
+  /**
+   * The entries of every dictionary encoded column, created once to be
+   * reused for every row object. Other columns have no entries.
+   */
+  vector<vector<napi_value>> Entries(Napi::Env) const;
+  Napi::Object Row(Napi::Env, uint64_t row, const vector<napi_value>& keys) const;
+  Napi::Object Row(Napi::Env,
+                   uint64_t row,
+                   const vector<napi_value>& keys,
+                   const vector<vector<napi_value>>& entries) const;
+  Napi::Array ToArray(Napi::Env) const;
+
+  vector<ColumnBuffer> columns;
+  // position of every column in the selected struct
+  vector<size_t> fields;
+};
+}
+
+#endif // NORC_COLUMNBUFFER_H
@@ -0,0 +1,185 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Cursor.h"
+#include "StripeScan.h"
+#include "ValidateArguments.h"
+
+using namespace Napi;
+using namespace orc;
+
+using std::make_unique;
+
+namespace norc {
+FunctionReference Cursor::constructor; // NOLINT
+void
+Cursor::Initialize(Napi::Env& env, Napi::Object& target)
+{
+  HandleScope scope(env);
+  auto ctor = DefineClass(env,
+                          "Cursor",
+                          { InstanceMethod("next", &Cursor::Next),
+                            InstanceMethod("close", &Cursor::Close) });
+  constructor = Persistent(ctor);
+  constructor.SuppressDestruct();
+  target.Set("Cursor", ctor);
+}
+Cursor::Cursor(const CallbackInfo& info)
+  : ObjectWrap(info)
+{
+  if (info.Length() < 1 || !info[0].IsObject() ||
+      !info[0].As<Object>().InstanceOf(Reader::constructor.Value())) {
+    TypeError::New(info.Env(), "A Reader is required")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  source = Persistent(info[0].As<Object>());
+  reader = Reader::Unwrap(info[0].As<Object>());
+}
+
+class CursorWorker : public AsyncWorker
+{
+public:
+  CursorWorker(Function& cb, Cursor* cursor)
+    : AsyncWorker(cb, "cursor_worker", cursor->Value())
+    , cursor(cursor)
+  {}
+
+protected:
+  void Execute() override
+  {
+    if (cursor->done) {
+      return;
+    }
+    try {
+      if (!cursor->rowReader) {
+        cursor->rowReader =
+          cursor->reader->ScanFile(cursor->scan).createRowReader(
+            cursor->scan.ToRowReaderOptions());
+        cursor->batch =
+          cursor->rowReader->createRowBatch(cursor->scan.BatchSize());
+        cursor->rows = make_unique<RowBuffer>(
+          cursor->rowReader->getSelectedType(), cursor->scan.hidden);
+        if (cursor->scan.where) {
+          // the offset counts matching rows, they are skipped as decoded
+          cursor->filter = make_unique<Filter>(
+            *cursor->scan.where, cursor->rowReader->getSelectedType());
+          cursor->skip = cursor->scan.offset;
+        } else if (cursor->scan.offset > 0) {
+          cursor->rowReader->seekToRow(cursor->scan.offset);
+        }
+        cursor->remaining = cursor->scan.limit;
+      }
+      cursor->rows->Clear();
+      while (cursor->rows->Size() == 0 && !cursor->done) {
+        if (cursor->remaining == 0 ||
+            !cursor->rowReader->next(*cursor->batch)) {
+          cursor->done = true;
+        } else if (cursor->filter) {
+          Selection& selection = cursor->selection;
+          ResolveDictionaries(*cursor->batch);
+          cursor->filter->Select(*cursor->batch, selection);
+          const uint64_t skipped =
+            std::min<uint64_t>(cursor->skip, selection.rows.size());
+          selection.Slice(skipped, skipped + cursor->remaining);
+          cursor->skip -= skipped;
+          cursor->remaining -= selection.rows.size();
+          cursor->rows->Append(*cursor->batch, &selection);
+        } else {
+          if (cursor->batch->numElements > cursor->remaining) {
+            TruncateBatch(*cursor->batch, cursor->remaining);
+          }
+          cursor->remaining -= cursor->batch->numElements;
+          cursor->rows->Append(*cursor->batch);
+        }
+      }
+    } catch (std::exception& ex) {
+      SetError(ex.what());
+    }
+  }
+  void OnOK() override
+  {
+    cursor->busy = false;
+    Napi::Value out = Env().Null();
+    if (!cursor->done) {
+      out = cursor->rows->ToArray(Env());
+    }
+    if (cursor->closed || cursor->done) {
+      cursor->Release();
+    }
+    Callback().Call({ Env().Null(), out });
+  }
+  void OnError(const Error& e) override
+  {
+    cursor->busy = false;
+    cursor->Release();
+    Callback().Call({ e.Value() });
+  }
+
+private:
+  Cursor* cursor;
+};
+
+void
+Cursor::Next(const CallbackInfo& info)
+{
+  AssertCallbackInfo(info, { { 0, { option(napi_function) } } });
+  if (info.Env().IsExceptionPending()) {
+    return;
+  }
+  if (busy) {
+    Error::New(info.Env(), "A batch is already being read")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  auto cb = info[0].As<Function>();
+  busy = true;
+  auto worker = new CursorWorker(cb, this);
+  worker->Queue();
+}
+void
+Cursor::Close(const CallbackInfo&)
+{
+  closed = true;
+  if (!busy) {
+    Release();
+  }
+}
+void
+Cursor::Release()
+{
+  done = true;
+  filter.reset();
+  rows.reset();
+  batch.reset();
+  rowReader.reset();
+}
+Napi::Value
+Reader::CreateCursor(const CallbackInfo& info)
+{
+  ScanOptions scan;
+  if (info.Length() > 0 && info[0].IsObject() &&
+      !ParseScanOptions(info.Env(), info[0].As<Object>(), scan)) {
+    return {};
+  }
+  scan.lazyStrings = true;
+  auto cursor = Cursor::constructor.New({ info.This() });
+  Cursor::Unwrap(cursor)->scan = std::move(scan);
+  return cursor;
+}
+}
@@ -0,0 +1,67 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NORC_CURSOR_H
+#define NORC_CURSOR_H
+
+#include "ColumnBuffer.h"
+#include "Filter.h"
+#include "Reader.h"
+#include <napi.h>
+#include <orc/OrcFile.hh>
+
+using Napi::CallbackInfo;
+using std::unique_ptr;
+
+namespace norc {
+
+/**
+ * Pull based scan over a Reader. The orc::RowReader and its batch live as
+ * long as the cursor, each call to next decodes exactly one batch on the
+ * libuv thread pool.
+ */
+class Cursor : public Napi::ObjectWrap<Cursor>
+{
+public:
+  static Napi::FunctionReference constructor;
+  static void Initialize(Napi::Env&, Napi::Object&);
+  explicit Cursor(const CallbackInfo&);
+  void Next(const CallbackInfo&);
+  void Close(const CallbackInfo&);
+  void Release();
+
+  // keeps the Reader, and the orc::Reader the row reader depends on, alive
+  Napi::ObjectReference source;
+  Reader* reader;
+  ScanOptions scan;
+  unique_ptr<orc::RowReader> rowReader;
+  unique_ptr<orc::ColumnVectorBatch> batch;
+  unique_ptr<RowBuffer> rows;
+  // rows left before scan.limit is reached
+  uint64_t remaining = 0;
+  // matching rows left to skip before scan.offset is reached, with a where
+  uint64_t skip = 0;
+  unique_ptr<Filter> filter;
+  Selection selection;
+  bool busy = false;
+  bool closed = false;
+  bool done = false;
+};
+}
+
+#endif // NORC_CURSOR_H
@@ -0,0 +1,496 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Filter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+using namespace orc;
+
+using std::runtime_error;
+using std::unordered_map;
+
+namespace norc {
+
+/**
+ * Order of a minimum or maximum of the statistics relative to a literal, in
+ * the encoding of Filter::Order.
+ */
+static int
+CompareBound(const ColumnSummary& stats,
+             bool maximum,
+             const Predicate& leaf,
+             const PredicateLiteral& literal)
+{
+  switch (leaf.kind) {
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+    case TypeKind::DECIMAL: {
+      const double value = maximum ? stats.maxReal : stats.minReal;
+      const double other = leaf.Real(literal);
+      if (std::isnan(value) || std::isnan(other)) {
+        return 2;
+      }
+      return (value > other) - (value < other);
+    }
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR: {
+      const int order =
+        (maximum ? stats.maxText : stats.minText).compare(literal.text);
+      return (order > 0) - (order < 0);
+    }
+    case TypeKind::TIMESTAMP: {
+      // statistics are milliseconds and the nanoseconds below them
+      const __int128 value =
+        static_cast<__int128>(maximum ? stats.maxInteger : stats.minInteger) *
+          1000000 +
+        (maximum ? stats.maxNanos : stats.minNanos);
+      const __int128 other =
+        static_cast<__int128>(literal.integer) * 1000000000 + literal.nanos;
+      return (value > other) - (value < other);
+    }
+    default: {
+      const int64_t value = maximum ? stats.maxInteger : stats.minInteger;
+      return (value > literal.integer) - (value < literal.integer);
+    }
+  }
+}
+static Truth
+CompareRange(Predicate::Op op, int low, int high, bool noNulls)
+{
+  if (low == 2 || high == 2) {
+    return Truth::Maybe;
+  }
+  bool never = false;
+  bool always = false;
+  switch (op) {
+    case Predicate::EQ:
+      never = low > 0 || high < 0;
+      always = low == 0 && high == 0;
+      break;
+    case Predicate::NE:
+      never = low == 0 && high == 0;
+      always = low > 0 || high < 0;
+      break;
+    case Predicate::LT:
+      never = low >= 0;
+      always = high < 0;
+      break;
+    case Predicate::LTE:
+      never = low > 0;
+      always = high <= 0;
+      break;
+    case Predicate::GT:
+      never = high <= 0;
+      always = low > 0;
+      break;
+    case Predicate::GTE:
+      never = high < 0;
+      always = low >= 0;
+      break;
+    default:
+      break;
+  }
+  if (never) {
+    return Truth::No;
+  }
+  // a null value is never selected by a comparison
+  return always && noNulls ? Truth::Yes : Truth::Maybe;
+}
+static Truth
+And(Truth a, Truth b)
+{
+  return std::min(a, b);
+}
+static Truth
+Or(Truth a, Truth b)
+{
+  return std::max(a, b);
+}
+Truth
+EvaluateStatistics(const Predicate& p,
+                   const unordered_map<uint64_t, ColumnSummary>& stats)
+{
+  switch (p.op) {
+    case Predicate::AND: {
+      Truth out = Truth::Yes;
+      for (auto& child : p.children) {
+        out = And(out, EvaluateStatistics(child, stats));
+      }
+      return out;
+    }
+    case Predicate::OR: {
+      Truth out = Truth::No;
+      for (auto& child : p.children) {
+        out = Or(out, EvaluateStatistics(child, stats));
+      }
+      return out;
+    }
+    case Predicate::NOT:
+      // rows the operand is false for may still be unknown (null), those are
+      // not selected either, so only Yes can be negated
+      return EvaluateStatistics(p.children[0], stats) == Truth::Yes
+               ? Truth::No
+               : Truth::Maybe;
+    default:
+      break;
+  }
+  auto found = stats.find(p.field);
+  if (found == stats.end()) {
+    return Truth::Maybe;
+  }
+  const ColumnSummary& column = found->second;
+  if (p.op == Predicate::IS_NULL) {
+    if (!column.hasNull) {
+      return Truth::No;
+    }
+    return column.count == 0 ? Truth::Yes : Truth::Maybe;
+  }
+  if (column.count == 0) {
+    // only nulls
+    return Truth::No;
+  }
+  if (!column.hasMinMax) {
+    return Truth::Maybe;
+  }
+  auto compare = [&](Predicate::Op op, const PredicateLiteral& literal) {
+    return CompareRange(op,
+                        CompareBound(column, false, p, literal),
+                        CompareBound(column, true, p, literal),
+                        !column.hasNull);
+  };
+  switch (p.op) {
+    case Predicate::IN: {
+      Truth out = Truth::No;
+      for (auto& literal : p.literals) {
+        out = Or(out, compare(Predicate::EQ, literal));
+      }
+      return out;
+    }
+    case Predicate::BETWEEN:
+      return And(compare(Predicate::GTE, p.literals[0]),
+                 compare(Predicate::LTE, p.literals[1]));
+    default:
+      return compare(p.op, p.literals[0]);
+  }
+}
+
+Filter::Filter(const Predicate& predicate, const orc::Type& selected)
+  : root(Bind(predicate, selected))
+{}
+Filter::Node
+Filter::Bind(const Predicate& predicate, const orc::Type& selected)
+{
+  Node node;
+  node.predicate = &predicate;
+  if (predicate.IsLeaf()) {
+    node.position = selected.getSubtypeCount();
+    for (uint64_t i = 0; i < selected.getSubtypeCount(); i++) {
+      if (selected.getFieldName(i) == predicate.column) {
+        node.position = i;
+      }
+    }
+    if (node.position == selected.getSubtypeCount()) {
+      throw runtime_error("column " + predicate.column +
+                          " of where is not selected");
+    }
+  }
+  for (auto& child : predicate.children) {
+    node.children.emplace_back(Bind(child, selected));
+  }
+  return node;
+}
+uint64_t
+Filter::Evaluate(const orc::ColumnVectorBatch& batch, vector<char>& selected)
+{
+  const uint64_t rows = batch.numElements;
+  Evaluate(root, dynamic_cast<const StructVectorBatch&>(batch), rows);
+  selected.assign(root.yes.begin(), root.yes.begin() + rows);
+  uint64_t count = 0;
+  for (uint64_t i = 0; i < rows; i++) {
+    count += static_cast<uint64_t>(selected[i]);
+  }
+  return count;
+}
+void
+Filter::Select(const orc::ColumnVectorBatch& batch, Selection& selection)
+{
+  const uint64_t rows = batch.numElements;
+  Evaluate(batch, selection.mask);
+  // branch free compaction, every index is written and only selected ones
+  // advance the end of the selection vector
+  selection.rows.resize(rows);
+  uint32_t* out = selection.rows.data();
+  const char* mask = selection.mask.data();
+  uint64_t size = 0;
+  for (uint64_t i = 0; i < rows; i++) {
+    out[size] = static_cast<uint32_t>(i);
+    size += static_cast<uint64_t>(mask[i]);
+  }
+  selection.rows.resize(size);
+}
+void
+Selection::Slice(uint64_t first, uint64_t last)
+{
+  last = std::min<uint64_t>(last, rows.size());
+  first = std::min(first, last);
+  for (uint64_t i = 0; i < first; i++) {
+    mask[rows[i]] = 0;
+  }
+  for (uint64_t i = last; i < rows.size(); i++) {
+    mask[rows[i]] = 0;
+  }
+  rows.erase(rows.begin() + static_cast<int64_t>(last), rows.end());
+  rows.erase(rows.begin(), rows.begin() + static_cast<int64_t>(first));
+}
+void
+Filter::Evaluate(Node& node, const orc::StructVectorBatch& batch, uint64_t rows)
+{
+  node.yes.resize(rows);
+  node.no.resize(rows);
+  char* yes = node.yes.data();
+  char* no = node.no.data();
+  switch (node.predicate->op) {
+    case Predicate::AND:
+      // true when every operand is, false when one of them is
+      std::memset(yes, 1, rows);
+      std::memset(no, 0, rows);
+      for (auto& child : node.children) {
+        Evaluate(child, batch, rows);
+        const char* childYes = child.yes.data();
+        const char* childNo = child.no.data();
+        for (uint64_t i = 0; i < rows; i++) {
+          yes[i] &= childYes[i];
+          no[i] |= childNo[i];
+        }
+      }
+      break;
+    case Predicate::OR:
+      std::memset(yes, 0, rows);
+      std::memset(no, 1, rows);
+      for (auto& child : node.children) {
+        Evaluate(child, batch, rows);
+        const char* childYes = child.yes.data();
+        const char* childNo = child.no.data();
+        for (uint64_t i = 0; i < rows; i++) {
+          yes[i] |= childYes[i];
+          no[i] &= childNo[i];
+        }
+      }
+      break;
+    case Predicate::NOT: {
+      Node& child = node.children[0];
+      Evaluate(child, batch, rows);
+      std::memcpy(yes, child.no.data(), rows);
+      std::memcpy(no, child.yes.data(), rows);
+      break;
+    }
+    default:
+      EvaluateLeaf(node, batch, rows);
+      break;
+  }
+}
+void
+Filter::EvaluateLeaf(Node& node,
+                     const orc::StructVectorBatch& batch,
+                     uint64_t rows)
+{
+  const Predicate& leaf = *node.predicate;
+  const ColumnVectorBatch& column = *batch.fields[node.position];
+  const char* present = column.hasNulls ? column.notNull.data() : nullptr;
+  char* yes = node.yes.data();
+  char* no = node.no.data();
+  if (leaf.op == Predicate::IS_NULL) {
+    for (uint64_t i = 0; i < rows; i++) {
+      const char valid = present != nullptr ? present[i] : 1;
+      yes[i] = static_cast<char>(valid ^ 1);
+      no[i] = valid;
+    }
+    return;
+  }
+  if (leaf.kind == TypeKind::DECIMAL) {
+    // decimals are compared as doubles, the representation they are read as
+    reals.resize(rows);
+    if (auto d64 = dynamic_cast<const Decimal64VectorBatch*>(&column)) {
+      const double divisor = std::pow(10.0, d64->scale);
+      const int64_t* values = d64->values.data();
+      for (uint64_t i = 0; i < rows; i++) {
+        reals[i] = static_cast<double>(values[i]) / divisor;
+      }
+    } else {
+      auto& d128 = dynamic_cast<const Decimal128VectorBatch&>(column);
+      for (uint64_t i = 0; i < rows; i++) {
+        const bool valid = present == nullptr || present[i];
+        reals[i] =
+          valid ? strtod(d128.values[i].toDecimalString(d128.scale).c_str(),
+                         nullptr)
+                : 0;
+      }
+    }
+  }
+  order.resize(rows);
+  match.resize(rows);
+  const int8_t* o = order.data();
+  char* m = match.data();
+  switch (leaf.op) {
+    case Predicate::IN:
+      std::memset(m, 0, rows);
+      for (auto& literal : leaf.literals) {
+        Order(leaf, column, literal, rows);
+        for (uint64_t i = 0; i < rows; i++) {
+          m[i] |= static_cast<char>(o[i] == 0);
+        }
+      }
+      break;
+    case Predicate::BETWEEN:
+      Order(leaf, column, leaf.literals[0], rows);
+      for (uint64_t i = 0; i < rows; i++) {
+        m[i] = static_cast<char>((o[i] == 0) | (o[i] == 1));
+      }
+      Order(leaf, column, leaf.literals[1], rows);
+      for (uint64_t i = 0; i < rows; i++) {
+        m[i] &= static_cast<char>((o[i] == -1) | (o[i] == 0));
+      }
+      break;
+    default:
+      Order(leaf, column, leaf.literals[0], rows);
+      switch (leaf.op) {
+        case Predicate::EQ:
+          for (uint64_t i = 0; i < rows; i++) {
+            m[i] = static_cast<char>(o[i] == 0);
+          }
+          break;
+        case Predicate::NE:
+          for (uint64_t i = 0; i < rows; i++) {
+            m[i] = static_cast<char>(o[i] != 0);
+          }
+          break;
+        case Predicate::LT:
+          for (uint64_t i = 0; i < rows; i++) {
+            m[i] = static_cast<char>(o[i] == -1);
+          }
+          break;
+        case Predicate::LTE:
+          for (uint64_t i = 0; i < rows; i++) {
+            m[i] = static_cast<char>((o[i] == -1) | (o[i] == 0));
+          }
+          break;
+        case Predicate::GT:
+          for (uint64_t i = 0; i < rows; i++) {
+            m[i] = static_cast<char>(o[i] == 1);
+          }
+          break;
+        default:
+          for (uint64_t i = 0; i < rows; i++) {
+            m[i] = static_cast<char>((o[i] == 1) | (o[i] == 0));
+          }
+          break;
+      }
+      break;
+  }
+  if (present == nullptr) {
+    for (uint64_t i = 0; i < rows; i++) {
+      yes[i] = m[i];
+      no[i] = static_cast<char>(m[i] ^ 1);
+    }
+  } else {
+    for (uint64_t i = 0; i < rows; i++) {
+      yes[i] = static_cast<char>(present[i] & m[i]);
+      no[i] = static_cast<char>(present[i] & (m[i] ^ 1));
+    }
+  }
+}
+void
+Filter::Order(const Predicate& leaf,
+              const orc::ColumnVectorBatch& column,
+              const PredicateLiteral& literal,
+              uint64_t rows)
+{
+  int8_t* out = order.data();
+  switch (leaf.kind) {
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+    case TypeKind::DECIMAL: {
+      const double* values =
+        leaf.kind == TypeKind::DECIMAL
+          ? reals.data()
+          : dynamic_cast<const DoubleVectorBatch&>(column).data.data();
+      const double other = leaf.Real(literal);
+      if (std::isnan(other)) {
+        std::memset(out, 2, rows);
+        break;
+      }
+      for (uint64_t i = 0; i < rows; i++) {
+        const double value = values[i];
+        // NaN compares neither less nor greater, it is set apart as 2
+        out[i] = static_cast<int8_t>((value > other) - (value < other) +
+                                     2 * (value != value));
+      }
+      break;
+    }
+    case TypeKind::TIMESTAMP: {
+      auto& timestamps = dynamic_cast<const TimestampVectorBatch&>(column);
+      const int64_t* seconds = timestamps.data.data();
+      const int64_t* nanos = timestamps.nanoseconds.data();
+      for (uint64_t i = 0; i < rows; i++) {
+        const int s = (seconds[i] > literal.integer) -
+                      (seconds[i] < literal.integer);
+        const int n = (nanos[i] > literal.nanos) - (nanos[i] < literal.nanos);
+        out[i] = static_cast<int8_t>(s + (s == 0) * n);
+      }
+      break;
+    }
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR: {
+      auto& strings = dynamic_cast<const StringVectorBatch&>(column);
+      const char* present = column.hasNulls ? column.notNull.data() : nullptr;
+      const size_t size = literal.text.size();
+      for (uint64_t i = 0; i < rows; i++) {
+        if (present != nullptr && !present[i]) {
+          out[i] = 0;
+          continue;
+        }
+        const size_t length = static_cast<size_t>(strings.length[i]);
+        const size_t common = std::min(length, size);
+        int o = common == 0
+                  ? 0
+                  : std::memcmp(strings.data[i], literal.text.data(), common);
+        if (o == 0) {
+          o = (length > size) - (length < size);
+        }
+        out[i] = static_cast<int8_t>((o > 0) - (o < 0));
+      }
+      break;
+    }
+    default: {
+      const int64_t* values =
+        dynamic_cast<const LongVectorBatch&>(column).data.data();
+      const int64_t other = literal.integer;
+      for (uint64_t i = 0; i < rows; i++) {
+        out[i] = static_cast<int8_t>((values[i] > other) - (values[i] < other));
+      }
+      break;
+    }
+  }
+}
+}
@@ -0,0 +1,125 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NORC_FILTER_H
+#define NORC_FILTER_H
+
+#include "Predicate.h"
+#include "Statistics.h"
+#include <orc/OrcFile.hh>
+#include <unordered_map>
+#include <vector>
+
+using std::vector;
+
+namespace norc {
+
+/**
+ * Whether a predicate holds for every row (Yes), no row (No) or possibly some
+ * rows (Maybe) of a stripe or row group.
+ */
+enum class Truth
+{
+  No,
+  Maybe,
+  Yes
+};
+
+/**
+ * Evaluate a predicate against the statistics of a stripe or row group, keyed
+ * by the field of the column. Columns without statistics are Maybe.
+ */
+Truth
+EvaluateStatistics(const Predicate&,
+                   const std::unordered_map<uint64_t, ColumnSummary>& stats);
+
+/**
+ * Rows of a batch that passed a filter, as a mask (1 for selected rows) and as
+ * a selection vector of the indices of the selected rows in increasing order.
+ */
+struct Selection
+{
+  vector<char> mask;
+  vector<uint32_t> rows;
+
+  /**
+   * Keep the selected rows from position first up to (not including) last of
+   * the selection vector, used to apply an offset and a limit.
+   */
+  void Slice(uint64_t first, uint64_t last);
+};
+
+/**
+ * Row by row evaluation of a predicate over decoded batches, the rows of the
+ * row groups the search argument could not skip.
+ *
+ * Comparisons follow SQL: a comparison with a null value is unknown, and
+ * unknown rows are never selected, not even under NOT. Each node of the
+ * predicate is evaluated a whole column at a time into a mask of the rows it
+ * is true for and a mask of the rows it is false for, the loops are branch
+ * free so the compiler can vectorize them.
+ */
+class Filter
+{
+public:
+  /**
+   * Bind the predicate to the fields of the selected type of a row reader,
+   * every column compared by the predicate must be selected.
+   */
+  Filter(const Predicate&, const orc::Type& selected);
+  /**
+   * Set selected[i] to 1 for the rows of the struct batch the predicate is
+   * true for, 0 for the others. Returns the number of selected rows.
+   */
+  uint64_t Evaluate(const orc::ColumnVectorBatch&, vector<char>& selected);
+  /**
+   * Evaluate into both the mask and the selection vector of a Selection.
+   */
+  void Select(const orc::ColumnVectorBatch&, Selection&);
+
+private:
+  struct Node
+  {
+    const Predicate* predicate;
+    // position of the compared column in the selected struct
+    size_t position = 0;
+    vector<Node> children;
+    vector<char> yes;
+    vector<char> no;
+  };
+  static Node Bind(const Predicate&, const orc::Type& selected);
+  void Evaluate(Node&, const orc::StructVectorBatch&, uint64_t rows);
+  void EvaluateLeaf(Node&, const orc::StructVectorBatch&, uint64_t rows);
+  /**
+   * Order of the values of a column relative to a literal into order: -1
+   * less, 0 equal, 1 greater, 2 unordered (NaN).
+   */
+  void Order(const Predicate&,
+             const orc::ColumnVectorBatch&,
+             const PredicateLiteral&,
+             uint64_t rows);
+
+  Node root;
+  // scratch space of the leaf being evaluated
+  vector<int8_t> order;
+  vector<char> match;
+  vector<double> reals;
+};
+}
+
+#endif // NORC_FILTER_H
@@ -0,0 +1,552 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Aggregate.h"
+#include "ColumnBuffer.h"
+#include "HashTable.h"
+#include "Internal.h"
+#include "StripeScan.h"
+#include "ValidateArguments.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+using namespace Napi;
+using namespace orc;
+
+using std::numeric_limits;
+
+namespace norc {
+
+/**
+ * Count, sum, minimum and maximum of one column for every group, one array
+ * per total indexed by group id. A batch is added one total at a time, each
+ * pass scatters the values of the rows into the slots of their groups.
+ */
+struct GroupColumn
+{
+  GroupColumn(string title, TypeKind kind, uint32_t ops)
+    : title(std::move(title))
+    , kind(kind)
+    , ops(ops)
+  {}
+  /**
+   * The ops that apply to a kind of column, sum and avg need numbers or
+   * booleans, min and max numbers, booleans or dates. Other kinds are counted
+   * only.
+   */
+  static uint32_t Supported(TypeKind kind)
+  {
+    switch (kind) {
+      case TypeKind::BOOLEAN:
+      case TypeKind::BYTE:
+      case TypeKind::SHORT:
+      case TypeKind::INT:
+      case TypeKind::LONG:
+      case TypeKind::FLOAT:
+      case TypeKind::DOUBLE:
+      case TypeKind::DECIMAL:
+        return ColumnAggregate::ALL;
+      case TypeKind::DATE:
+        return ColumnAggregate::COUNT | ColumnAggregate::MIN |
+               ColumnAggregate::MAX;
+      case TypeKind::TIMESTAMP:
+      case TypeKind::STRING:
+      case TypeKind::VARCHAR:
+      case TypeKind::CHAR:
+      case TypeKind::BINARY:
+        return ColumnAggregate::COUNT;
+      default:
+        return 0;
+    }
+  }
+  bool IsReal() const
+  {
+    return kind == TypeKind::FLOAT || kind == TypeKind::DOUBLE ||
+           kind == TypeKind::DECIMAL;
+  }
+  bool Needs(uint32_t op) const { return (ops & op) != 0; }
+  void Resize(size_t groups)
+  {
+    counts.resize(groups, 0);
+    if (Needs(ColumnAggregate::SUM | ColumnAggregate::AVG)) {
+      integerSums.resize(groups, 0);
+      realSums.resize(groups, 0);
+    }
+    if (Needs(ColumnAggregate::MIN)) {
+      integerMins.resize(groups, numeric_limits<int64_t>::max());
+      realMins.resize(groups, numeric_limits<double>::infinity());
+    }
+    if (Needs(ColumnAggregate::MAX)) {
+      integerMaxs.resize(groups, numeric_limits<int64_t>::min());
+      realMaxs.resize(groups, -numeric_limits<double>::infinity());
+    }
+  }
+  /**
+   * Add rows[i] of the batch to group groups[i], for i in [0, n).
+   */
+  void Add(const ColumnVectorBatch& batch,
+           const uint32_t* rows,
+           const uint32_t* groups,
+           uint64_t n)
+  {
+    const char* present = batch.hasNulls ? batch.notNull.data() : nullptr;
+    for (uint64_t i = 0; i < n; i++) {
+      counts[groups[i]] += !present || present[rows[i]];
+    }
+    if (!Needs(ColumnAggregate::SUM | ColumnAggregate::AVG |
+               ColumnAggregate::MIN | ColumnAggregate::MAX)) {
+      return;
+    }
+    if (IsReal()) {
+      AddReals(batch, present, rows, groups, n);
+      return;
+    }
+    const int64_t* data =
+      dynamic_cast<const LongVectorBatch&>(batch).data.data();
+    const bool sum = Needs(ColumnAggregate::SUM | ColumnAggregate::AVG);
+    const bool min = Needs(ColumnAggregate::MIN);
+    const bool max = Needs(ColumnAggregate::MAX);
+    for (uint64_t i = 0; i < n; i++) {
+      const uint64_t row = rows[i];
+      if (present && !present[row]) {
+        continue;
+      }
+      const uint32_t group = groups[i];
+      const int64_t value = data[row];
+      if (sum) {
+        integerSums[group] += value;
+      }
+      if (min && value < integerMins[group]) {
+        integerMins[group] = value;
+      }
+      if (max && value > integerMaxs[group]) {
+        integerMaxs[group] = value;
+      }
+    }
+  }
+  void Merge(const GroupColumn& other, uint32_t from, uint32_t to)
+  {
+    counts[to] += other.counts[from];
+    if (Needs(ColumnAggregate::SUM | ColumnAggregate::AVG)) {
+      integerSums[to] += other.integerSums[from];
+      realSums[to] += other.realSums[from];
+    }
+    if (Needs(ColumnAggregate::MIN)) {
+      integerMins[to] = std::min(integerMins[to], other.integerMins[from]);
+      realMins[to] = std::min(realMins[to], other.realMins[from]);
+    }
+    if (Needs(ColumnAggregate::MAX)) {
+      integerMaxs[to] = std::max(integerMaxs[to], other.integerMaxs[from]);
+      realMaxs[to] = std::max(realMaxs[to], other.realMaxs[from]);
+    }
+  }
+  /**
+   * {count, sum, min, max, avg} of a group limited to the ops, the same shape
+   * as the totals of Reader::Aggregate.
+   */
+  Napi::Object ToObject(Napi::Env env, uint32_t group) const
+  {
+    auto out = Object::New(env);
+    const uint64_t count = counts[group];
+    const bool empty = count == 0;
+    if (Needs(ColumnAggregate::COUNT)) {
+      out.Set("count", static_cast<double>(count));
+    }
+    const bool sum = Needs(ColumnAggregate::SUM | ColumnAggregate::AVG);
+    const double total =
+      !sum ? 0
+           : IsReal() ? realSums[group]
+                      : static_cast<double>(integerSums[group]);
+    if (Needs(ColumnAggregate::SUM)) {
+      out.Set("sum", empty ? env.Null() : Number::New(env, total));
+    }
+    if (Needs(ColumnAggregate::MIN)) {
+      out.Set("min",
+              empty ? env.Null()
+                    : Bound(env, integerMins[group], realMins[group]));
+    }
+    if (Needs(ColumnAggregate::MAX)) {
+      out.Set("max",
+              empty ? env.Null()
+                    : Bound(env, integerMaxs[group], realMaxs[group]));
+    }
+    if (Needs(ColumnAggregate::AVG)) {
+      out.Set("avg",
+              empty ? env.Null()
+                    : Number::New(env, total / static_cast<double>(count)));
+    }
+    return out;
+  }
+
+  string title;
+  TypeKind kind;
+  uint32_t ops;
+  vector<uint64_t> counts;
+  // sums of BOOLEAN and integer kinds, wide enough to never overflow
+  vector<__int128> integerSums;
+  vector<double> realSums;
+  vector<int64_t> integerMins;
+  vector<int64_t> integerMaxs;
+  vector<double> realMins;
+  vector<double> realMaxs;
+
+private:
+  Napi::Value Bound(Napi::Env env, int64_t integer, double real) const
+  {
+    switch (kind) {
+      case TypeKind::BOOLEAN:
+        return Boolean::New(env, integer != 0);
+      case TypeKind::DATE:
+        return String::New(env, FormatDate(integer));
+      case TypeKind::FLOAT:
+        return Number::New(env, RoundFloat(real));
+      default:
+        return Number::New(env,
+                           IsReal() ? real : static_cast<double>(integer));
+    }
+  }
+  void AddReals(const ColumnVectorBatch& batch,
+                const char* present,
+                const uint32_t* rows,
+                const uint32_t* groups,
+                uint64_t n)
+  {
+    // gather the values of the rows first, decimals converted to double
+    reals.resize(n);
+    if (kind != TypeKind::DECIMAL) {
+      const double* data =
+        dynamic_cast<const DoubleVectorBatch&>(batch).data.data();
+      for (uint64_t i = 0; i < n; i++) {
+        reals[i] = data[rows[i]];
+      }
+    } else if (auto d64 = dynamic_cast<const Decimal64VectorBatch*>(&batch)) {
+      const double divisor = std::pow(10.0, d64->scale);
+      for (uint64_t i = 0; i < n; i++) {
+        reals[i] = static_cast<double>(d64->values[rows[i]]) / divisor;
+      }
+    } else {
+      auto& d128 = dynamic_cast<const Decimal128VectorBatch&>(batch);
+      for (uint64_t i = 0; i < n; i++) {
+        reals[i] =
+          !present || present[rows[i]]
+            ? strtod(d128.values[rows[i]].toDecimalString(d128.scale).c_str(),
+                     nullptr)
+            : 0;
+      }
+    }
+    const bool sum = Needs(ColumnAggregate::SUM | ColumnAggregate::AVG);
+    const bool min = Needs(ColumnAggregate::MIN);
+    const bool max = Needs(ColumnAggregate::MAX);
+    for (uint64_t i = 0; i < n; i++) {
+      if (present && !present[rows[i]]) {
+        continue;
+      }
+      const uint32_t group = groups[i];
+      const double value = reals[i];
+      if (sum) {
+        realSums[group] += value;
+      }
+      if (min && value < realMins[group]) {
+        realMins[group] = value;
+      }
+      if (max && value > realMaxs[group]) {
+        realMaxs[group] = value;
+      }
+    }
+  }
+
+  // scratch space of AddReals
+  vector<double> reals;
+};
+
+/**
+ * The groups of the rows of one range of stripes: a table from the encoded
+ * key columns to dense group ids, and the totals of every group.
+ */
+struct GroupState
+{
+  GroupState(const vector<KeyEncoder::Column>& keyColumns,
+             const vector<GroupColumn>& totals)
+    : keys(keyColumns)
+    , table(keys.Width())
+    , columns(totals)
+  {}
+  /**
+   * Add the selected rows of a struct batch, all of them when selection is
+   * null. keyPositions and columnPositions are the positions of the key and
+   * aggregated columns in the batch.
+   */
+  void Add(const StructVectorBatch& batch,
+           const Selection* selection,
+           const vector<size_t>& keyPositions,
+           const vector<size_t>& columnPositions)
+  {
+    uint64_t n = batch.numElements;
+    const uint32_t* selected = nullptr;
+    if (selection != nullptr) {
+      n = selection->rows.size();
+      selected = selection->rows.data();
+    } else {
+      if (all.size() < n) {
+        const size_t start = all.size();
+        all.resize(n);
+        for (size_t i = start; i < n; i++) {
+          all[i] = static_cast<uint32_t>(i);
+        }
+      }
+      selected = all.data();
+    }
+    keys.Encode(batch, keyPositions, selected, n, encoded, hashes);
+    groups.resize(n);
+    const size_t width = keys.Width();
+    for (uint64_t i = 0; i < n; i++) {
+      groups[i] = table.FindOrInsert(encoded.data() + i * width, hashes[i]);
+    }
+    Resize();
+    for (uint64_t i = 0; i < n; i++) {
+      rows[groups[i]]++;
+    }
+    for (size_t c = 0; c < columns.size(); c++) {
+      columns[c].Add(
+        *batch.fields[columnPositions[c]], selected, groups.data(), n);
+    }
+  }
+  /**
+   * Add the groups of another state, string keys are interned again since
+   * every state has its own string pools.
+   */
+  void Merge(const GroupState& other)
+  {
+    vector<uint64_t> key(keys.Width());
+    for (uint32_t from = 0; from < other.table.Size(); from++) {
+      keys.Translate(other.keys, other.table.Key(from), key.data());
+      const uint32_t to = table.FindOrInsert(key.data(), keys.Hash(key.data()));
+      Resize();
+      rows[to] += other.rows[from];
+      for (size_t c = 0; c < columns.size(); c++) {
+        columns[c].Merge(other.columns[c], from, to);
+      }
+    }
+  }
+
+  KeyEncoder keys;
+  KeyTable table;
+  // rows of every group
+  vector<uint64_t> rows;
+  vector<GroupColumn> columns;
+
+private:
+  void Resize()
+  {
+    if (rows.size() < table.Size()) {
+      rows.resize(table.Size(), 0);
+      for (auto& column : columns) {
+        column.Resize(table.Size());
+      }
+    }
+  }
+
+  // scratch space of Add
+  vector<uint32_t> all;
+  vector<uint64_t> encoded;
+  vector<uint64_t> hashes;
+  vector<uint32_t> groups;
+};
+
+class GroupByWorker : public AsyncWorker
+{
+public:
+  GroupByWorker(Function& cb,
+                Napi::Value self,
+                vector<KeyEncoder::Column> keys,
+                vector<GroupColumn> columns,
+                ScanOptions scan)
+    : AsyncWorker(cb, "group_by_worker", self.As<Object>())
+    , reader(Reader::Unwrap(self.As<Object>()))
+    , keys(std::move(keys))
+    , columns(std::move(columns))
+    , scan(std::move(scan))
+  {}
+
+protected:
+  void Execute() override
+  {
+    try {
+      StripeScan scanner(reader->ScanFile(scan), scan);
+      const orc::Type& selected = scanner.SelectedType();
+      vector<size_t> keyPositions = Positions(selected, keys);
+      vector<size_t> columnPositions = Positions(selected, columns);
+      // every range groups its own rows, the partial groups are merged once
+      // all ranges are done
+      vector<unique_ptr<GroupState>> partials;
+      for (size_t i = 0; i < std::max<size_t>(scanner.Size(), 1); i++) {
+        partials.emplace_back(std::make_unique<GroupState>(keys, columns));
+      }
+      scanner.Run([&](size_t range,
+                      const ColumnVectorBatch& batch,
+                      const Selection* selection) {
+        partials[range]->Add(dynamic_cast<const StructVectorBatch&>(batch),
+                             selection,
+                             keyPositions,
+                             columnPositions);
+      });
+      for (size_t i = 1; i < partials.size(); i++) {
+        partials[0]->Merge(*partials[i]);
+        partials[i].reset();
+      }
+      state = std::move(partials[0]);
+    } catch (std::exception& ex) {
+      SetError(ex.what());
+    }
+  }
+  void OnOK() override
+  {
+    auto env = Env();
+    const uint32_t size = static_cast<uint32_t>(state->table.Size());
+    vector<ColumnBuffer> values = state->keys.Buffers();
+    for (uint32_t group = 0; group < size; group++) {
+      state->keys.Append(state->table.Key(group), values);
+    }
+    auto out = Array::New(env, size);
+    for (uint32_t group = 0; group < size; group++) {
+      auto row = Object::New(env);
+      auto groupKeys = Object::New(env);
+      for (auto& value : values) {
+        groupKeys.Set(value.title, value.Get(env, group));
+      }
+      row.Set("keys", groupKeys);
+      row.Set("rows", static_cast<double>(state->rows[group]));
+      auto totals = Object::New(env);
+      for (auto& column : state->columns) {
+        totals.Set(column.title, column.ToObject(env, group));
+      }
+      row.Set("columns", totals);
+      out.Set(group, row);
+    }
+    Callback().Call({ env.Null(), out });
+  }
+
+private:
+  template<typename Column>
+  static vector<size_t> Positions(const orc::Type& selected,
+                                  const vector<Column>& columns)
+  {
+    vector<size_t> positions;
+    for (auto& column : columns) {
+      for (uint64_t i = 0; i < selected.getSubtypeCount(); i++) {
+        if (selected.getFieldName(i) == column.title) {
+          positions.emplace_back(i);
+        }
+      }
+    }
+    return positions;
+  }
+
+  Reader* reader;
+  vector<KeyEncoder::Column> keys;
+  vector<GroupColumn> columns;
+  ScanOptions scan;
+  unique_ptr<GroupState> state;
+};
+
+void
+Reader::GroupBy(const CallbackInfo& info)
+{
+  AssertCallbackInfo(info,
+                     { { 0, { option(napi_object) } },
+                       { 1, { option(napi_function) } } });
+  if (info.Env().IsExceptionPending()) {
+    return;
+  }
+  auto env = info.Env();
+  auto options = info[0].As<Object>();
+  auto cb = info[1].As<Function>();
+  if (!options.Has("keys") || !options.Get("keys").IsArray()) {
+    TypeError::New(env, "keys must be an array of column titles")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  list<uint64_t> keyFields;
+  if (!ResolveColumns(env, options.Get("keys").As<Array>(), keyFields)) {
+    return;
+  }
+  if (keyFields.empty() || keyFields.size() > KeyEncoder::MAX_COLUMNS) {
+    RangeError::New(env, "groupBy needs between 1 and 64 key columns")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  vector<KeyEncoder::Column> keys;
+  for (auto field : keyFields) {
+    const orc::Type* type = reader->getType().getSubtype(field);
+    if (!KeyEncoder::Supported(type->getKind())) {
+      TypeError::New(env,
+                     "Cannot group by column " + fileMeta[field].title +
+                       " of type " + type->toString())
+        .ThrowAsJavaScriptException();
+      return;
+    }
+    keys.emplace_back(KeyEncoder::Column{ fileMeta[field].title, type });
+  }
+  vector<GroupColumn> columns;
+  ScanOptions scan;
+  scan.includes = keyFields;
+  if (options.Has("aggs")) {
+    auto aggs = options.Get("aggs").As<Object>();
+    auto titles = aggs.GetPropertyNames();
+    list<uint64_t> fields;
+    if (!ResolveColumns(env, titles, fields)) {
+      return;
+    }
+    auto field = fields.begin();
+    for (uint32_t i = 0; i < titles.Length(); i++, field++) {
+      auto& column = fileMeta[*field];
+      uint32_t ops = 0;
+      if (!ColumnAggregate::ParseOps(
+            env, aggs.Get(column.title).As<Array>(), ops)) {
+        return;
+      }
+      if ((ops & ~GroupColumn::Supported(column.type)) != 0) {
+        TypeError::New(env,
+                       "Aggregate not supported for column " + column.title +
+                         " of type " +
+                         reader->getType().getSubtype(*field)->toString())
+          .ThrowAsJavaScriptException();
+        return;
+      }
+      columns.emplace_back(column.title, column.type, ops);
+      if (std::find(scan.includes.begin(), scan.includes.end(), *field) ==
+          scan.includes.end()) {
+        scan.includes.emplace_back(*field);
+      }
+    }
+  }
+  if (!ParseScanOptions(env, options, scan)) {
+    return;
+  }
+  if (scan.offset > 0 || scan.limit != numeric_limits<uint64_t>::max()) {
+    RangeError::New(env, "groupBy does not support offset and limit")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  auto worker = new GroupByWorker(
+    cb, info.This(), std::move(keys), std::move(columns), std::move(scan));
+  worker->Queue();
+}
+}
@@ -0,0 +1,420 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "HashTable.h"
+#include "ColumnBuffer.h"
+#include "Internal.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+using namespace orc;
+
+namespace norc {
+
+uint64_t
+HashBytes(const char* data, size_t length)
+{
+  uint64_t hash = HashCombine(0, length);
+  size_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    uint64_t word;
+    memcpy(&word, data + i, 8);
+    hash = HashCombine(hash, word);
+  }
+  if (i < length) {
+    uint64_t word = 0;
+    memcpy(&word, data + i, length - i);
+    hash = HashCombine(hash, word);
+  }
+  return hash;
+}
+
+uint32_t
+StringPool::Intern(const char* data, size_t length, bool insert)
+{
+  const uint64_t hash = HashBytes(data, length);
+  if (slots.empty()) {
+    if (!insert) {
+      return MISSING;
+    }
+    slots.resize(64, 0);
+  }
+  const uint64_t mask = slots.size() - 1;
+  for (uint64_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    const uint32_t entry = slots[slot];
+    if (entry == 0) {
+      if (!insert) {
+        return MISSING;
+      }
+      const uint32_t id = static_cast<uint32_t>(hashes.size());
+      bytes.insert(bytes.end(), data, data + length);
+      offsets.emplace_back(bytes.size());
+      hashes.emplace_back(hash);
+      slots[slot] = id + 1;
+      if (hashes.size() * 2 > slots.size()) {
+        Grow();
+      }
+      return id;
+    }
+    const uint32_t id = entry - 1;
+    if (hashes[id] == hash && Length(id) == length &&
+        (length == 0 || memcmp(Data(id), data, length) == 0)) {
+      return id;
+    }
+  }
+}
+void
+StringPool::Grow()
+{
+  slots.assign(slots.size() * 2, 0);
+  const uint64_t mask = slots.size() - 1;
+  for (uint32_t id = 0; id < hashes.size(); id++) {
+    uint64_t slot = hashes[id] & mask;
+    while (slots[slot] != 0) {
+      slot = (slot + 1) & mask;
+    }
+    slots[slot] = id + 1;
+  }
+}
+
+KeyTable::KeyTable(size_t width)
+  : width(width)
+  , slots(1024, 0)
+{}
+bool
+KeyTable::Equals(uint32_t id, const uint64_t* key) const
+{
+  const uint64_t* stored = Key(id);
+  for (size_t i = 0; i < width; i++) {
+    if (stored[i] != key[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+uint32_t
+KeyTable::FindOrInsert(const uint64_t* key, uint64_t hash)
+{
+  const uint64_t mask = slots.size() - 1;
+  for (uint64_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    const uint32_t entry = slots[slot];
+    if (entry == 0) {
+      const uint32_t id = static_cast<uint32_t>(hashes.size());
+      keys.insert(keys.end(), key, key + width);
+      hashes.emplace_back(hash);
+      slots[slot] = id + 1;
+      if (hashes.size() * 2 > slots.size()) {
+        Grow();
+      }
+      return id;
+    }
+    if (hashes[entry - 1] == hash && Equals(entry - 1, key)) {
+      return entry - 1;
+    }
+  }
+}
+uint32_t
+KeyTable::Find(const uint64_t* key, uint64_t hash) const
+{
+  const uint64_t mask = slots.size() - 1;
+  for (uint64_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    const uint32_t entry = slots[slot];
+    if (entry == 0) {
+      return StringPool::MISSING;
+    }
+    if (hashes[entry - 1] == hash && Equals(entry - 1, key)) {
+      return entry - 1;
+    }
+  }
+}
+void
+KeyTable::Grow()
+{
+  slots.assign(slots.size() * 2, 0);
+  const uint64_t mask = slots.size() - 1;
+  for (uint32_t id = 0; id < hashes.size(); id++) {
+    uint64_t slot = hashes[id] & mask;
+    while (slots[slot] != 0) {
+      slot = (slot + 1) & mask;
+    }
+    slots[slot] = id + 1;
+  }
+}
+
+bool
+KeyEncoder::Supported(TypeKind kind)
+{
+  switch (kind) {
+    case TypeKind::BOOLEAN:
+    case TypeKind::BYTE:
+    case TypeKind::SHORT:
+    case TypeKind::INT:
+    case TypeKind::LONG:
+    case TypeKind::DATE:
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+    case TypeKind::DECIMAL:
+    case TypeKind::TIMESTAMP:
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR:
+    case TypeKind::BINARY:
+      return true;
+    default:
+      return false;
+  }
+}
+KeyEncoder::KeyEncoder(vector<Column> keyColumns)
+  : columns(std::move(keyColumns))
+  , pools(columns.size())
+{
+  for (const auto& column : columns) {
+    offsets.emplace_back(width);
+    width += column.type->getKind() == TypeKind::TIMESTAMP ||
+                 (column.type->getKind() == TypeKind::DECIMAL &&
+                  (column.type->getPrecision() == 0 ||
+                   column.type->getPrecision() > 18))
+               ? 2
+               : 1;
+  }
+}
+uint64_t
+DoubleKey(double value)
+{
+  if (value == 0) {
+    value = 0;
+  } else if (value != value) {
+    value = std::numeric_limits<double>::quiet_NaN();
+  }
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+void
+KeyEncoder::Encode(const StructVectorBatch& batch,
+                   const vector<size_t>& positions,
+                   const uint32_t* rows,
+                   uint64_t n,
+                   vector<uint64_t>& keys,
+                   vector<uint64_t>& hashes,
+                   bool insert)
+{
+  keys.assign(n * width, 0);
+  uint64_t* out = keys.data();
+  for (size_t c = 0; c < columns.size(); c++) {
+    const ColumnVectorBatch& field = *batch.fields[positions[c]];
+    const char* present = field.hasNulls ? field.notNull.data() : nullptr;
+    const size_t offset = offsets[c];
+    if (present) {
+      const uint64_t flag = uint64_t(1) << c;
+      for (uint64_t i = 0; i < n; i++) {
+        out[i * width] |= present[rows[i]] ? 0 : flag;
+      }
+    }
+    // null values keep their zero words, so they all compare equal
+    switch (columns[c].type->getKind()) {
+      case TypeKind::BOOLEAN:
+      case TypeKind::BYTE:
+      case TypeKind::SHORT:
+      case TypeKind::INT:
+      case TypeKind::LONG:
+      case TypeKind::DATE: {
+        const int64_t* data =
+          dynamic_cast<const LongVectorBatch&>(field).data.data();
+        for (uint64_t i = 0; i < n; i++) {
+          const uint64_t value = static_cast<uint64_t>(data[rows[i]]);
+          out[i * width + offset] = !present || present[rows[i]] ? value : 0;
+        }
+        break;
+      }
+      case TypeKind::FLOAT:
+      case TypeKind::DOUBLE: {
+        const double* data =
+          dynamic_cast<const DoubleVectorBatch&>(field).data.data();
+        for (uint64_t i = 0; i < n; i++) {
+          if (!present || present[rows[i]]) {
+            out[i * width + offset] = DoubleKey(data[rows[i]]);
+          }
+        }
+        break;
+      }
+      case TypeKind::DECIMAL: {
+        if (auto d64 = dynamic_cast<const Decimal64VectorBatch*>(&field)) {
+          // the scale is fixed for the column, the unscaled value is the key
+          for (uint64_t i = 0; i < n; i++) {
+            if (!present || present[rows[i]]) {
+              out[i * width + offset] =
+                static_cast<uint64_t>(d64->values[rows[i]]);
+            }
+          }
+        } else {
+          // the 128 bit unscaled value, high then low word, so values that
+          // differ past the precision of a double stay apart
+          auto& d128 = dynamic_cast<const Decimal128VectorBatch&>(field);
+          for (uint64_t i = 0; i < n; i++) {
+            if (!present || present[rows[i]]) {
+              const Int128& value = d128.values[rows[i]];
+              out[i * width + offset] =
+                static_cast<uint64_t>(value.getHighBits());
+              out[i * width + offset + 1] = value.getLowBits();
+            }
+          }
+        }
+        break;
+      }
+      case TypeKind::TIMESTAMP: {
+        auto& ts = dynamic_cast<const TimestampVectorBatch&>(field);
+        for (uint64_t i = 0; i < n; i++) {
+          if (!present || present[rows[i]]) {
+            out[i * width + offset] = static_cast<uint64_t>(ts.data[rows[i]]);
+            out[i * width + offset + 1] =
+              static_cast<uint64_t>(ts.nanoseconds[rows[i]]);
+          }
+        }
+        break;
+      }
+      case TypeKind::STRING:
+      case TypeKind::VARCHAR:
+      case TypeKind::CHAR:
+      case TypeKind::BINARY: {
+        auto& strings = dynamic_cast<const StringVectorBatch&>(field);
+        StringPool& pool = pools[c];
+        for (uint64_t i = 0; i < n; i++) {
+          const uint64_t r = rows[i];
+          if (!present || present[r]) {
+            out[i * width + offset] = pool.Intern(
+              strings.data[r], static_cast<size_t>(strings.length[r]), insert);
+          }
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  hashes.resize(n);
+  for (uint64_t i = 0; i < n; i++) {
+    hashes[i] = Hash(out + i * width);
+  }
+}
+uint64_t
+KeyEncoder::Hash(const uint64_t* key) const
+{
+  uint64_t hash = 0;
+  for (size_t i = 0; i < width; i++) {
+    hash = HashCombine(hash, key[i]);
+  }
+  return hash;
+}
+void
+KeyEncoder::Translate(const KeyEncoder& from,
+                      const uint64_t* key,
+                      uint64_t* out)
+{
+  std::copy(key, key + width, out);
+  for (size_t c = 0; c < columns.size(); c++) {
+    switch (columns[c].type->getKind()) {
+      case TypeKind::STRING:
+      case TypeKind::VARCHAR:
+      case TypeKind::CHAR:
+      case TypeKind::BINARY:
+        if (!(key[0] & (uint64_t(1) << c))) {
+          const uint32_t id = static_cast<uint32_t>(key[offsets[c]]);
+          out[offsets[c]] = pools[c].Intern(from.pools[c].Data(id),
+                                            from.pools[c].Length(id));
+        }
+        break;
+      default:
+        break;
+    }
+  }
+}
+vector<ColumnBuffer>
+KeyEncoder::Buffers() const
+{
+  vector<ColumnBuffer> buffers;
+  for (const auto& column : columns) {
+    buffers.emplace_back(column.title, column.type);
+  }
+  return buffers;
+}
+void
+KeyEncoder::Append(const uint64_t* key, vector<ColumnBuffer>& out) const
+{
+  for (size_t c = 0; c < columns.size(); c++) {
+    ColumnBuffer& buffer = out[c];
+    const bool isNull = (key[0] & (uint64_t(1) << c)) != 0;
+    const uint64_t word = key[offsets[c]];
+    buffer.notNull.emplace_back(isNull ? 0 : 1);
+    double real;
+    memcpy(&real, &word, sizeof(real));
+    switch (buffer.kind) {
+      case TypeKind::BOOLEAN:
+      case TypeKind::BYTE:
+      case TypeKind::SHORT:
+      case TypeKind::INT:
+      case TypeKind::DATE:
+        buffer.ints.emplace_back(static_cast<int32_t>(word));
+        break;
+      case TypeKind::LONG:
+        buffer.longs.emplace_back(static_cast<int64_t>(word));
+        break;
+      case TypeKind::FLOAT:
+        buffer.doubles.emplace_back(RoundFloat(real));
+        break;
+      case TypeKind::DOUBLE:
+        buffer.doubles.emplace_back(real);
+        break;
+      case TypeKind::DECIMAL:
+        if (columns[c].type->getPrecision() <= 18 &&
+            columns[c].type->getPrecision() != 0) {
+          buffer.doubles.emplace_back(
+            static_cast<double>(static_cast<int64_t>(word)) /
+            std::pow(10.0, columns[c].type->getScale()));
+        } else {
+          const Int128 unscaled(static_cast<int64_t>(word),
+                                key[offsets[c] + 1]);
+          buffer.doubles.emplace_back(strtod(
+            unscaled.toDecimalString(columns[c].type->getScale()).c_str(),
+            nullptr));
+        }
+        break;
+      case TypeKind::TIMESTAMP:
+        buffer.longs.emplace_back(static_cast<int64_t>(word));
+        buffer.ints.emplace_back(static_cast<int32_t>(key[offsets[c] + 1]));
+        break;
+      case TypeKind::STRING:
+      case TypeKind::VARCHAR:
+      case TypeKind::CHAR:
+      case TypeKind::BINARY:
+        if (!isNull) {
+          const uint32_t id = static_cast<uint32_t>(word);
+          const char* data = pools[c].Data(id);
+          buffer.chars.insert(
+            buffer.chars.end(), data, data + pools[c].Length(id));
+        }
+        buffer.offsets.emplace_back(buffer.chars.size());
+        break;
+      default:
+        break;
+    }
+  }
+}
+}
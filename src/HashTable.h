@@ -0,0 +1,178 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NORC_HASHTABLE_H
+#define NORC_HASHTABLE_H
+
+#include <orc/OrcFile.hh>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace norc {
+
+class ColumnBuffer;
+
+/**
+ * 64 bit hash of a byte string.
+ */
+uint64_t
+HashBytes(const char* data, size_t length);
+/**
+ * Bits of a double as a key, with -0.0 equal to 0.0 and every NaN equal.
+ */
+uint64_t
+DoubleKey(double value);
+/**
+ * Mix a 64 bit word into a hash.
+ */
+inline uint64_t
+HashCombine(uint64_t hash, uint64_t word)
+{
+  uint64_t x = hash ^ (word + 0x9e3779b97f4a7c15ULL + (hash << 6) +
+                       (hash >> 2));
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+/**
+ * Interns byte strings into dense ids in insertion order. Lookups hash the
+ * bytes where they are, a StringVectorBatch value is only copied the first
+ * time it is seen.
+ */
+class StringPool
+{
+public:
+  static const uint32_t MISSING = 0xffffffffU;
+  /**
+   * Id of the string, added to the pool unless insert is false, in which case
+   * MISSING is returned for strings that are not in the pool. Lookups without
+   * insert never modify the pool and can run concurrently.
+   */
+  uint32_t Intern(const char* data, size_t length, bool insert = true);
+  const char* Data(uint32_t id) const { return bytes.data() + offsets[id]; }
+  size_t Length(uint32_t id) const { return offsets[id + 1] - offsets[id]; }
+  size_t Size() const { return hashes.size(); }
+
+private:
+  void Grow();
+
+  vector<char> bytes;
+  vector<uint64_t> offsets{ 0 };
+  vector<uint64_t> hashes;
+  // id + 1 of the string in each slot, 0 for an empty slot
+  vector<uint32_t> slots;
+};
+
+/**
+ * Open addressing hash table from keys of a fixed number of 64 bit words to
+ * dense ids assigned in insertion order. Slots are probed linearly, the table
+ * doubles once it is half full. Keys and their hashes are stored by id, so a
+ * slot is a single id and growing never moves a key.
+ */
+class KeyTable
+{
+public:
+  explicit KeyTable(size_t width);
+  uint32_t FindOrInsert(const uint64_t* key, uint64_t hash);
+  /**
+   * Id of the key, or StringPool::MISSING when it is not in the table.
+   */
+  uint32_t Find(const uint64_t* key, uint64_t hash) const;
+  size_t Size() const { return hashes.size(); }
+  size_t Width() const { return width; }
+  const uint64_t* Key(uint32_t id) const { return keys.data() + id * width; }
+
+private:
+  void Grow();
+  bool Equals(uint32_t id, const uint64_t* key) const;
+
+  size_t width;
+  vector<uint64_t> keys;
+  vector<uint64_t> hashes;
+  // id + 1 of the key in each slot, 0 for an empty slot
+  vector<uint32_t> slots;
+};
+
+/**
+ * Encodes the values of key columns into the fixed width keys of a KeyTable:
+ * a word of null flags, then one word per column (two for TIMESTAMP, seconds
+ * and nanoseconds, and for a DECIMAL of more than 18 digits, the high and low
+ * words of its unscaled value). Numbers are stored as their int64 value or
+ * double bits, strings and binaries as their id in a StringPool of the column.
+ */
+class KeyEncoder
+{
+public:
+  struct Column
+  {
+    string title;
+    const orc::Type* type;
+  };
+  static const size_t MAX_COLUMNS = 64;
+  /**
+   * Whether values of the kind can be part of a key.
+   */
+  static bool Supported(orc::TypeKind);
+  explicit KeyEncoder(vector<Column> columns);
+  size_t Width() const { return width; }
+  /**
+   * Encode rows[0..n) of the fields of a struct batch at the given positions
+   * into n keys and their hashes. With insert false, strings that were never
+   * interned are encoded as StringPool::MISSING so the key matches nothing.
+   */
+  void Encode(const orc::StructVectorBatch&,
+              const vector<size_t>& positions,
+              const uint32_t* rows,
+              uint64_t n,
+              vector<uint64_t>& keys,
+              vector<uint64_t>& hashes,
+              bool insert = true);
+  uint64_t Hash(const uint64_t* key) const;
+  /**
+   * Encode a key of another encoder of the same columns with the string ids
+   * of this one.
+   */
+  void Translate(const KeyEncoder& from, const uint64_t* key, uint64_t* out);
+  /**
+   * Append the values of a key to one buffer per column, to convert them to
+   * JS the way values are read.
+   */
+  void Append(const uint64_t* key, vector<ColumnBuffer>& out) const;
+  /**
+   * One empty buffer per column, for Append.
+   */
+  vector<ColumnBuffer> Buffers() const;
+
+  vector<Column> columns;
+
+private:
+  size_t width = 1;
+  // first word of each column in a key
+  vector<size_t> offsets;
+  vector<StringPool> pools;
+};
+}
+
+#endif // NORC_HASHTABLE_H
@@ -3,211 +3,167 @@
 //
 
 #include "Internal.h"
-#include "../include/json.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <ctime>
 #include <orc/OrcFile.hh>
 
 using namespace Napi;
 using namespace orc;
-using json = nlohmann::json;
 using std::string;
 
 namespace norc {
-void
-LineToJSON(Napi::Env env, std::string& line, Napi::Object& target)
+std::string
+FormatDate(int64_t days)
 {
-  json j = json::parse(line);
-  for (json::iterator it = j.begin(); it != j.end(); ++it) {
-    const string& k = it.key();
-    if (it.value().is_boolean()) {
-      target.Set(k, Boolean::New(env, it.value()));
-    } else if (it.value().is_number() || it.value().is_number_float() ||
-               it.value().is_number_integer() ||
-               it.value().is_number_unsigned()) {
-      target.Set(k, Number::New(env, it.value()));
-    } else if (it.value().is_string()) {
-      string v = it.value();
-      target.Set(k, String::New(env, v));
-    } else if (it.value().is_null()) {
-      target.Set(k, env.Null());
-    } else {
-      target.Set(k,
-                 Error::New(env,
-                            string("Unable to convert ")
-                              .append(k)
-                              .append(" from string: ")
-                              .append(line))
-                   .Value());
+  time_t seconds = static_cast<time_t>(days * 24 * 60 * 60);
+  struct tm tm
+  {};
+  gmtime_r(&seconds, &tm);
+  char out[16];
+  strftime(out, sizeof(out), "%Y-%m-%d", &tm);
+  return out;
+}
+std::string
+FormatTimestamp(int64_t seconds, int64_t nanos)
+{
+  time_t secs = static_cast<time_t>(seconds);
+  struct tm tm
+  {};
+  gmtime_r(&secs, &tm);
+  char out[48];
+  size_t length = strftime(out, sizeof(out), "%Y-%m-%d %H:%M:%S", &tm);
+  int zeroDigits = 0;
+  if (nanos == 0) {
+    zeroDigits = 8;
+  } else {
+    while (nanos % 10 == 0) {
+      nanos /= 10;
+      zeroDigits++;
     }
   }
+  snprintf(out + length,
+           sizeof(out) - length,
+           ".%0*lld",
+           9 - zeroDigits,
+           static_cast<long long>(nanos));
+  return out;
 }
-void
-AddNumberType(Napi::Env env,
-              orc::ColumnVectorBatch* batch,
-              uint64_t offset,
-              Napi::Value value)
+double
+RoundFloat(double value)
 {
-  auto longBatch = dynamic_cast<LongVectorBatch*>(batch);
-  if (value.IsNull()) {
-    batch->notNull[offset] = 0;
-    longBatch->hasNulls = true;
-  } else {
-    batch->notNull[offset] = 1;
-    longBatch->data[offset] = value.As<Number>().Uint32Value();
-    longBatch->numElements = offset;
+  if (!std::isfinite(value)) {
+    return value;
   }
+  // shortest round trip of the float, no locale or format parsing
+  char text[32];
+  const auto written =
+    std::to_chars(text, text + sizeof(text), static_cast<float>(value));
+  double out = value;
+  std::from_chars(text, written.ptr, out);
+  return out;
 }
-void
-AddStringType(Napi::Env env,
-              orc::ColumnVectorBatch* batch,
-              orc::DataBuffer<char>* buffer,
-              uint64_t batchOffset,
-              uint64_t* bufferOffset,
-              Napi::Value value)
+bool
+ParseDate(const std::string& value, int64_t& days)
 {
-  auto stringBatch = dynamic_cast<StringVectorBatch*>(batch);
-  if (value.IsNull()) {
-    batch->notNull[batchOffset] = 0;
-    stringBatch->hasNulls = true;
-  } else {
-    string v = value.As<String>();
-    batch->notNull[batchOffset] = 1;
-    if (buffer->size() - *bufferOffset < v.size()) {
-      buffer->reserve(buffer->size() * 2);
+  struct tm tm
+  {};
+  char* left = strptime(value.c_str(), "%Y-%m-%d", &tm);
+  if (left == nullptr || *left != '\0') {
+    return false;
+  }
+  days = static_cast<int64_t>(timegm(&tm)) / (24 * 60 * 60);
+  return true;
+}
+bool
+ParseTimestamp(const std::string& value, int64_t& seconds, int64_t& nanos)
+{
+  struct tm tm
+  {};
+  char* left = strptime(value.c_str(), "%Y-%m-%d %H:%M:%S", &tm);
+  if (left == nullptr) {
+    return false;
+  }
+  seconds = timegm(&tm);
+  nanos = 0;
+  if (*left == '.') {
+    char* tail;
+    double fraction = strtod(left, &tail);
+    if (*tail != '\0') {
+      return false;
     }
-    memcpy(buffer->data() + *bufferOffset, v.c_str(), v.size());
-    stringBatch->data[batchOffset] = buffer->data() + *bufferOffset;
-    stringBatch->length[batchOffset] = static_cast<long>(v.size());
-    *bufferOffset += v.size();
+    nanos = std::llround(fraction * 1000000000.0);
+  } else if (*left != '\0') {
+    return false;
   }
-  stringBatch->numElements = batchOffset;
+  return true;
 }
-void
-AddBoolType(Napi::Env env,
-            orc::ColumnVectorBatch* batch,
-            uint64_t batchOffset,
-            Napi::Value value)
+char*
+StringArena::Allocate(size_t length)
 {
-  auto boolBatch = dynamic_cast<LongVectorBatch*>(batch);
-  if (value.IsNull()) {
-    batch->notNull[batchOffset] = 0;
-    boolBatch->hasNulls = true;
-  } else {
-    batch->notNull[batchOffset] = 1;
-    boolBatch->data[batchOffset] = value.As<Boolean>();
+  while (block < blocks.size() && used + length > blocks[block].size()) {
+    block++;
+    used = 0;
   }
-  boolBatch->numElements = batchOffset;
+  if (block == blocks.size()) {
+    blocks.emplace_back(std::max(BLOCK_SIZE, length));
+  }
+  char* out = blocks[block].data() + used;
+  used += length;
+  return out;
 }
-void
-AddFloatType(Napi::Env env,
-             orc::ColumnVectorBatch* batch,
-             uint64_t batchOffset,
-             Napi::Value value)
+char*
+StringArena::Copy(const char* data, size_t length)
 {
-  auto dblBatch = dynamic_cast<DoubleVectorBatch*>(batch);
-  if (value.IsNull()) {
-    batch->notNull[batchOffset] = 0;
-    dblBatch->hasNulls = true;
-  } else {
-    batch->notNull[batchOffset] = 1;
-    dblBatch->data[batchOffset] = value.As<Number>().DoubleValue();
+  char* out = Allocate(length);
+  if (length > 0) {
+    memcpy(out, data, length);
   }
-  dblBatch->numElements = batchOffset;
+  return out;
 }
-void
-AddTimeType(Napi::Env env,
-            orc::ColumnVectorBatch* batch,
-            uint64_t batchOffset,
-            Napi::Value value)
+bool
+ParseDecimal(const string& value, int32_t scale, Int128& out)
 {
-  auto tsBatch = dynamic_cast<TimestampVectorBatch*>(batch);
-  struct tm timeStruct
-  {};
-  if (value.IsNull()) {
-    batch->notNull[batchOffset] = 0;
-    tsBatch->hasNulls = true;
-  } else {
-    string v = value.As<String>();
-    memset(&timeStruct, 0, sizeof(timeStruct));
-    char* left = strptime(v.c_str(), "%Y-%m-%d %H:%M:%S", &timeStruct);
-    if (left == nullptr) {
-      batch->notNull[batchOffset] = 0;
-    } else {
-      batch->notNull[batchOffset] = 1;
-      tsBatch->data[batchOffset] = timegm(&timeStruct);
-      char* tail;
-      double d = strtod(left, &tail);
-      if (tail != left) {
-        tsBatch->nanoseconds[batchOffset] = static_cast<long>(d * 1000000000.0);
-      } else {
-        tsBatch->nanoseconds[batchOffset] = 0;
-      }
-    }
+  const size_t point = value.find('.');
+  string digits = value.substr(0, point);
+  string fraction = point == string::npos ? "" : value.substr(point + 1);
+  fraction.resize(static_cast<size_t>(scale), '0');
+  digits += fraction;
+  const size_t first = digits[0] == '-' || digits[0] == '+' ? 1 : 0;
+  if (digits.size() == first ||
+      digits.find_first_not_of("0123456789", first) != string::npos) {
+    return false;
   }
-  tsBatch->numElements = batchOffset;
+  out = Int128(digits);
+  return true;
+}
+bool
+FitsInt64(double value)
+{
+  // -2^63 is exact as a double, 2^63 is the first value past the range
+  return value >= -9223372036854775808.0 && value < 9223372036854775808.0;
 }
 void
-AddDecimalType(Napi::Env env,
-               orc::ColumnVectorBatch* batch,
-               orc::Type* type,
-               uint64_t batchOffset,
-               int idx,
-               Napi::Value value)
+SplitMillis(double millis, int64_t& seconds, int64_t& nanos)
 {
-  auto precision = type->getPrecision();
-  auto scale = type->getScale();
-  orc::Decimal128VectorBatch* d128Batch = ORC_NULLPTR;
-  orc::Decimal64VectorBatch* d64Batch = ORC_NULLPTR;
-  if (precision <= 18) {
-    d64Batch = dynamic_cast<orc::Decimal64VectorBatch*>(batch);
-    d64Batch->scale = static_cast<int32_t>(scale);
-  } else {
-    d128Batch = dynamic_cast<orc::Decimal128VectorBatch*>(batch);
-    d128Batch->scale = static_cast<int32_t>(scale);
-  }
-  if (value.IsNull()) {
-    batch->notNull[batchOffset] = 0;
-    if (precision <= 18) {
-      d64Batch->hasNulls = true;
-    } else {
-      d128Batch->hasNulls = true;
-    }
-
-  } else {
-    auto v = value.As<Number>().Uint32Value();
-    Int128 decimal(v);
-    batch->notNull[batchOffset] = 1;
-
-    if (precision <= 18) {
-      d64Batch->values[idx] = decimal.toLong();
-    } else {
-      d128Batch->values[idx] = decimal;
-    }
+  const double whole = std::floor(millis / 1000.0);
+  seconds = static_cast<int64_t>(whole);
+  nanos = std::llround((millis - whole * 1000.0) * 1000000.0);
+  if (nanos >= 1000000000) {
+    seconds++;
+    nanos -= 1000000000;
   }
-  d64Batch->numElements = batchOffset;
 }
 void
-AddDateType(Napi::Env env,
-            orc::ColumnVectorBatch* batch,
-            uint64_t batchOffset,
-            Napi::Value value)
+SplitNanos(int64_t value, int64_t& seconds, int64_t& nanos)
 {
-  auto timeBatch = dynamic_cast<LongVectorBatch*>(batch);
-  if (value.IsNull()) {
-    batch->notNull[batchOffset] = 0;
-    timeBatch->hasNulls = true;
-  } else {
-    string v = value.As<String>();
-    batch->notNull[batchOffset] = 1;
-    struct tm tm
-    {};
-    memset(&tm, 0, sizeof(struct tm));
-    strptime(v.c_str(), "%Y-%m-%d", &tm);
-    time_t t = mktime(&tm);
-    time_t t1970 = 0;
-    double seconds = difftime(t, t1970);
-    auto days = static_cast<int64_t>(seconds / (60 * 60 * 24));
-    timeBatch->data[batchOffset] = days;
+  seconds = value / 1000000000;
+  nanos = value % 1000000000;
+  if (nanos < 0) {
+    seconds--;
+    nanos += 1000000000;
   }
-  timeBatch->numElements = batchOffset;
 }
 }
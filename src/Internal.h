@@ -7,25 +7,97 @@
 
 #include <napi.h>
 #include <orc/OrcFile.hh>
+#include <vector>
 
 namespace norc {
 
+/**
+ * Storage for the bytes of the strings of a batch, a StringVectorBatch only
+ * points at them. Blocks are never reallocated, so the pointers handed out
+ * stay valid until Clear, once the batch was passed to orc::Writer::add.
+ */
+class StringArena
+{
+public:
+  static constexpr size_t BLOCK_SIZE = 4 * 1024 * 1024;
+  char* Allocate(size_t length);
+  char* Copy(const char* data, size_t length);
+  /**
+   * Reuse the blocks for the strings of the next batch.
+   */
+  void Clear()
+  {
+    block = 0;
+    used = 0;
+  }
+
+private:
+  std::vector<std::vector<char>> blocks;
+  size_t block = 0;
+  size_t used = 0;
+};
+
+/**
+ * Format days since epoch as YYYY-mm-dd
+ */
+std::string
+FormatDate(int64_t days);
+/**
+ * Format a timestamp as YYYY-mm-dd HH:MM:SS.n, trailing zeros of the
+ * fractional seconds are removed (same output as orc::ColumnPrinter).
+ */
+std::string
+FormatTimestamp(int64_t seconds, int64_t nanos);
+/**
+ * A FLOAT value widened to double by orc, as the double of its shortest
+ * decimal form, so 3.99 does not come back as 3.990000009536743.
+ */
+double
+RoundFloat(double value);
+/**
+ * Parse YYYY-mm-dd (UTC) into days since epoch, false if the value does not
+ * match the format.
+ */
+bool
+ParseDate(const std::string& value, int64_t& days);
+/**
+ * Parse YYYY-mm-dd HH:MM:SS[.n] (UTC) into seconds and nanoseconds since
+ * epoch, false if the value does not match the format.
+ */
+bool
+ParseTimestamp(const std::string& value, int64_t& seconds, int64_t& nanos);
+/**
+ * Parse a decimal string into its unscaled value at the given scale, extra
+ * fractional digits are truncated. False if the value is not a decimal.
+ */
+bool
+ParseDecimal(const std::string& value, int32_t scale, orc::Int128& out);
+/**
+ * Whether a double is finite and within the range of int64, so converting it
+ * to an integer is defined.
+ */
+bool
+FitsInt64(double value);
+/**
+ * Epoch milliseconds as seconds and nanoseconds, the nanoseconds are never
+ * negative. millis must pass FitsInt64.
+ */
 void
-LineToJSON(Napi::Env, std::string&, Napi::Object&);
-void
-AddNumberType(Napi::Env, orc::ColumnVectorBatch*, uint64_t, Napi::Value);
-void
-AddStringType(Napi::Env, orc::ColumnVectorBatch*, orc::DataBuffer<char>*, uint64_t batchOffset, uint64_t* bufferOffset, Napi::Value);
-void
-AddBoolType(Napi::Env, orc::ColumnVectorBatch*, uint64_t, Napi::Value);
-void
-AddFloatType(Napi::Env, orc::ColumnVectorBatch*, uint64_t, Napi::Value);
-void
-AddTimeType(Napi::Env, orc::ColumnVectorBatch*, uint64_t, Napi::Value);
-void
-AddDecimalType(Napi::Env, orc::ColumnVectorBatch*, const orc::Type*, uint64_t batchOffset, int index, Napi::Value);
+SplitMillis(double millis, int64_t& seconds, int64_t& nanos);
+/**
+ * Epoch nanoseconds as seconds and nanoseconds, the nanoseconds are never
+ * negative.
+ */
 void
-AddDateType(Napi::Env, orc::ColumnVectorBatch*, uint64_t batchOffset, Napi::Value);
+SplitNanos(int64_t value, int64_t& seconds, int64_t& nanos);
+/**
+ * null and undefined are both written as a null value.
+ */
+inline bool
+IsNullValue(const Napi::Value& value)
+{
+  return value.IsNull() || value.IsUndefined();
+}
 }
 
 #endif // NORC_INTERNAL_H
@@ -0,0 +1,535 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ColumnBuffer.h"
+#include "HashTable.h"
+#include "Reader.h"
+#include "StripeScan.h"
+#include "ValidateArguments.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+using namespace Napi;
+using namespace orc;
+
+using std::make_unique;
+using std::numeric_limits;
+
+namespace norc {
+
+/**
+ * One input of a join: its reader, the positions of its key columns and of
+ * the columns it adds to the joined rows in the decoded batches, and the scan
+ * decoding exactly those columns.
+ */
+struct JoinSide
+{
+  Reader* reader;
+  list<uint64_t> keyFields;
+  // fields of the joined columns taken from this side
+  list<uint64_t> outputFields;
+  ScanOptions scan;
+  vector<size_t> keyPositions;
+  vector<size_t> outputPositions;
+
+  /**
+   * Resolve the positions of the key and joined columns in the selected type
+   * of a scan of this side.
+   */
+  void Bind(const orc::Type& selected)
+  {
+    auto positions = [&](const list<uint64_t>& fields) {
+      vector<size_t> out;
+      for (auto field : fields) {
+        const string& title = reader->fileMeta[field].title;
+        for (uint64_t i = 0; i < selected.getSubtypeCount(); i++) {
+          if (selected.getFieldName(i) == title) {
+            out.emplace_back(i);
+          }
+        }
+      }
+      return out;
+    };
+    keyPositions = positions(keyFields);
+    outputPositions = positions(outputFields);
+  }
+};
+
+/**
+ * Where a joined column comes from: a side and the index of the column among
+ * the joined columns of that side.
+ */
+struct JoinColumn
+{
+  bool left;
+  size_t index;
+};
+
+class JoinWorker : public AsyncWorker
+{
+public:
+  static const uint32_t NONE = numeric_limits<uint32_t>::max();
+
+  JoinWorker(Function& cb,
+             Napi::Object left,
+             Napi::Object right,
+             JoinSide leftSide,
+             JoinSide rightSide,
+             vector<JoinColumn> columns,
+             bool outer,
+             bool typed)
+    : AsyncWorker(cb, "join_worker", left)
+    , leftRef(Persistent(left))
+    , rightRef(Persistent(right))
+    , columns(std::move(columns))
+    , outer(outer)
+    , typed(typed)
+  {
+    sides[0] = std::move(leftSide);
+    sides[1] = std::move(rightSide);
+  }
+
+protected:
+  void Execute() override
+  {
+    try {
+      // the smaller file is held in memory, the larger one streamed
+      const bool buildLeft = sides[0].reader->reader->getNumberOfRows() <=
+                             sides[1].reader->reader->getNumberOfRows();
+      JoinSide& build = sides[buildLeft ? 0 : 1];
+      JoinSide& probe = sides[buildLeft ? 1 : 0];
+      Build(build);
+      Probe(probe, buildLeft);
+    } catch (std::exception& ex) {
+      SetError(ex.what());
+    }
+  }
+  void OnOK() override
+  {
+    auto env = Env();
+    if (typed) {
+      auto out = Object::New(env);
+      for (auto& column : joined) {
+        out.Set(column.title, column.ToTypedArray(env));
+      }
+      Callback().Call({ env.Null(), out });
+      return;
+    }
+    const uint64_t size = joined.empty() ? 0 : joined[0].Size();
+    vector<napi_value> keys;
+    for (auto& column : joined) {
+      keys.emplace_back(String::New(env, column.title));
+    }
+    auto out = Array::New(env, size);
+    for (uint32_t row = 0; row < size; row++) {
+      auto object = Object::New(env);
+      for (size_t i = 0; i < joined.size(); i++) {
+        object.Set(keys[i], joined[i].Get(env, row));
+      }
+      out.Set(row, object);
+    }
+    Callback().Call({ env.Null(), out });
+  }
+
+private:
+  ObjectReference leftRef;
+  ObjectReference rightRef;
+  JoinSide sides[2];
+  vector<JoinColumn> columns;
+  // rows of the left side without a match are kept, with nulls on the right
+  bool outer;
+  bool typed;
+  vector<ColumnBuffer> joined;
+
+  // the build side: its joined columns, and the rows of every key chained in
+  // file order through next
+  unique_ptr<KeyEncoder> encoder;
+  unique_ptr<KeyTable> table;
+  vector<ColumnBuffer> built;
+  vector<uint32_t> heads;
+  vector<uint32_t> tails;
+  vector<uint32_t> next;
+
+  vector<ColumnBuffer> OutputBuffers() const
+  {
+    vector<ColumnBuffer> buffers;
+    for (auto& column : columns) {
+      const JoinSide& side = sides[column.left ? 0 : 1];
+      const uint64_t field = *std::next(side.outputFields.begin(),
+                                        static_cast<long>(column.index));
+      buffers.emplace_back(side.reader->fileMeta[field].title,
+                           side.reader->reader->getType().getSubtype(field));
+    }
+    return buffers;
+  }
+  void Build(JoinSide& side)
+  {
+    const orc::Reader& file = *side.reader->reader;
+    vector<KeyEncoder::Column> keyColumns;
+    for (auto field : side.keyFields) {
+      keyColumns.emplace_back(KeyEncoder::Column{
+        side.reader->fileMeta[field].title, file.getType().getSubtype(field) });
+    }
+    encoder = make_unique<KeyEncoder>(std::move(keyColumns));
+    table = make_unique<KeyTable>(encoder->Width());
+    for (auto field : side.outputFields) {
+      built.emplace_back(side.reader->fileMeta[field].title,
+                         file.getType().getSubtype(field));
+    }
+    // keys are interned into a single table, the build side is one range
+    ScanOptions scan = side.scan;
+    scan.parallel = 1;
+    StripeScan scanner(side.reader->ScanFile(scan), scan);
+    side.Bind(scanner.SelectedType());
+    vector<uint32_t> rows;
+    vector<uint64_t> keys;
+    vector<uint64_t> hashes;
+    const size_t width = encoder->Width();
+    scanner.Run([&](size_t,
+                    const ColumnVectorBatch& batch,
+                    const Selection* selection) {
+      auto& fields = dynamic_cast<const StructVectorBatch&>(batch).fields;
+      const uint64_t n = batch.numElements;
+      if (next.size() + n >= NONE) {
+        throw std::runtime_error("join build side has too many rows");
+      }
+      while (rows.size() < n) {
+        rows.emplace_back(static_cast<uint32_t>(rows.size()));
+      }
+      for (size_t i = 0; i < built.size(); i++) {
+        built[i].Append(*fields[side.outputPositions[i]]);
+      }
+      encoder->Encode(dynamic_cast<const StructVectorBatch&>(batch),
+                      side.keyPositions,
+                      rows.data(),
+                      n,
+                      keys,
+                      hashes);
+      for (uint64_t i = 0; i < n; i++) {
+        const uint32_t row = static_cast<uint32_t>(next.size());
+        next.emplace_back(NONE);
+        // a null key component never matches
+        if (keys[i * width] != 0) {
+          continue;
+        }
+        const uint32_t id =
+          table->FindOrInsert(keys.data() + i * width, hashes[i]);
+        if (id == heads.size()) {
+          heads.emplace_back(row);
+          tails.emplace_back(row);
+        } else {
+          next[tails[id]] = row;
+          tails[id] = row;
+        }
+      }
+    });
+  }
+  void Probe(JoinSide& side, bool buildLeft)
+  {
+    StripeScan scanner(side.reader->ScanFile(side.scan), side.scan);
+    side.Bind(scanner.SelectedType());
+    const size_t width = encoder->Width();
+    // every range joins into its own buffers, concatenated in file order
+    struct Partial
+    {
+      vector<ColumnBuffer> columns;
+      vector<char> matched;
+      vector<uint32_t> all;
+      vector<uint64_t> keys;
+      vector<uint64_t> hashes;
+      vector<uint32_t> probeRows;
+      vector<uint32_t> buildRows;
+    };
+    vector<Partial> partials(scanner.Size());
+    for (auto& partial : partials) {
+      partial.columns = OutputBuffers();
+      if (outer && buildLeft) {
+        partial.matched.resize(next.size(), 0);
+      }
+    }
+    scanner.Run([&](size_t range,
+                    const ColumnVectorBatch& batch,
+                    const Selection* selection) {
+      Partial& partial = partials[range];
+      const uint64_t n = batch.numElements;
+      while (partial.all.size() < n) {
+        partial.all.emplace_back(static_cast<uint32_t>(partial.all.size()));
+      }
+      auto& rows = dynamic_cast<const StructVectorBatch&>(batch);
+      encoder->Encode(rows,
+                      side.keyPositions,
+                      partial.all.data(),
+                      n,
+                      partial.keys,
+                      partial.hashes,
+                      false);
+      partial.probeRows.clear();
+      partial.buildRows.clear();
+      for (uint64_t i = 0; i < n; i++) {
+        uint32_t match = NONE;
+        if (partial.keys[i * width] == 0) {
+          const uint32_t id =
+            table->Find(partial.keys.data() + i * width, partial.hashes[i]);
+          if (id != StringPool::MISSING) {
+            match = heads[id];
+          }
+        }
+        if (match == NONE && outer && !buildLeft) {
+          partial.probeRows.emplace_back(static_cast<uint32_t>(i));
+          partial.buildRows.emplace_back(NONE);
+        }
+        for (; match != NONE; match = next[match]) {
+          partial.probeRows.emplace_back(static_cast<uint32_t>(i));
+          partial.buildRows.emplace_back(match);
+          if (!partial.matched.empty()) {
+            partial.matched[match] = 1;
+          }
+        }
+      }
+      for (size_t c = 0; c < columns.size(); c++) {
+        ColumnBuffer& out = partial.columns[c];
+        if (columns[c].left != buildLeft) {
+          out.Append(*rows.fields[side.outputPositions[columns[c].index]],
+                     partial.probeRows);
+          continue;
+        }
+        const ColumnBuffer& source = built[columns[c].index];
+        for (auto row : partial.buildRows) {
+          if (row == NONE) {
+            out.AppendNull();
+          } else {
+            out.AppendFrom(source, row);
+          }
+        }
+      }
+    });
+    joined = OutputBuffers();
+    for (auto& partial : partials) {
+      for (size_t c = 0; c < columns.size(); c++) {
+        joined[c].Concat(partial.columns[c]);
+      }
+    }
+    if (outer && buildLeft) {
+      // left rows no right row matched, after the matches
+      for (uint32_t row = 0; row < next.size(); row++) {
+        bool matched = false;
+        for (auto& partial : partials) {
+          matched = matched || partial.matched[row];
+        }
+        if (matched) {
+          continue;
+        }
+        for (size_t c = 0; c < columns.size(); c++) {
+          if (columns[c].left) {
+            joined[c].AppendFrom(built[columns[c].index], row);
+          } else {
+            joined[c].AppendNull();
+          }
+        }
+      }
+    }
+  }
+};
+
+/**
+ * Kinds of key values that are encoded the same way and can be compared.
+ */
+static string
+KeyClass(const orc::Type& type)
+{
+  switch (type.getKind()) {
+    case TypeKind::BYTE:
+    case TypeKind::SHORT:
+    case TypeKind::INT:
+    case TypeKind::LONG:
+      return "integer";
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+      return "real";
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR:
+    case TypeKind::BINARY:
+      return "string";
+    default:
+      return type.toString();
+  }
+}
+
+void
+Reader::Join(const CallbackInfo& info)
+{
+  AssertCallbackInfo(info,
+                     { { 0, { option(napi_object) } },
+                       { 1, { option(napi_object) } },
+                       { 2, { option(napi_object) } },
+                       { 3, { option(napi_function) } } });
+  auto env = info.Env();
+  if (env.IsExceptionPending()) {
+    return;
+  }
+  auto leftObject = info[0].As<Object>();
+  auto rightObject = info[1].As<Object>();
+  if (!leftObject.InstanceOf(constructor.Value()) ||
+      !rightObject.InstanceOf(constructor.Value())) {
+    TypeError::New(env, "join expects two readers")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  auto options = info[2].As<Object>();
+  auto cb = info[3].As<Function>();
+  JoinSide left{ Reader::Unwrap(leftObject) };
+  JoinSide right{ Reader::Unwrap(rightObject) };
+  Napi::Value on = options.Get("on");
+  Array keys;
+  if (on.IsString()) {
+    keys = Array::New(env, 1);
+    keys.Set(0u, on);
+  } else if (on.IsArray()) {
+    keys = on.As<Array>();
+  } else {
+    TypeError::New(env, "on must be a column title or an array of titles")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  if (!left.reader->ResolveColumns(env, keys, left.keyFields) ||
+      !right.reader->ResolveColumns(env, keys, right.keyFields)) {
+    return;
+  }
+  if (left.keyFields.empty() ||
+      left.keyFields.size() > KeyEncoder::MAX_COLUMNS) {
+    RangeError::New(env, "join needs between 1 and 64 key columns")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  for (auto l = left.keyFields.begin(), r = right.keyFields.begin();
+       l != left.keyFields.end();
+       l++, r++) {
+    const orc::Type* leftType = left.reader->reader->getType().getSubtype(*l);
+    const orc::Type* rightType =
+      right.reader->reader->getType().getSubtype(*r);
+    if (!KeyEncoder::Supported(leftType->getKind()) ||
+        KeyClass(*leftType) != KeyClass(*rightType)) {
+      TypeError::New(env,
+                     "Cannot join column " + left.reader->fileMeta[*l].title +
+                       " of type " + leftType->toString() + " with type " +
+                       rightType->toString())
+        .ThrowAsJavaScriptException();
+      return;
+    }
+  }
+  bool outer = false;
+  if (options.Has("type")) {
+    string type = options.Get("type").ToString();
+    if (type != "inner" && type != "left") {
+      RangeError::New(env, "type must be inner or left")
+        .ThrowAsJavaScriptException();
+      return;
+    }
+    outer = type == "left";
+  }
+  // joined columns are looked up on the left side first, the key columns
+  // only come from the left
+  vector<JoinColumn> columns;
+  auto add = [&](JoinSide& side, bool isLeft, uint64_t field) {
+    side.outputFields.emplace_back(field);
+    columns.emplace_back(JoinColumn{ isLeft, side.outputFields.size() - 1 });
+  };
+  auto lookup = [](JoinSide& side, const string& title) -> int64_t {
+    for (auto& column : side.reader->fileMeta) {
+      if (column.title == title) {
+        return column.index;
+      }
+    }
+    return -1;
+  };
+  if (options.Has("columns")) {
+    auto titles = options.Get("columns").As<Array>();
+    for (uint32_t i = 0; i < titles.Length(); i++) {
+      string title = titles.Get(i).ToString();
+      const int64_t leftField = lookup(left, title);
+      const int64_t rightField = lookup(right, title);
+      if (leftField >= 0) {
+        add(left, true, static_cast<uint64_t>(leftField));
+      } else if (rightField >= 0) {
+        add(right, false, static_cast<uint64_t>(rightField));
+      } else {
+        Error::New(env, title + " not a valid column header")
+          .ThrowAsJavaScriptException();
+        return;
+      }
+    }
+  } else {
+    for (auto& column : left.reader->fileMeta) {
+      add(left, true, column.index);
+    }
+    for (auto& column : right.reader->fileMeta) {
+      if (std::find(right.keyFields.begin(),
+                    right.keyFields.end(),
+                    column.index) != right.keyFields.end()) {
+        continue;
+      }
+      if (lookup(left, column.title) >= 0) {
+        Error::New(env,
+                   "Column " + column.title +
+                     " is on both sides, list the columns to keep")
+          .ThrowAsJavaScriptException();
+        return;
+      }
+      add(right, false, column.index);
+    }
+  }
+  // only the decoding options apply to both sides
+  auto scanOptions = Object::New(env);
+  for (auto name : { "chunkSize", "parallel" }) {
+    if (options.Has(name)) {
+      scanOptions.Set(name, options.Get(name));
+    }
+  }
+  ScanOptions scan;
+  if (!left.reader->ParseScanOptions(env, scanOptions, scan)) {
+    return;
+  }
+  for (auto side : { &left, &right }) {
+    side->scan.chunkSize = scan.chunkSize;
+    side->scan.parallel = scan.parallel;
+    side->scan.includes = side->keyFields;
+    for (auto field : side->outputFields) {
+      if (std::find(side->scan.includes.begin(),
+                    side->scan.includes.end(),
+                    field) == side->scan.includes.end()) {
+        side->scan.includes.emplace_back(field);
+      }
+    }
+  }
+  bool typed = false;
+  if (options.Has("resultType")) {
+    typed = options.Get("resultType").ToString().Utf8Value() == "columns";
+  }
+  auto worker = new JoinWorker(cb,
+                               leftObject,
+                               rightObject,
+                               std::move(left),
+                               std::move(right),
+                               std::move(columns),
+                               outer,
+                               typed);
+  worker->Queue();
+}
+}
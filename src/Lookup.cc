@@ -0,0 +1,333 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ColumnBuffer.h"
+#include "Predicate.h"
+#include "Reader.h"
+#include "Statistics.h"
+#include "StripeScan.h"
+#include "ValidateArguments.h"
+#include <algorithm>
+#include <set>
+#include <unordered_set>
+
+using namespace Napi;
+using namespace orc;
+
+using std::make_unique;
+using std::pair;
+using std::unordered_set;
+
+namespace norc {
+
+/**
+ * The keys of a lookup, in the representation of the key column.
+ */
+struct LookupKeys
+{
+  Predicate column;
+  unordered_set<int64_t> integers;
+  unordered_set<double> reals;
+  unordered_set<string> texts;
+  std::set<pair<int64_t, int64_t>> timestamps;
+
+  explicit LookupKeys(Predicate in)
+    : column(std::move(in))
+  {
+    for (auto& literal : column.literals) {
+      integers.insert(literal.integer);
+      reals.insert(literal.real);
+      texts.insert(literal.text);
+      timestamps.emplace(literal.integer, literal.nanos);
+    }
+  }
+  /**
+   * Whether the bloom filter of a row group may contain one of the keys.
+   * Kinds whose bloom filter encoding is not handled here always may.
+   */
+  bool MayContain(const BloomFilter& filter) const
+  {
+    for (auto& literal : column.literals) {
+      switch (column.kind) {
+        case TypeKind::BYTE:
+        case TypeKind::SHORT:
+        case TypeKind::INT:
+        case TypeKind::LONG:
+        case TypeKind::DATE:
+          if (filter.testLong(literal.integer)) {
+            return true;
+          }
+          break;
+        case TypeKind::FLOAT:
+        case TypeKind::DOUBLE:
+          if (filter.testDouble(column.Real(literal))) {
+            return true;
+          }
+          break;
+        case TypeKind::STRING:
+        case TypeKind::VARCHAR:
+        case TypeKind::CHAR:
+          if (filter.testBytes(literal.text.data(),
+                               static_cast<int64_t>(literal.text.size()))) {
+            return true;
+          }
+          break;
+        default:
+          return true;
+      }
+    }
+    return false;
+  }
+  /**
+   * Whether the minimum and maximum of a row group allow one of the keys.
+   */
+  bool MayContain(const ColumnSummary& stats) const
+  {
+    if (stats.count == 0) {
+      return false;
+    }
+    if (!stats.hasMinMax) {
+      return true;
+    }
+    for (auto& literal : column.literals) {
+      switch (column.kind) {
+        case TypeKind::FLOAT:
+        case TypeKind::DOUBLE:
+        case TypeKind::DECIMAL:
+          if (column.Real(literal) >= stats.minReal &&
+              column.Real(literal) <= stats.maxReal) {
+            return true;
+          }
+          break;
+        case TypeKind::STRING:
+        case TypeKind::VARCHAR:
+        case TypeKind::CHAR:
+          if (literal.text >= stats.minText && literal.text <= stats.maxText) {
+            return true;
+          }
+          break;
+        case TypeKind::TIMESTAMP: {
+          // statistics are kept in milliseconds
+          const int64_t millis =
+            literal.integer * 1000 + literal.nanos / 1000000;
+          if (millis >= stats.minInteger && millis <= stats.maxInteger) {
+            return true;
+          }
+          break;
+        }
+        default:
+          if (literal.integer >= stats.minInteger &&
+              literal.integer <= stats.maxInteger) {
+            return true;
+          }
+          break;
+      }
+    }
+    return false;
+  }
+  bool Matches(const ColumnBuffer& values, uint64_t row) const
+  {
+    if (!values.notNull[row]) {
+      return false;
+    }
+    switch (column.kind) {
+      case TypeKind::LONG:
+        return integers.count(values.longs[row]) > 0;
+      case TypeKind::FLOAT:
+      case TypeKind::DOUBLE:
+      case TypeKind::DECIMAL:
+        return reals.count(values.doubles[row]) > 0;
+      case TypeKind::TIMESTAMP:
+        return timestamps.count({ values.longs[row], values.ints[row] }) > 0;
+      case TypeKind::STRING:
+      case TypeKind::VARCHAR:
+      case TypeKind::CHAR:
+        return texts.count(string(values.chars.data() + values.offsets[row],
+                                  values.offsets[row + 1] -
+                                    values.offsets[row])) > 0;
+      default:
+        return integers.count(values.ints[row]) > 0;
+    }
+  }
+};
+
+class LookupWorker : public AsyncWorker
+{
+public:
+  LookupWorker(Function& cb,
+               Napi::Value self,
+               LookupKeys keys,
+               NorcColumnMetadata meta,
+               ScanOptions scan)
+    : AsyncWorker(cb, "lookup_worker", self.As<Object>())
+    , reader(Reader::Unwrap(self.As<Object>()))
+    , keys(std::move(keys))
+    , meta(std::move(meta))
+    , scan(std::move(scan))
+  {}
+
+protected:
+  void Execute() override
+  {
+    try {
+      reader->LoadStripeStatistics();
+      const orc::Reader& file = *reader->reader;
+      vector<pair<uint64_t, uint64_t>> spans = CandidateRows(file);
+      unique_ptr<RowReader> row =
+        file.createRowReader(scan.ToRowReaderOptions());
+      unique_ptr<ColumnVectorBatch> batch =
+        row->createRowBatch(std::max<uint64_t>(1, file.getRowIndexStride()));
+      RowBuffer decoded(row->getSelectedType());
+      rows = make_unique<RowBuffer>(row->getSelectedType());
+      size_t key = 0;
+      while (decoded.columns[key].title != meta.title) {
+        key++;
+      }
+      for (auto& span : spans) {
+        row->seekToRow(span.first);
+        uint64_t remaining = span.second - span.first;
+        while (remaining > 0 && row->next(*batch)) {
+          if (batch->numElements > remaining) {
+            TruncateBatch(*batch, remaining);
+          }
+          remaining -= batch->numElements;
+          decoded.Clear();
+          decoded.Append(*batch);
+          for (uint64_t i = 0; i < decoded.Size(); i++) {
+            if (keys.Matches(decoded.columns[key], i)) {
+              rows->AppendFrom(decoded, i);
+            }
+          }
+        }
+      }
+    } catch (std::exception& ex) {
+      SetError(ex.what());
+    }
+  }
+  void OnOK() override
+  {
+    Callback().Call({ Env().Null(), rows->ToArray(Env()) });
+  }
+
+private:
+  Reader* reader;
+  LookupKeys keys;
+  NorcColumnMetadata meta;
+  ScanOptions scan;
+  unique_ptr<RowBuffer> rows;
+
+  /**
+   * Row ranges [first, end) of the row groups that may hold a key. The bloom
+   * filters of the key column are used when the file has them, otherwise the
+   * minimum and maximum of each row group.
+   */
+  vector<pair<uint64_t, uint64_t>> CandidateRows(const orc::Reader& file)
+  {
+    vector<pair<uint64_t, uint64_t>> spans;
+    const uint64_t stride = file.getRowIndexStride();
+    auto add = [&](uint64_t first, uint64_t end) {
+      if (!spans.empty() && spans.back().second == first) {
+        spans.back().second = end;
+      } else {
+        spans.emplace_back(first, end);
+      }
+    };
+    uint64_t firstRow = 0;
+    for (uint64_t i = 0; i < file.getNumberOfStripes(); i++) {
+      const uint64_t rows = file.getStripe(i)->getNumberOfRows();
+      if (stride == 0) {
+        // no row index, every stripe is a candidate as a whole
+        add(firstRow, firstRow + rows);
+        firstRow += rows;
+        continue;
+      }
+      const uint64_t groups = (rows + stride - 1) / stride;
+      vector<bool> candidates(groups, true);
+      auto blooms = file.getBloomFilters(static_cast<uint32_t>(i),
+                                         { meta.columnId });
+      auto bloom = blooms.find(meta.columnId);
+      if (bloom != blooms.end() && bloom->second.entries.size() == groups) {
+        for (uint64_t g = 0; g < groups; g++) {
+          auto& filter = bloom->second.entries[g];
+          candidates[g] = filter == nullptr || keys.MayContain(*filter);
+        }
+      } else {
+        unique_ptr<StripeStatistics> stats = file.getStripeStatistics(i);
+        if (stats->getNumberOfRowIndexStats(meta.columnId) == groups) {
+          for (uint64_t g = 0; g < groups; g++) {
+            candidates[g] = keys.MayContain(ColumnSummary::From(
+              *stats->getRowIndexStatistics(meta.columnId,
+                                            static_cast<uint32_t>(g)),
+              meta));
+          }
+        }
+      }
+      for (uint64_t g = 0; g < groups; g++) {
+        if (candidates[g]) {
+          add(firstRow + g * stride,
+              firstRow + std::min(rows, (g + 1) * stride));
+        }
+      }
+      firstRow += rows;
+    }
+    return spans;
+  }
+};
+
+void
+Reader::Lookup(const CallbackInfo& info)
+{
+  AssertCallbackInfo(info,
+                     { { 0, { option(napi_string) } },
+                       { 1, { option(napi_object) } },
+                       { 2, { option(napi_object) } },
+                       { 3, { option(napi_function) } } });
+  if (info.Env().IsExceptionPending()) {
+    return;
+  }
+  string column = info[0].As<String>();
+  auto options = info[2].As<Object>();
+  auto cb = info[3].As<Function>();
+  // the keys are parsed as {[column]: {in: values}}, which validates them
+  // against the type of the column
+  auto in = Object::New(info.Env());
+  in.Set("in", info[1]);
+  auto where = Object::New(info.Env());
+  where.Set(column, in);
+  Predicate predicate;
+  if (!Predicate::Parse(info.Env(), where, reader->getType(), predicate)) {
+    return;
+  }
+  const Predicate& leaf = predicate.children[0];
+  ScanOptions scan;
+  if (options.Has("columns")) {
+    if (!ResolveColumns(
+          info.Env(), options.Get("columns").As<Array>(), scan.includes)) {
+      return;
+    }
+    // the key column is always decoded to compare it against the keys
+    if (std::find(scan.includes.begin(), scan.includes.end(), leaf.field) ==
+        scan.includes.end()) {
+      scan.includes.emplace_back(leaf.field);
+    }
+  }
+  auto worker = new LookupWorker(
+    cb, info.This(), LookupKeys(leaf), fileMeta[leaf.field], std::move(scan));
+  worker->Queue();
+}
+}
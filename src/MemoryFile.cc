@@ -3,6 +3,13 @@
 //
 
 #include "MemoryFile.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <orc/Exceptions.hh>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using std::cout;
 using std::endl;
@@ -42,11 +49,16 @@ void
 MemoryWriter::close()
 {}
 
+// orc's default compression block size, used until the file tail is read
+static const uint64_t DEFAULT_READ_SIZE = 256 * 1024;
+// header preceding every compressed block
+static const uint64_t COMPRESSION_HEADER_SIZE = 3;
+
 MemoryReader::MemoryReader(const char* buffer, size_t size)
   : buffer(buffer)
   , size(size)
   , name("MemoryReader")
-  , naturalSize(1024)
+  , naturalSize(DEFAULT_READ_SIZE)
 {}
 MemoryReader::~MemoryReader() = default;
 void
@@ -54,4 +66,124 @@ MemoryReader::read(void *buf, uint64_t length, uint64_t offset)
 {
   memcpy(buf, buffer + offset, length);
 }
-}
\ No newline at end of file
+
+unique_ptr<orc::Reader>
+OpenMemoryReader(const char* data, size_t length, orc::ReaderOptions& options)
+{
+  auto input = new MemoryReader(data, length);
+  unique_ptr<orc::Reader> reader =
+    orc::createReader(unique_ptr<orc::InputStream>(input), options);
+  // a stream is read in chunks of the natural read size, reading whole
+  // compression blocks hands each one to the decompressor in a single read
+  if (reader->getCompression() != orc::CompressionKind_NONE) {
+    input->setNaturalReadSize(reader->getCompressionSize() +
+                              COMPRESSION_HEADER_SIZE);
+  }
+  return reader;
+}
+
+// read ahead window hinted by MmapReader::read
+static const uint64_t PREFETCH_SIZE = 8 * 1024 * 1024;
+
+MmapReader::MmapReader(string path, int fd, const char* data, uint64_t size)
+  : fd(fd)
+  , data(data)
+  , size(size)
+  , naturalSize(DEFAULT_READ_SIZE)
+  , name(std::move(path))
+  , prefetched(0)
+{}
+MmapReader::~MmapReader()
+{
+  munmap(const_cast<char*>(data), size);
+  close(fd);
+}
+void
+MmapReader::read(void* buf, uint64_t length, uint64_t offset)
+{
+  if (offset > size || length > size - offset) {
+    throw orc::ParseError("Read past the end of " + name);
+  }
+  struct stat st
+  {};
+  if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) != size) {
+    ReadFile(buf, length, offset);
+    return;
+  }
+  const uint64_t end = offset + length;
+  uint64_t hinted = prefetched.load(std::memory_order_relaxed);
+  if (end + PREFETCH_SIZE / 2 > hinted &&
+      prefetched.compare_exchange_strong(hinted, end + PREFETCH_SIZE)) {
+    Prefetch(end, PREFETCH_SIZE);
+  }
+  memcpy(buf, data + offset, length);
+}
+void
+MmapReader::ReadFile(void* buf, uint64_t length, uint64_t offset)
+{
+  char* out = static_cast<char*>(buf);
+  while (length > 0) {
+    const ssize_t n = pread(fd, out, length, static_cast<off_t>(offset));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      throw orc::ParseError(name + " changed while it was read");
+    }
+    out += n;
+    length -= static_cast<uint64_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+}
+void
+MmapReader::Prefetch(uint64_t offset, uint64_t length) const
+{
+  if (offset >= size) {
+    return;
+  }
+  // madvise needs a page aligned address
+  static const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  const uint64_t aligned = offset - offset % page;
+  length = std::min(length + offset - aligned, size - aligned);
+  char* start = const_cast<char*>(data) + aligned;
+  madvise(start, length, MADV_SEQUENTIAL);
+  madvise(start, length, MADV_WILLNEED);
+}
+
+unique_ptr<orc::InputStream>
+OpenInputFile(const string& path, struct stat* opened)
+{
+  if (opened) {
+    *opened = {};
+  }
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    // let orc report the failure
+    return orc::readFile(path);
+  }
+  struct stat st
+  {};
+  void* mapped = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    mapped = mmap(nullptr,
+                  static_cast<size_t>(st.st_size),
+                  PROT_READ,
+                  MAP_PRIVATE,
+                  fd,
+                  0);
+  }
+  if (mapped == MAP_FAILED) {
+    close(fd);
+    return orc::readFile(path);
+  }
+  if (opened) {
+    *opened = st;
+  }
+  // the descriptor stays open, MmapReader checks the size of the file on it
+  return unique_ptr<orc::InputStream>(
+    new MmapReader(path,
+                   fd,
+                   static_cast<const char*>(mapped),
+                   static_cast<uint64_t>(st.st_size)));
+}
+}
@@ -5,10 +5,14 @@
 #ifndef NORC_MEMORYFILE_H
 #define NORC_MEMORYFILE_H
 
+#include <atomic>
+#include <memory>
 #include <napi.h>
 #include <orc/OrcFile.hh>
+#include <sys/stat.h>
 
 using std::string;
+using std::unique_ptr;
 
 namespace norc {
 
@@ -44,6 +48,7 @@ public:
   void read(void* buf, uint64_t length, uint64_t offset) override;
   const std::string& getName() const override { return name; }
   const char* getData() const { return buffer; }
+  void setNaturalReadSize(uint64_t value) { naturalSize = value; }
 
 private:
   const char* buffer;
@@ -51,6 +56,63 @@ private:
   std::string name;
 };
 
+/**
+ * InputStream over a read only memory mapping of a local file. Reads are a
+ * memcpy out of the page cache, the only syscall per read is an fstat. Each
+ * read advises the window following it MADV_SEQUENTIAL and MADV_WILLNEED, so
+ * the next stripe is paged in while the current one is decoded. Opens that
+ * only read the file tail leave the rest of the mapping unadvised.
+ *
+ * Touching pages of a mapping past the end of a truncated file raises
+ * SIGBUS, so each read first checks the size of the file it keeps open and
+ * reads with pread once it changed, failing with a ParseError when the bytes
+ * are gone. A file truncated during a read can still bring the process down,
+ * files must not be modified in place while they are read.
+ */
+class MmapReader : public orc::InputStream
+{
+public:
+  MmapReader(string path, int fd, const char* data, uint64_t size);
+  ~MmapReader() override;
+  uint64_t getLength() const override { return size; }
+  uint64_t getNaturalReadSize() const override { return naturalSize; }
+  void read(void* buf, uint64_t length, uint64_t offset) override;
+  const std::string& getName() const override { return name; }
+  /**
+   * Ask the kernel to page in a range, read sequentially, ahead of reading
+   * it.
+   */
+  void Prefetch(uint64_t offset, uint64_t length) const;
+
+private:
+  void ReadFile(void* buf, uint64_t length, uint64_t offset);
+
+  int fd;
+  const char* data;
+  uint64_t size;
+  uint64_t naturalSize;
+  string name;
+  // end of the range last passed to Prefetch by read
+  std::atomic<uint64_t> prefetched;
+};
+
+/**
+ * Create an orc::Reader over memory owned by the caller, which must outlive
+ * the reader and every row reader created from it. The memory is read in
+ * place, stream reads are sized to whole compression blocks.
+ */
+unique_ptr<orc::Reader>
+OpenMemoryReader(const char* data, size_t length, orc::ReaderOptions&);
+
+/**
+ * Open a local file for reading, memory mapped when possible. Files that
+ * cannot be mapped (empty files, pipes, ...) fall back to orc::readFile.
+ * opened, when given, receives the fstat of the mapped file, and is zeroed
+ * when the file was not mapped.
+ */
+unique_ptr<orc::InputStream>
+OpenInputFile(const string& path, struct stat* opened = nullptr);
+
 }
 
 #endif // NORC_MEMORYFILE_H
@@ -0,0 +1,516 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Predicate.h"
+#include "Internal.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace Napi;
+using namespace orc;
+
+using std::move;
+using std::runtime_error;
+
+namespace norc {
+
+/**
+ * Raised while parsing a where object, rethrown as a JS exception by
+ * Predicate::Parse.
+ */
+class PredicateError : public runtime_error
+{
+public:
+  explicit PredicateError(const string& message)
+    : runtime_error(message)
+  {}
+};
+
+static PredicateLiteral
+ParseLiteral(const Napi::Value& value, const Predicate& leaf, const Type& type)
+{
+  PredicateLiteral out;
+  bool valid = false;
+  switch (leaf.kind) {
+    case TypeKind::BOOLEAN:
+      if (value.IsBoolean()) {
+        out.integer = value.As<Boolean>().Value() ? 1 : 0;
+        valid = true;
+      }
+      break;
+    case TypeKind::BYTE:
+    case TypeKind::SHORT:
+    case TypeKind::INT:
+    case TypeKind::LONG:
+      if (value.IsNumber()) {
+        double number = value.As<Number>().DoubleValue();
+        out.integer = static_cast<int64_t>(number);
+        valid = std::trunc(number) == number;
+      } else if (value.IsBigInt()) {
+        out.integer = value.As<BigInt>().Int64Value(&valid);
+      }
+      break;
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+    case TypeKind::DECIMAL:
+      if (value.IsNumber()) {
+        out.real = value.As<Number>().DoubleValue();
+        valid = true;
+      }
+      break;
+    case TypeKind::DATE:
+      valid = value.IsString() &&
+              ParseDate(value.As<String>().Utf8Value(), out.integer);
+      break;
+    case TypeKind::TIMESTAMP:
+      valid =
+        value.IsString() &&
+        ParseTimestamp(value.As<String>().Utf8Value(), out.integer, out.nanos);
+      break;
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR:
+      if (value.IsString()) {
+        out.text = value.As<String>().Utf8Value();
+        valid = true;
+      }
+      break;
+    default:
+      break;
+  }
+  if (!valid) {
+    throw PredicateError("Invalid value in where for column " + leaf.column +
+                         " of type " + type.toString());
+  }
+  return out;
+}
+static vector<PredicateLiteral>
+ParseLiterals(const Napi::Value& value,
+              const Predicate& leaf,
+              const Type& type,
+              const string& op)
+{
+  if (!value.IsArray() || value.As<Array>().Length() == 0) {
+    throw PredicateError(op + " on column " + leaf.column +
+                         " must be a non empty array");
+  }
+  auto values = value.As<Array>();
+  vector<PredicateLiteral> out;
+  for (uint32_t i = 0; i < values.Length(); i++) {
+    out.emplace_back(ParseLiteral(values.Get(i), leaf, type));
+  }
+  return out;
+}
+static void
+ParseColumn(const string& column,
+            const Napi::Value& value,
+            const Type& schema,
+            vector<Predicate>& out)
+{
+  Predicate leaf;
+  leaf.column = column;
+  const Type* type = nullptr;
+  for (uint64_t i = 0; i < schema.getSubtypeCount(); i++) {
+    if (schema.getFieldName(i) == column) {
+      leaf.field = i;
+      type = schema.getSubtype(i);
+      break;
+    }
+  }
+  if (type == nullptr) {
+    throw PredicateError(column + " not a valid column header");
+  }
+  leaf.kind = type->getKind();
+  switch (leaf.kind) {
+    case TypeKind::BINARY:
+    case TypeKind::LIST:
+    case TypeKind::MAP:
+    case TypeKind::STRUCT:
+    case TypeKind::UNION:
+      throw PredicateError("Column " + column + " of type " + type->toString() +
+                           " cannot be used in where");
+    case TypeKind::DECIMAL:
+      leaf.precision = type->getPrecision();
+      leaf.scale = type->getScale();
+      break;
+    default:
+      break;
+  }
+  auto comparison = [&](Predicate::Op op) {
+    Predicate p = leaf;
+    p.op = op;
+    return p;
+  };
+  if (value.IsNull()) {
+    out.emplace_back(comparison(Predicate::IS_NULL));
+    return;
+  }
+  if (!value.IsObject() || value.IsArray()) {
+    Predicate eq = comparison(Predicate::EQ);
+    eq.literals.emplace_back(ParseLiteral(value, leaf, *type));
+    out.emplace_back(move(eq));
+    return;
+  }
+  auto ops = value.As<Object>();
+  auto names = ops.GetPropertyNames();
+  if (names.Length() == 0) {
+    throw PredicateError("No operator in where for column " + column);
+  }
+  static const vector<std::pair<string, Predicate::Op>> single = {
+    { "eq", Predicate::EQ },   { "ne", Predicate::NE },
+    { "lt", Predicate::LT },   { "lte", Predicate::LTE },
+    { "gt", Predicate::GT },   { "gte", Predicate::GTE }
+  };
+  for (uint32_t i = 0; i < names.Length(); i++) {
+    string name = names.Get(i).As<String>();
+    Napi::Value operand = ops.Get(name);
+    bool matched = false;
+    for (auto& entry : single) {
+      if (entry.first == name) {
+        Predicate p = comparison(entry.second);
+        p.literals.emplace_back(ParseLiteral(operand, leaf, *type));
+        out.emplace_back(move(p));
+        matched = true;
+        break;
+      }
+    }
+    if (matched) {
+      continue;
+    }
+    if (name == "in") {
+      Predicate p = comparison(Predicate::IN);
+      p.literals = ParseLiterals(operand, leaf, *type, name);
+      out.emplace_back(move(p));
+    } else if (name == "between") {
+      Predicate p = comparison(Predicate::BETWEEN);
+      p.literals = ParseLiterals(operand, leaf, *type, name);
+      if (p.literals.size() != 2) {
+        throw PredicateError("between on column " + column +
+                             " must be an array of [lower, upper]");
+      }
+      out.emplace_back(move(p));
+    } else if (name == "isNull") {
+      if (!operand.IsBoolean()) {
+        throw PredicateError("isNull on column " + column +
+                             " must be a boolean");
+      }
+      if (operand.As<Boolean>().Value()) {
+        out.emplace_back(comparison(Predicate::IS_NULL));
+      } else {
+        Predicate p;
+        p.op = Predicate::NOT;
+        p.children.emplace_back(comparison(Predicate::IS_NULL));
+        out.emplace_back(move(p));
+      }
+    } else {
+      throw PredicateError("Unknown operator " + name +
+                           " in where for column " + column);
+    }
+  }
+}
+static void
+ParseWhere(const Napi::Value& where, const Type& schema, Predicate& out)
+{
+  if (!where.IsObject() || where.IsArray()) {
+    throw PredicateError("where must be an object");
+  }
+  out.op = Predicate::AND;
+  auto conditions = where.As<Object>();
+  auto names = conditions.GetPropertyNames();
+  for (uint32_t i = 0; i < names.Length(); i++) {
+    string name = names.Get(i).As<String>();
+    Napi::Value value = conditions.Get(name);
+    if (name == "$and" || name == "$or") {
+      if (!value.IsArray() || value.As<Array>().Length() == 0) {
+        throw PredicateError(name + " must be a non empty array");
+      }
+      auto operands = value.As<Array>();
+      Predicate group;
+      group.op = name == "$and" ? Predicate::AND : Predicate::OR;
+      for (uint32_t j = 0; j < operands.Length(); j++) {
+        Predicate child;
+        ParseWhere(operands.Get(j), schema, child);
+        group.children.emplace_back(move(child));
+      }
+      out.children.emplace_back(move(group));
+    } else if (name == "$not") {
+      Predicate negate;
+      negate.op = Predicate::NOT;
+      negate.children.emplace_back();
+      ParseWhere(value, schema, negate.children.back());
+      out.children.emplace_back(move(negate));
+    } else if (!name.empty() && name[0] == '$') {
+      throw PredicateError("Unknown operator " + name + " in where");
+    } else {
+      ParseColumn(name, value, schema, out.children);
+    }
+  }
+}
+/**
+ * Nested connectives must have operands, orc rejects an AND, OR or NOT without
+ * children.
+ */
+static bool
+Complete(const Predicate& p)
+{
+  if (p.IsLeaf()) {
+    return true;
+  }
+  if (p.children.empty()) {
+    return false;
+  }
+  for (auto& child : p.children) {
+    if (!Complete(child)) {
+      return false;
+    }
+  }
+  return true;
+}
+bool
+Predicate::Parse(const Napi::Env& env,
+                 const Napi::Value& where,
+                 const Type& schema,
+                 Predicate& out)
+{
+  try {
+    ParseWhere(where, schema, out);
+  } catch (PredicateError& ex) {
+    Error::New(env, ex.what()).ThrowAsJavaScriptException();
+    return false;
+  }
+  if (!out.children.empty() && !Complete(out)) {
+    Error::New(env, "where contains an empty condition")
+      .ThrowAsJavaScriptException();
+    return false;
+  }
+  return true;
+}
+
+static PredicateDataType
+DataType(TypeKind kind)
+{
+  switch (kind) {
+    case TypeKind::BOOLEAN:
+      return PredicateDataType::BOOLEAN;
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+      return PredicateDataType::FLOAT;
+    case TypeKind::DECIMAL:
+      return PredicateDataType::DECIMAL;
+    case TypeKind::DATE:
+      return PredicateDataType::DATE;
+    case TypeKind::TIMESTAMP:
+      return PredicateDataType::TIMESTAMP;
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR:
+      return PredicateDataType::STRING;
+    default:
+      return PredicateDataType::LONG;
+  }
+}
+/**
+ * The unscaled values of a DECIMAL column that Filter reads as the literal,
+ * value / 10^scale as a double: lower is the least one read as >= the
+ * literal, upper the greatest read as <= it. False when the scaled literal is
+ * past the integers a double holds exactly, the leaf is then left to Filter.
+ */
+static bool
+DecimalBounds(const Predicate& leaf,
+              double real,
+              int64_t& lower,
+              int64_t& upper)
+{
+  const double divisor = std::pow(10.0, static_cast<double>(leaf.scale));
+  const double scaled = real * divisor;
+  if (!std::isfinite(scaled) || std::fabs(scaled) >= 9007199254740992.0) {
+    return false;
+  }
+  // the product is off by an ulp at most, step to the exact bounds
+  lower = static_cast<int64_t>(std::ceil(scaled));
+  while (static_cast<double>(lower) / divisor < real) {
+    lower++;
+  }
+  while (static_cast<double>(lower - 1) / divisor >= real) {
+    lower--;
+  }
+  upper = static_cast<int64_t>(std::floor(scaled));
+  while (static_cast<double>(upper) / divisor > real) {
+    upper--;
+  }
+  while (static_cast<double>(upper + 1) / divisor <= real) {
+    upper++;
+  }
+  return true;
+}
+/**
+ * Whether orc can prune on the leaf without dropping a row Filter keeps: a
+ * DECIMAL literal must have exact bounds, and one of eq, ne or in must be
+ * read as a single unscaled value.
+ */
+static bool
+Pushable(const Predicate& leaf)
+{
+  if (leaf.kind != TypeKind::DECIMAL) {
+    return true;
+  }
+  const bool exact = leaf.op == Predicate::EQ || leaf.op == Predicate::NE ||
+                     leaf.op == Predicate::IN;
+  for (auto& literal : leaf.literals) {
+    int64_t lower, upper;
+    if (!DecimalBounds(leaf, literal.real, lower, upper) ||
+        (exact && lower != upper)) {
+      return false;
+    }
+  }
+  return true;
+}
+/**
+ * The literal of a leaf as orc compares it. A DECIMAL literal is rounded
+ * toward the rows that may match, up when it bounds the values from below
+ * (lt, gte, the start of between) and down when it bounds them from above.
+ */
+static Literal
+ToLiteral(const Predicate& leaf, const PredicateLiteral& value, bool up = true)
+{
+  switch (leaf.kind) {
+    case TypeKind::BOOLEAN:
+      return Literal(value.integer != 0);
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+      return Literal(leaf.Real(value));
+    case TypeKind::DECIMAL: {
+      int64_t lower = 0, upper = 0;
+      DecimalBounds(leaf, value.real, lower, upper);
+      return Literal(Int128(up ? lower : upper),
+                     static_cast<int32_t>(leaf.precision),
+                     static_cast<int32_t>(leaf.scale));
+    }
+    case TypeKind::DATE:
+      return Literal(PredicateDataType::DATE, value.integer);
+    case TypeKind::TIMESTAMP:
+      return Literal(value.integer, static_cast<int32_t>(value.nanos));
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR:
+      return Literal(value.text.c_str(), value.text.size());
+    default:
+      return Literal(value.integer);
+  }
+}
+static void
+Build(SearchArgumentBuilder& builder, const Predicate& p)
+{
+  // the builder only has =, <, <=, in, between and is null, the remaining
+  // comparisons are expressed through NOT
+  const PredicateDataType type = DataType(p.kind);
+  if (p.IsLeaf() && !Pushable(p)) {
+    builder.literal(TruthValue::YES_NO_NULL);
+    return;
+  }
+  switch (p.op) {
+    case Predicate::AND:
+    case Predicate::OR:
+    case Predicate::NOT:
+      if (p.op == Predicate::AND) {
+        builder.startAnd();
+      } else if (p.op == Predicate::OR) {
+        builder.startOr();
+      } else {
+        builder.startNot();
+      }
+      for (auto& child : p.children) {
+        Build(builder, child);
+      }
+      builder.end();
+      break;
+    case Predicate::EQ:
+      builder.equals(p.column, type, ToLiteral(p, p.literals[0]));
+      break;
+    case Predicate::NE:
+      builder.startNot()
+        .equals(p.column, type, ToLiteral(p, p.literals[0]))
+        .end();
+      break;
+    case Predicate::LT:
+      builder.lessThan(p.column, type, ToLiteral(p, p.literals[0]));
+      break;
+    case Predicate::LTE:
+      builder.lessThanEquals(
+        p.column, type, ToLiteral(p, p.literals[0], false));
+      break;
+    case Predicate::GT:
+      builder.startNot()
+        .lessThanEquals(p.column, type, ToLiteral(p, p.literals[0], false))
+        .end();
+      break;
+    case Predicate::GTE:
+      builder.startNot()
+        .lessThan(p.column, type, ToLiteral(p, p.literals[0]))
+        .end();
+      break;
+    case Predicate::IN: {
+      vector<Literal> literals;
+      literals.reserve(p.literals.size());
+      for (auto& literal : p.literals) {
+        literals.emplace_back(ToLiteral(p, literal));
+      }
+      builder.in(p.column, type, literals);
+      break;
+    }
+    case Predicate::BETWEEN:
+      builder.between(p.column,
+                      type,
+                      ToLiteral(p, p.literals[0]),
+                      ToLiteral(p, p.literals[1], false));
+      break;
+    case Predicate::IS_NULL:
+      builder.isNull(p.column, type);
+      break;
+  }
+}
+unique_ptr<SearchArgument>
+Predicate::ToSearchArgument() const
+{
+  auto builder = SearchArgumentFactory::newBuilder();
+  Build(*builder, *this);
+  return builder->build();
+}
+double
+Predicate::Real(const PredicateLiteral& literal) const
+{
+  if (kind == TypeKind::FLOAT) {
+    return static_cast<double>(static_cast<float>(literal.real));
+  }
+  return literal.real;
+}
+void
+Predicate::CollectFields(std::list<uint64_t>& fields) const
+{
+  if (IsLeaf()) {
+    if (std::find(fields.begin(), fields.end(), field) == fields.end()) {
+      fields.emplace_back(field);
+    }
+    return;
+  }
+  for (auto& child : children) {
+    child.CollectFields(fields);
+  }
+}
+}
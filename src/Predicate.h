@@ -0,0 +1,122 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NORC_PREDICATE_H
+#define NORC_PREDICATE_H
+
+#include <list>
+#include <memory>
+#include <napi.h>
+#include <orc/OrcFile.hh>
+#include <orc/sargs/SearchArgument.hh>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace norc {
+
+/**
+ * A literal of a predicate, converted to the representation of the column it
+ * is compared against.
+ *  - BOOLEAN, BYTE, SHORT, INT, LONG, DATE (days since epoch): integer
+ *  - FLOAT, DOUBLE, DECIMAL: real
+ *  - TIMESTAMP: integer (seconds) and nanos
+ *  - STRING, VARCHAR, CHAR: text
+ */
+struct PredicateLiteral
+{
+  int64_t integer = 0;
+  int64_t nanos = 0;
+  double real = 0;
+  string text;
+};
+
+/**
+ * The `where` read option parsed against the file schema, a tree of boolean
+ * connectives (AND, OR, NOT) over comparisons of a single top level column.
+ *
+ * where  := { [column]: literal | null | ops, $and?: where[], $or?: where[],
+ *             $not?: where }
+ * ops    := { eq?, ne?, lt?, lte?, gt?, gte?, in?: literal[],
+ *             between?: [literal, literal], isNull?: boolean }
+ *
+ * Sibling keys are combined with AND, a literal is shorthand for {eq} and null
+ * for {isNull: true}.
+ */
+struct Predicate
+{
+  enum Op
+  {
+    AND,
+    OR,
+    NOT,
+    EQ,
+    NE,
+    LT,
+    LTE,
+    GT,
+    GTE,
+    IN,
+    BETWEEN,
+    IS_NULL
+  };
+  Op op = AND;
+  // column of a comparison
+  string column;
+  uint64_t field = 0;
+  orc::TypeKind kind = orc::TypeKind::INT;
+  uint64_t precision = 0;
+  uint64_t scale = 0;
+  vector<PredicateLiteral> literals;
+  // operands of AND, OR, NOT
+  vector<Predicate> children;
+
+  /**
+   * Parse a `where` object against the fields of the file schema. Throws a JS
+   * exception and returns false on unknown columns, operators or literals of
+   * the wrong type.
+   */
+  static bool Parse(const Napi::Env&,
+                    const Napi::Value& where,
+                    const orc::Type& schema,
+                    Predicate& out);
+  /**
+   * An orc SearchArgument for the predicate. The reader evaluates it against
+   * stripe statistics and the row index, stripes and row groups of 10,000 rows
+   * that cannot match are never decoded. The search argument does not filter
+   * individual rows, Filter evaluates the predicate on the remaining ones.
+   */
+  unique_ptr<orc::SearchArgument> ToSearchArgument() const;
+  /**
+   * Append the fields compared by the predicate that are not in the list yet.
+   */
+  void CollectFields(std::list<uint64_t>& fields) const;
+  /**
+   * A number literal as the column stores it: orc widens FLOAT values to
+   * double, so a FLOAT literal is narrowed to float first and 0.1 compares as
+   * 0.10000000149011612.
+   */
+  double Real(const PredicateLiteral& literal) const;
+  bool IsLeaf() const { return op != AND && op != OR && op != NOT; }
+};
+}
+
+#endif // NORC_PREDICATE_H
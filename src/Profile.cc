@@ -0,0 +1,381 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "HashTable.h"
+#include "Internal.h"
+#include "Reader.h"
+#include "Sketch.h"
+#include "StripeScan.h"
+#include "ValidateArguments.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+using namespace Napi;
+using namespace orc;
+
+using std::numeric_limits;
+
+namespace norc {
+
+/**
+ * Data quality figures of one column: the null ratio, an approximate distinct
+ * count, approximate quantiles of numbers and dates, and the lengths of
+ * strings. Every figure is built in a single pass over the decoded batches.
+ */
+struct ColumnProfile
+{
+  ColumnProfile(string title, TypeKind kind)
+    : title(std::move(title))
+    , kind(kind)
+  {}
+  static bool HasQuantiles(TypeKind kind)
+  {
+    switch (kind) {
+      case TypeKind::BYTE:
+      case TypeKind::SHORT:
+      case TypeKind::INT:
+      case TypeKind::LONG:
+      case TypeKind::FLOAT:
+      case TypeKind::DOUBLE:
+      case TypeKind::DECIMAL:
+      case TypeKind::DATE:
+        return true;
+      default:
+        return false;
+    }
+  }
+  static bool IsString(TypeKind kind)
+  {
+    return kind == TypeKind::STRING || kind == TypeKind::VARCHAR ||
+           kind == TypeKind::CHAR || kind == TypeKind::BINARY;
+  }
+  /**
+   * Whether the values are hashed into the distinct count, compound columns
+   * only count their nulls.
+   */
+  static bool HasDistinct(TypeKind kind)
+  {
+    return HasQuantiles(kind) || IsString(kind) ||
+           kind == TypeKind::BOOLEAN || kind == TypeKind::TIMESTAMP;
+  }
+  /**
+   * Add rows[i] of the batch for i in [0, n).
+   */
+  void Add(const ColumnVectorBatch& batch, const uint32_t* rows, uint64_t n)
+  {
+    const char* present = batch.hasNulls ? batch.notNull.data() : nullptr;
+    this->rows += n;
+    if (present) {
+      for (uint64_t i = 0; i < n; i++) {
+        nulls += !present[rows[i]];
+      }
+    }
+    auto each = [&](auto add) {
+      for (uint64_t i = 0; i < n; i++) {
+        if (!present || present[rows[i]]) {
+          add(rows[i]);
+        }
+      }
+    };
+    switch (kind) {
+      case TypeKind::BOOLEAN:
+      case TypeKind::BYTE:
+      case TypeKind::SHORT:
+      case TypeKind::INT:
+      case TypeKind::LONG:
+      case TypeKind::DATE: {
+        const int64_t* data =
+          dynamic_cast<const LongVectorBatch&>(batch).data.data();
+        const bool quantiles = HasQuantiles(kind);
+        each([&](uint64_t row) {
+          distinct.Add(HashCombine(0, static_cast<uint64_t>(data[row])));
+          if (quantiles) {
+            values.Add(static_cast<double>(data[row]));
+          }
+        });
+        break;
+      }
+      case TypeKind::FLOAT:
+      case TypeKind::DOUBLE: {
+        const double* data =
+          dynamic_cast<const DoubleVectorBatch&>(batch).data.data();
+        each([&](uint64_t row) {
+          distinct.Add(HashCombine(0, DoubleKey(data[row])));
+          if (!std::isnan(data[row])) {
+            values.Add(data[row]);
+          }
+        });
+        break;
+      }
+      case TypeKind::DECIMAL: {
+        if (auto d64 = dynamic_cast<const Decimal64VectorBatch*>(&batch)) {
+          const double divisor = std::pow(10.0, d64->scale);
+          each([&](uint64_t row) {
+            const int64_t value = d64->values[row];
+            distinct.Add(HashCombine(0, static_cast<uint64_t>(value)));
+            values.Add(static_cast<double>(value) / divisor);
+          });
+        } else {
+          auto& d128 = dynamic_cast<const Decimal128VectorBatch&>(batch);
+          each([&](uint64_t row) {
+            const string text = d128.values[row].toDecimalString(d128.scale);
+            distinct.Add(HashBytes(text.data(), text.size()));
+            values.Add(strtod(text.c_str(), nullptr));
+          });
+        }
+        break;
+      }
+      case TypeKind::TIMESTAMP: {
+        auto& ts = dynamic_cast<const TimestampVectorBatch&>(batch);
+        each([&](uint64_t row) {
+          distinct.Add(HashCombine(
+            HashCombine(0, static_cast<uint64_t>(ts.data[row])),
+            static_cast<uint64_t>(ts.nanoseconds[row])));
+        });
+        break;
+      }
+      case TypeKind::STRING:
+      case TypeKind::VARCHAR:
+      case TypeKind::CHAR:
+      case TypeKind::BINARY: {
+        auto& strings = dynamic_cast<const StringVectorBatch&>(batch);
+        each([&](uint64_t row) {
+          const uint64_t length = static_cast<uint64_t>(strings.length[row]);
+          distinct.Add(HashBytes(strings.data[row], length));
+          minLength = std::min(minLength, length);
+          maxLength = std::max(maxLength, length);
+          totalLength += length;
+        });
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  void Merge(const ColumnProfile& other)
+  {
+    rows += other.rows;
+    nulls += other.nulls;
+    distinct.Merge(other.distinct);
+    values.Merge(other.values);
+    minLength = std::min(minLength, other.minLength);
+    maxLength = std::max(maxLength, other.maxLength);
+    totalLength += other.totalLength;
+  }
+  /**
+   * {nulls, nullRatio, distinct, quantiles, minLength, maxLength, avgLength},
+   * quantiles only for numbers and dates, lengths only for strings.
+   */
+  Napi::Object ToObject(Napi::Env env, const vector<double>& ranks) const
+  {
+    auto out = Object::New(env);
+    out.Set("nulls", static_cast<double>(nulls));
+    out.Set("nullRatio",
+            rows == 0 ? env.Null()
+                      : Number::New(env,
+                                    static_cast<double>(nulls) /
+                                      static_cast<double>(rows)));
+    const uint64_t count = rows - nulls;
+    if (HasDistinct(kind)) {
+      // the estimate can never be more than the number of values
+      const double estimate = std::round(distinct.Estimate());
+      out.Set("distinct", std::min(estimate, static_cast<double>(count)));
+    }
+    if (HasQuantiles(kind)) {
+      if (values.Count() == 0) {
+        out.Set("quantiles", env.Null());
+      } else {
+        auto quantiles = Array::New(env, ranks.size());
+        for (uint32_t i = 0; i < ranks.size(); i++) {
+          const double value = values.Quantile(ranks[i]);
+          if (kind == TypeKind::DATE) {
+            quantiles.Set(
+              i, String::New(env, FormatDate(static_cast<int64_t>(value))));
+          } else if (kind == TypeKind::FLOAT) {
+            quantiles.Set(i, Number::New(env, RoundFloat(value)));
+          } else {
+            quantiles.Set(i, Number::New(env, value));
+          }
+        }
+        out.Set("quantiles", quantiles);
+      }
+    }
+    if (IsString(kind)) {
+      const bool empty = count == 0;
+      out.Set("minLength",
+              empty ? env.Null()
+                    : Number::New(env, static_cast<double>(minLength)));
+      out.Set("maxLength",
+              empty ? env.Null()
+                    : Number::New(env, static_cast<double>(maxLength)));
+      out.Set("avgLength",
+              empty ? env.Null()
+                    : Number::New(env,
+                                  static_cast<double>(totalLength) /
+                                    static_cast<double>(count)));
+    }
+    return out;
+  }
+
+  string title;
+  TypeKind kind;
+  uint64_t rows = 0;
+  uint64_t nulls = 0;
+  HyperLogLog distinct;
+  KllSketch values;
+  uint64_t minLength = numeric_limits<uint64_t>::max();
+  uint64_t maxLength = 0;
+  uint64_t totalLength = 0;
+};
+
+class ProfileWorker : public AsyncWorker
+{
+public:
+  ProfileWorker(Function& cb,
+                Napi::Value self,
+                vector<double> ranks,
+                ScanOptions scan)
+    : AsyncWorker(cb, "profile_worker", self.As<Object>())
+    , reader(Reader::Unwrap(self.As<Object>()))
+    , ranks(std::move(ranks))
+    , scan(std::move(scan))
+  {}
+
+protected:
+  void Execute() override
+  {
+    try {
+      StripeScan scanner(reader->ScanFile(scan), scan);
+      const orc::Type& selected = scanner.SelectedType();
+      vector<size_t> positions;
+      vector<ColumnProfile> columns;
+      for (uint64_t i = 0; i < selected.getSubtypeCount(); i++) {
+        const string& title = selected.getFieldName(i);
+        if (std::find(scan.hidden.begin(), scan.hidden.end(), title) ==
+            scan.hidden.end()) {
+          positions.emplace_back(i);
+          columns.emplace_back(title, selected.getSubtype(i)->getKind());
+        }
+      }
+      // every range profiles its own rows, the sketches are merged once all
+      // ranges are done
+      struct Partial
+      {
+        vector<ColumnProfile> columns;
+        uint64_t rows = 0;
+        vector<uint32_t> all;
+      };
+      vector<Partial> partials(scanner.Size());
+      for (auto& partial : partials) {
+        partial.columns = columns;
+      }
+      scanner.Run([&](size_t range,
+                      const ColumnVectorBatch& batch,
+                      const Selection* selection) {
+        Partial& partial = partials[range];
+        uint64_t n = batch.numElements;
+        const uint32_t* selected = nullptr;
+        if (selection != nullptr) {
+          n = selection->rows.size();
+          selected = selection->rows.data();
+        } else {
+          while (partial.all.size() < n) {
+            partial.all.emplace_back(
+              static_cast<uint32_t>(partial.all.size()));
+          }
+          selected = partial.all.data();
+        }
+        partial.rows += n;
+        auto& fields = dynamic_cast<const StructVectorBatch&>(batch).fields;
+        for (size_t i = 0; i < positions.size(); i++) {
+          partial.columns[i].Add(*fields[positions[i]], selected, n);
+        }
+      });
+      for (auto& partial : partials) {
+        rows += partial.rows;
+        for (size_t i = 0; i < columns.size(); i++) {
+          columns[i].Merge(partial.columns[i]);
+        }
+      }
+      profiles = std::move(columns);
+    } catch (std::exception& ex) {
+      SetError(ex.what());
+    }
+  }
+  void OnOK() override
+  {
+    auto out = Object::New(Env());
+    out.Set("rows", static_cast<double>(rows));
+    auto columns = Object::New(Env());
+    for (auto& profile : profiles) {
+      columns.Set(profile.title, profile.ToObject(Env(), ranks));
+    }
+    out.Set("columns", columns);
+    Callback().Call({ Env().Null(), out });
+  }
+
+private:
+  Reader* reader;
+  vector<double> ranks;
+  ScanOptions scan;
+  vector<ColumnProfile> profiles;
+  uint64_t rows = 0;
+};
+
+void
+Reader::Profile(const CallbackInfo& info)
+{
+  AssertCallbackInfo(info,
+                     { { 0, { option(napi_object) } },
+                       { 1, { option(napi_function) } } });
+  if (info.Env().IsExceptionPending()) {
+    return;
+  }
+  auto env = info.Env();
+  auto options = info[0].As<Object>();
+  auto cb = info[1].As<Function>();
+  ScanOptions scan;
+  if (!ParseScanOptions(env, options, scan)) {
+    return;
+  }
+  if (scan.offset > 0 || scan.limit != numeric_limits<uint64_t>::max()) {
+    RangeError::New(env, "profile does not support offset and limit")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  vector<double> ranks{ 0, 0.25, 0.5, 0.75, 1 };
+  if (options.Has("quantiles")) {
+    auto quantiles = options.Get("quantiles").As<Array>();
+    ranks.clear();
+    for (uint32_t i = 0; i < quantiles.Length(); i++) {
+      const double rank = quantiles.Get(i).As<Number>().DoubleValue();
+      if (!(rank >= 0 && rank <= 1)) {
+        RangeError::New(env, "quantiles must be between 0 and 1")
+          .ThrowAsJavaScriptException();
+        return;
+      }
+      ranks.emplace_back(rank);
+    }
+  }
+  auto worker =
+    new ProfileWorker(cb, info.This(), std::move(ranks), std::move(scan));
+  worker->Queue();
+}
+}
@@ -17,11 +17,18 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "Reader.h"
+#include "ColumnBuffer.h"
 #include "Internal.h"
 #include "MemoryFile.h"
+#include "Statistics.h"
+#include "StripeScan.h"
+#include "TailCache.h"
 #include "ValidateArguments.h"
 #include <algorithm>
 #include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <orc/ColumnPrinter.hh>
 
 using namespace Napi;
@@ -46,7 +53,20 @@ Reader::Initialize(Napi::Env& env, Napi::Object& target)
     env,
     "Reader",
     { InstanceMethod("read", &Reader::Read),
+      InstanceMethod("readColumns", &Reader::ReadColumns),
+      InstanceMethod("cursor", &Reader::CreateCursor),
+      InstanceMethod("lookup", &Reader::Lookup),
+      InstanceMethod("aggregate", &Reader::Aggregate),
+      InstanceMethod("groupBy", &Reader::GroupBy),
+      InstanceMethod("topK", &Reader::TopK),
+      InstanceMethod("profile", &Reader::Profile),
       InstanceMethod("columnStatistics", &Reader::GetColumnStatistics),
+      InstanceMethod("serializedTail", &Reader::GetSerializedTail),
+      InstanceMethod("statistics", &Reader::Statistics),
+      InstanceMethod("stripes", &Reader::GetStripes),
+      StaticMethod("join", &Reader::Join),
+      StaticMethod("setTailCacheSize", &Reader::SetTailCacheSize),
+      StaticMethod("clearTailCache", &Reader::ClearTailCache),
       InstanceAccessor("writeVersion", &Reader::GetWriterVersion, nullptr),
       InstanceAccessor("formatVersion", &Reader::GetFormatVersion, nullptr),
       InstanceAccessor("compression", &Reader::GetCompression, nullptr),
@@ -60,136 +80,290 @@ Reader::Reader(const CallbackInfo& info)
 {
   string input;
   Buffer<char> buffer;
+  if (info.Length() > 1 && info[1].IsObject()) {
+    Napi::Value tail = info[1].As<Object>().Get("tail");
+    if (tail.IsBuffer()) {
+      buffer = tail.As<Buffer<char>>();
+      readerOptions.setSerializedFileTail(
+        string(buffer.Data(), buffer.Length()));
+    } else if (!tail.IsUndefined() && !tail.IsNull()) {
+      TypeError::New(info.Env(), "tail must be a Buffer")
+        .ThrowAsJavaScriptException();
+      return;
+    }
+  }
   if (info[0].IsString()) {
     input = info[0].As<String>();
-    reader = createReader(readFile(input), readerOptions);
+    // a tail given by the caller takes precedence over the cache
+    const bool provided = !readerOptions.getSerializedFileTail().empty();
+    struct stat opened;
+    unique_ptr<orc::InputStream> stream = OpenInputFile(input, &opened);
+    const string key = provided ? "" : TailCache::Key(input, opened);
+    string tail;
+    const bool cached = !key.empty() && TailCache::Instance().Get(key, tail);
+    if (cached) {
+      readerOptions.setSerializedFileTail(tail);
+    }
+    reader = createReader(std::move(stream), readerOptions);
+    if (!key.empty() && !cached) {
+      TailCache::Instance().Put(key, reader->getSerializedFileTail());
+    }
   }
   if (info[0].IsBuffer()) {
     buffer = info[0].As<Buffer<char>>();
-    unique_ptr<InputStream> inputBuffer(
-      new MemoryReader(buffer.Data(), buffer.Length()));
+    // the file is read in place, the Buffer is pinned for the lifetime of
+    // the reader
+    source = Persistent(info[0].As<Object>());
     readerOptions.setMemoryPool(*getDefaultPool());
-    reader = createReader(std::move(inputBuffer), readerOptions);
+    reader = OpenMemoryReader(buffer.Data(), buffer.Length(), readerOptions);
   }
   for (unsigned int i = 0; i < reader->getType().getSubtypeCount(); i++) {
-    TypeKind columnType = reader->getType().getSubtype(i)->getKind();
+    const Type* columnType = reader->getType().getSubtype(i);
     string columnTitle = reader->getType().getFieldName(i);
-    fileMeta.emplace_back(NorcColumnMetadata{ columnTitle, i, columnType });
+    fileMeta.emplace_back(
+      NorcColumnMetadata{ columnTitle,
+                          i,
+                          columnType->getKind(),
+                          static_cast<uint32_t>(columnType->getColumnId()) });
+  }
+}
+
+/**
+ * Decode the scan into a single RowBuffer. Ranges of a parallel scan are
+ * decoded into their own buffers and concatenated in file order.
+ */
+static unique_ptr<RowBuffer>
+ReadRows(const orc::Reader& reader, const ScanOptions& scan)
+{
+  StripeScan stripes(reader, scan);
+  vector<unique_ptr<RowBuffer>> parts;
+  for (size_t i = 0; i < stripes.Size(); i++) {
+    parts.emplace_back(
+      make_unique<RowBuffer>(stripes.SelectedType(), scan.hidden));
+    if (!scan.where) {
+      parts.back()->Reserve(stripes.Range(i).rows);
+    }
+  }
+  stripes.Run([&](size_t range,
+                  const ColumnVectorBatch& batch,
+                  const Selection* selection) {
+    parts[range]->Append(batch, selection);
+  });
+  for (size_t i = 1; i < parts.size(); i++) {
+    parts[0]->Concat(*parts[i]);
+    parts[i].reset();
   }
+  return std::move(parts[0]);
 }
 
+/**
+ * Prints rows of a struct batch as JSON objects, the way orc::ColumnPrinter
+ * prints a struct, leaving out the hidden columns.
+ */
+class RowPrinter
+{
+public:
+  RowPrinter(const orc::Type& selected, const vector<string>& hidden)
+  {
+    for (uint64_t i = 0; i < selected.getSubtypeCount(); i++) {
+      const string& title = selected.getFieldName(i);
+      if (find(hidden.begin(), hidden.end(), title) != hidden.end()) {
+        continue;
+      }
+      titles.emplace_back(title);
+      positions.emplace_back(i);
+      printers.emplace_back(createColumnPrinter(line, selected.getSubtype(i)));
+    }
+  }
+  void reset(const ColumnVectorBatch& batch)
+  {
+    auto& fields = dynamic_cast<const StructVectorBatch&>(batch).fields;
+    for (size_t i = 0; i < printers.size(); i++) {
+      printers[i]->reset(*fields[positions[i]]);
+    }
+  }
+  void printRow(uint64_t row, string& out)
+  {
+    out += '{';
+    for (size_t i = 0; i < printers.size(); i++) {
+      if (i > 0) {
+        out += ", ";
+      }
+      out += '"';
+      out += titles[i];
+      out += "\": ";
+      printers[i]->printRow(row);
+      out += line;
+      line.clear();
+    }
+    out += '}';
+  }
+
+private:
+  string line;
+  vector<string> titles;
+  vector<size_t> positions;
+  vector<unique_ptr<ColumnPrinter>> printers;
+};
+
+/**
+ * An event queued from the read worker, emitted on the reader from the main
+ * thread.
+ */
+struct ReadEvent
+{
+  string name;
+  string payload;
+};
+
 class ReadWorker : public AsyncWorker
 {
 public:
-  ReadWorker(Function& cb, Napi::Value self, list<uint64_t> includes)
+  ReadWorker(Function& cb, Napi::Value self, ScanOptions scan)
     : AsyncWorker(cb, "read_worker", self.As<Object>())
     , reader(Reader::Unwrap(self.As<Object>()))
-    , includes(std::move(includes))
+    , scan(std::move(scan))
   {
   }
-  vector<string> data;
-  string full;
+  // chunks an ordered read holds back for a range that is not emitted yet
+  static const size_t MAX_PENDING_CHUNKS = 16;
+  unique_ptr<RowBuffer> rows;
   bool asIterator = false;
+  /**
+   * Bound reader.emit, each batch is pushed through it as soon as it is
+   * decoded. The queue is bounded so the worker blocks (instead of buffering
+   * the whole file) when the main thread falls behind.
+   */
+  ThreadSafeFunction emitter;
 
 protected:
   void Execute() override
   {
-    try {
-      RowReaderOptions options;
-      if (!includes.empty()) {
-        options.include(includes);
+    if (asIterator) {
+      try {
+        rows = ReadRows(reader->ScanFile(scan), scan);
+      } catch (std::exception& ex) {
+        SetError(ex.what());
       }
-      unique_ptr<RowReader> row = reader->reader->createRowReader(options);
-      unique_ptr<ColumnVectorBatch> batch = row->createRowBatch(1024);
-      string line;
-      unique_ptr<ColumnPrinter> printer =
-        createColumnPrinter(line, &row->getSelectedType());
-      while (row->next(*batch)) {
-        printer->reset(*batch);
-        for (unsigned int i = 0; i < batch->numElements; i++) {
-          printer->printRow(i);
-          if (asIterator) {
-            data.emplace_back(line);
-          } else {
-            full += line + ",";
+      return;
+    }
+    try {
+      StripeScan stripes(reader->ScanFile(scan), scan);
+      const size_t ranges = stripes.Size();
+      vector<unique_ptr<RowPrinter>> printers(ranges);
+      auto print = [&](size_t range,
+                       const ColumnVectorBatch& batch,
+                       const Selection* selection) {
+        if (!printers[range]) {
+          printers[range] =
+            make_unique<RowPrinter>(stripes.SelectedType(), scan.hidden);
+        }
+        printers[range]->reset(batch);
+        const uint64_t size =
+          selection ? selection->rows.size() : batch.numElements;
+        string chunk = "[";
+        for (uint64_t i = 0; i < size; i++) {
+          if (i > 0) {
+            chunk += ',';
           }
-          line = "";
+          printers[range]->printRow(selection ? selection->rows[i] : i, chunk);
         }
-      }
-      if (!full.empty()) { // remove trailing comma
-        full.erase(full.size() - 1);
-      }
-    } catch (std::exception& ex) {
-      if (!asIterator) {
-        auto emit = reader->Value().Get("emit").As<Function>();
-        emit.Call(reader->Value(),
-                  { String::New(reader->Env(), "error"),
-                    String::New(reader->Env(), ex.what()) });
+        chunk += ']';
+        return chunk;
+      };
+      if (!scan.ordered || ranges == 1) {
+        stripes.Run([&](size_t range,
+                        const ColumnVectorBatch& batch,
+                        const Selection* selection) {
+          Emit("data", print(range, batch, selection));
+        });
       } else {
-        SetError(ex.what());
+        // chunks of a range are held back until every range before it has
+        // been emitted. A range that is not the head waits once it holds
+        // MAX_PENDING_CHUNKS, so a slow head cannot buffer the whole file.
+        std::mutex lock;
+        std::condition_variable advanced;
+        size_t head = 0;
+        vector<vector<string>> pending(ranges);
+        vector<bool> finished(ranges, false);
+        stripes.Run(
+          [&](size_t range,
+              const ColumnVectorBatch& batch,
+              const Selection* selection) {
+            string chunk = print(range, batch, selection);
+            std::unique_lock<std::mutex> guard(lock);
+            advanced.wait(guard, [&] {
+              return range == head ||
+                     pending[range].size() < MAX_PENDING_CHUNKS ||
+                     stripes.Failed();
+            });
+            if (stripes.Failed()) {
+              return;
+            }
+            if (range == head) {
+              Emit("data", std::move(chunk));
+            } else {
+              pending[range].emplace_back(std::move(chunk));
+            }
+          },
+          [&](size_t range) {
+            std::lock_guard<std::mutex> guard(lock);
+            finished[range] = true;
+            while (!stripes.Failed() && head < ranges && finished[head]) {
+              head++;
+              if (head < ranges) {
+                for (auto& chunk : pending[head]) {
+                  Emit("data", std::move(chunk));
+                }
+                pending[head].clear();
+              }
+            }
+            advanced.notify_all();
+          });
       }
+      Emit("end");
+    } catch (std::exception& ex) {
+      Emit("error", ex.what());
     }
+    emitter.Release();
   }
   void OnOK() override
   {
     if (asIterator) {
-      Array out = Array::New(Env());
-      for (uint32_t i = 0; i < data.size(); i++) {
-        auto o = Object::New(Env());
-        LineToJSON(Env(), data[i], o);
-        out.Set(i, o);
-      }
-      cout << out.Length() << endl;
+      Array out = rows->ToArray(Env());
       Callback().Call({ Env().Null(),
                         out.Get(Symbol::WellKnown(Env(), "iterator"))
                           .As<Function>()
                           .Call(out, {}) });
-    } else {
-      auto emit = reader->Value().Get("emit").As<Function>();
-      if (full.size() < reader->chunkSize) {
-        emit
-          .Call(reader->Value(),
-                { String::New(Env(), "data"),
-                  String::New(Env(), '[' + full + ']') });
-            emit.Call(reader->Value(), { String::New(Env(), "end") });
-        return;
-      }
-      auto chunkCount =
-        ceil(static_cast<double>(full.size()) / reader->chunkSize);
-      unsigned long offset = 0;
-      bool run = true;
-      while (run) {
-        unsigned long chunkEnd;
-        if (offset + reader->chunkSize > full.size()) {
-          chunkEnd = full.size() - offset;
-          if (chunkEnd == 0)
-            break;
-          run = false;
-        } else {
-          chunkEnd = reader->chunkSize + offset;
-        }
-
-        auto endIndex = full.find('}', chunkEnd);
-        string sub = full.substr(offset, ++endIndex - offset);
-        if (sub.empty())
-          break;
-        if (sub[0] == ',')
-          sub.erase(0, 1);
-        if (sub[sub.size() - 1] == ',')
-          sub.erase(sub.size() - 1);
-
-        offset = endIndex;
-        emit.Call(
-          reader->Value(),
-          { String::New(Env(), "data"), String::New(Env(), '[' + sub + ']') });
-      }
-      emit.Call(reader->Value(), { String::New(Env(), "end") });
     }
   }
 
 private:
   Reader* reader;
-  list<uint64_t> includes;
+  ScanOptions scan;
+
+  void Emit(const string& name, string payload = "")
+  {
+    auto event = new ReadEvent{ name, std::move(payload) };
+    napi_status status = emitter.BlockingCall(
+      event, [](Napi::Env env, Function emit, ReadEvent* event) {
+        if (env != nullptr) {
+          if (event->name == "error") {
+            emit.Call({ String::New(env, event->name),
+                        Error::New(env, event->payload).Value() });
+          } else if (event->name == "data") {
+            emit.Call({ String::New(env, event->name),
+                        String::New(env, event->payload) });
+          } else {
+            emit.Call({ String::New(env, event->name) });
+          }
+        }
+        delete event;
+      });
+    if (status != napi_ok) {
+      delete event;
+    }
+  }
 };
 void
 Reader::Read(const CallbackInfo& info)
@@ -199,15 +373,14 @@ Reader::Read(const CallbackInfo& info)
                        { { 0, { option(napi_function), option(napi_object) } },
                          { 1, { nullopt, option(napi_function) } } });
   Function cb;
-  Array cols;
-  list<uint64_t> indices;
+  ScanOptions scan;
   bool asIter = false;
   if (opts[0] == 0) {
     cb = info[0].As<Function>();
   } else if (opts[0] == 1) {
     auto options = info[0].As<Object>();
-    if (options.Has("columns")) {
-      cols = options.Get("columns").As<Array>();
+    if (!ParseScanOptions(info.Env(), options, scan)) {
+      return;
     }
     if (options.Has("resultType")) {
       string rt = options.Get("resultType").As<String>();
@@ -215,37 +388,353 @@ Reader::Read(const CallbackInfo& info)
         asIter = true;
       }
     }
-    if (!cols.IsEmpty()) {
-      for (unsigned int i = 0; i < cols.Length(); i++) {
-        if (cols.Get(static_cast<uint32_t>(i)).IsString()) {
-          string title = cols.Get(static_cast<uint32_t>(i)).As<String>();
-          bool match = false;
-          for (unsigned int j = 0; j < fileMeta.size(); j++) {
-            if (fileMeta[j].title == title) {
-              indices.emplace_back(j);
-              match = true;
-              break;
-            }
-          }
-          if (!match) {
-            Error::New(info.Env(), title + " not a valid column header")
-              .ThrowAsJavaScriptException();
-            return;
-          }
-        }
-      }
-    }
   }
   if (opts[1] == 1) {
     cb = info[1].As<Function>();
   }
-  ReadWorker* worker = new ReadWorker(cb, info.This(), indices);
+  // rows of the iterator are buffered, the JSON printers read plain strings
+  scan.lazyStrings = asIter;
+  ReadWorker* worker = new ReadWorker(cb, info.This(), std::move(scan));
   if (asIter) {
     worker->asIterator = true;
+  } else {
+    auto self = info.This().As<Object>();
+    auto emit = self.Get("emit").As<Function>();
+    auto bound =
+      emit.Get("bind").As<Function>().Call(emit, { self }).As<Function>();
+    worker->emitter =
+      ThreadSafeFunction::New(info.Env(), bound, "norc_read_events", 2, 1);
+  }
+  worker->Queue();
+}
+
+void
+Reader::LoadStripeStatistics()
+{
+  std::call_once(stripeStatistics,
+                 [this]() { reader->getNumberOfStripeStatistics(); });
+}
+const orc::Reader&
+Reader::ScanFile(const ScanOptions& scan)
+{
+  // orc reads the stripe statistics when a row reader gets a search argument
+  if (scan.where) {
+    LoadStripeStatistics();
+  }
+  return *reader;
+}
+bool
+Reader::ResolveColumns(const Napi::Env& env,
+                       const Napi::Array& cols,
+                       list<uint64_t>& indices)
+{
+  for (unsigned int i = 0; i < cols.Length(); i++) {
+    if (cols.Get(static_cast<uint32_t>(i)).IsString()) {
+      string title = cols.Get(static_cast<uint32_t>(i)).As<String>();
+      bool match = false;
+      for (unsigned int j = 0; j < fileMeta.size(); j++) {
+        if (fileMeta[j].title == title) {
+          indices.emplace_back(j);
+          match = true;
+          break;
+        }
+      }
+      if (!match) {
+        Error::New(env, title + " not a valid column header")
+          .ThrowAsJavaScriptException();
+        return false;
+      }
+    }
+  }
+  return true;
+}
+bool
+Reader::ParseScanOptions(const Napi::Env& env,
+                         const Napi::Object& options,
+                         ScanOptions& scan)
+{
+  if (options.Has("columns") &&
+      !ResolveColumns(env, options.Get("columns").As<Array>(), scan.includes)) {
+    return false;
+  }
+  if (options.Has("chunkSize")) {
+    int64_t chunkSize = options.Get("chunkSize").As<Number>().Int64Value();
+    if (chunkSize < 1) {
+      RangeError::New(env, "chunkSize must be a positive number")
+        .ThrowAsJavaScriptException();
+      return false;
+    }
+    scan.chunkSize = static_cast<uint64_t>(chunkSize);
+  }
+  if (options.Has("parallel")) {
+    Napi::Value parallel = options.Get("parallel");
+    if (parallel.IsBoolean()) {
+      scan.parallel = parallel.As<Boolean>().Value()
+                        ? std::max(1U, std::thread::hardware_concurrency())
+                        : 1;
+    } else {
+      int64_t threads = parallel.As<Number>().Int64Value();
+      if (threads < 1) {
+        RangeError::New(env, "parallel must be a positive number or a boolean")
+          .ThrowAsJavaScriptException();
+        return false;
+      }
+      scan.parallel = static_cast<uint64_t>(threads);
+    }
+  }
+  if (options.Has("ordered")) {
+    scan.ordered = options.Get("ordered").ToBoolean();
+  }
+  if (options.Has("offset")) {
+    int64_t offset = options.Get("offset").As<Number>().Int64Value();
+    if (offset < 0) {
+      RangeError::New(env, "offset must not be negative")
+        .ThrowAsJavaScriptException();
+      return false;
+    }
+    scan.offset = static_cast<uint64_t>(offset);
+  }
+  if (options.Has("limit")) {
+    int64_t limit = options.Get("limit").As<Number>().Int64Value();
+    if (limit < 0) {
+      RangeError::New(env, "limit must not be negative")
+        .ThrowAsJavaScriptException();
+      return false;
+    }
+    scan.limit = static_cast<uint64_t>(limit);
+  }
+  if (options.Has("where") && !options.Get("where").IsUndefined()) {
+    auto where = std::make_shared<Predicate>();
+    if (!Predicate::Parse(
+          env, options.Get("where"), reader->getType(), *where)) {
+      return false;
+    }
+    if (!where->children.empty()) {
+      scan.where = where;
+      // columns of the predicate that were not asked for are decoded too
+      if (!scan.includes.empty()) {
+        const size_t listed = scan.includes.size();
+        where->CollectFields(scan.includes);
+        for (auto i = std::next(scan.includes.begin(), listed);
+             i != scan.includes.end();
+             i++) {
+          scan.hidden.emplace_back(fileMeta[*i].title);
+        }
+      }
+    }
+  }
+  return true;
+}
+RowReaderOptions
+ScanOptions::ToRowReaderOptions() const
+{
+  RowReaderOptions options;
+  if (!includes.empty()) {
+    options.include(includes);
+  }
+  if (where) {
+    options.searchArgument(where->ToSearchArgument());
+  }
+  options.setEnableLazyDecoding(lazyStrings);
+  return options;
+}
+uint64_t
+ScanOptions::BatchSize() const
+{
+  return std::max<uint64_t>(1, std::min(chunkSize, limit));
+}
+
+class ReadColumnsWorker : public AsyncWorker
+{
+public:
+  ReadColumnsWorker(Function& cb, Napi::Value self, ScanOptions scan)
+    : AsyncWorker(cb, "read_columns_worker", self.As<Object>())
+    , reader(Reader::Unwrap(self.As<Object>()))
+    , scan(std::move(scan))
+  {}
+  // string columns are returned as {dictionary, indices, nulls}
+  bool dictionary = false;
+
+protected:
+  void Execute() override
+  {
+    try {
+      rows = ReadRows(reader->ScanFile(scan), scan);
+    } catch (std::exception& ex) {
+      SetError(ex.what());
+    }
+  }
+  void OnOK() override
+  {
+    auto out = Object::New(Env());
+    for (auto& column : rows->columns) {
+      const bool strings = column.kind == TypeKind::STRING ||
+                           column.kind == TypeKind::VARCHAR ||
+                           column.kind == TypeKind::CHAR;
+      out.Set(column.title,
+              dictionary && strings ? column.ToDictionary(Env())
+                                    : column.ToTypedArray(Env()));
+    }
+    Callback().Call({ Env().Null(), out });
+  }
+
+private:
+  Reader* reader;
+  ScanOptions scan;
+  unique_ptr<RowBuffer> rows;
+};
+void
+Reader::ReadColumns(const CallbackInfo& info)
+{
+  AssertCallbackInfo(info,
+                     { { 0, { option(napi_object) } },
+                       { 1, { option(napi_function) } } });
+  if (info.Env().IsExceptionPending()) {
+    return;
   }
+  auto cb = info[1].As<Function>();
+  ScanOptions scan;
+  auto options = info[0].As<Object>();
+  if (!ParseScanOptions(info.Env(), options, scan)) {
+    return;
+  }
+  scan.lazyStrings = true;
+  auto worker = new ReadColumnsWorker(cb, info.This(), std::move(scan));
+  worker->dictionary =
+    options.Has("dictionary") && options.Get("dictionary").ToBoolean();
   worker->Queue();
 }
 
+class StatisticsWorker : public AsyncWorker
+{
+public:
+  StatisticsWorker(Function& cb,
+                   Napi::Value self,
+                   StatisticsLevel level,
+                   vector<NorcColumnMetadata> columns)
+    : AsyncWorker(cb, "statistics_worker", self.As<Object>())
+    , reader(Reader::Unwrap(self.As<Object>()))
+    , level(level)
+    , columns(std::move(columns))
+  {}
+
+protected:
+  void Execute() override
+  {
+    try {
+      if (level != StatisticsLevel::File) {
+        reader->LoadStripeStatistics();
+      }
+      entries = CollectStatistics(*reader->reader, level, columns);
+    } catch (std::exception& ex) {
+      SetError(ex.what());
+    }
+  }
+  void OnOK() override
+  {
+    Napi::Env env = Env();
+    auto toObject = [&](const StatisticsEntry& entry) {
+      auto out = Object::New(env);
+      if (level != StatisticsLevel::File) {
+        out.Set("stripe", static_cast<double>(entry.stripe));
+      }
+      if (level == StatisticsLevel::RowGroup) {
+        out.Set("rowGroup", static_cast<double>(entry.rowGroup));
+      }
+      if (level != StatisticsLevel::File) {
+        out.Set("firstRow", static_cast<double>(entry.firstRow));
+      }
+      out.Set("rows", static_cast<double>(entry.rows));
+      if (level == StatisticsLevel::Stripe) {
+        out.Set("offset", static_cast<double>(entry.offset));
+        out.Set("length", static_cast<double>(entry.length));
+      }
+      auto stats = Object::New(env);
+      for (auto& column : entry.columns) {
+        stats.Set(column.column, column.ToObject(env));
+      }
+      out.Set("columns", stats);
+      return out;
+    };
+    if (level == StatisticsLevel::File) {
+      Callback().Call({ env.Null(), toObject(entries[0]) });
+      return;
+    }
+    auto out = Array::New(env, entries.size());
+    for (uint32_t i = 0; i < entries.size(); i++) {
+      out.Set(i, toObject(entries[i]));
+    }
+    Callback().Call({ env.Null(), out });
+  }
+
+private:
+  Reader* reader;
+  StatisticsLevel level;
+  vector<NorcColumnMetadata> columns;
+  vector<StatisticsEntry> entries;
+};
+void
+Reader::Statistics(const CallbackInfo& info)
+{
+  AssertCallbackInfo(info,
+                     { { 0, { option(napi_object) } },
+                       { 1, { option(napi_function) } } });
+  if (info.Env().IsExceptionPending()) {
+    return;
+  }
+  auto options = info[0].As<Object>();
+  auto cb = info[1].As<Function>();
+  StatisticsLevel level = StatisticsLevel::File;
+  if (options.Has("level")) {
+    string name = options.Get("level").ToString();
+    if (name == "stripe") {
+      level = StatisticsLevel::Stripe;
+    } else if (name == "rowGroup") {
+      level = StatisticsLevel::RowGroup;
+    } else if (name != "file") {
+      RangeError::New(info.Env(), "level must be file, stripe or rowGroup")
+        .ThrowAsJavaScriptException();
+      return;
+    }
+  }
+  vector<NorcColumnMetadata> columns = fileMeta;
+  if (options.Has("columns")) {
+    list<uint64_t> indices;
+    if (!ResolveColumns(
+          info.Env(), options.Get("columns").As<Array>(), indices)) {
+      return;
+    }
+    columns.clear();
+    for (auto index : indices) {
+      columns.emplace_back(fileMeta[index]);
+    }
+  }
+  auto worker =
+    new StatisticsWorker(cb, info.This(), level, std::move(columns));
+  worker->Queue();
+}
+Napi::Value
+Reader::GetStripes(const CallbackInfo& info)
+{
+  auto out = Array::New(info.Env(), reader->getNumberOfStripes());
+  uint64_t firstRow = 0;
+  for (uint32_t i = 0; i < reader->getNumberOfStripes(); i++) {
+    unique_ptr<StripeInformation> stripe = reader->getStripe(i);
+    auto entry = Object::New(info.Env());
+    entry.Set("index", static_cast<double>(i));
+    entry.Set("offset", static_cast<double>(stripe->getOffset()));
+    entry.Set("length", static_cast<double>(stripe->getLength()));
+    entry.Set("indexLength", static_cast<double>(stripe->getIndexLength()));
+    entry.Set("dataLength", static_cast<double>(stripe->getDataLength()));
+    entry.Set("footerLength", static_cast<double>(stripe->getFooterLength()));
+    entry.Set("firstRow", static_cast<double>(firstRow));
+    entry.Set("rows", static_cast<double>(stripe->getNumberOfRows()));
+    firstRow += stripe->getNumberOfRows();
+    out.Set(i, entry);
+  }
+  return out;
+}
+
 Napi::Value
 Reader::GetCompression(const CallbackInfo& info)
 {
@@ -270,7 +759,7 @@ Reader::GetColumnStatistics(const CallbackInfo& info)
   for (auto i : fileMeta) {
     if (i.title == columnTitle) {
       return String::New(info.Env(),
-                         reader->getColumnStatistics(i.index)->toString());
+                         reader->getColumnStatistics(i.columnId)->toString());
     }
   }
   Error::New(info.Env(), "Column: " + columnTitle + " not found")
@@ -278,6 +767,32 @@ Reader::GetColumnStatistics(const CallbackInfo& info)
   return {};
 }
 Napi::Value
+Reader::GetSerializedTail(const CallbackInfo& info)
+{
+  string tail = reader->getSerializedFileTail();
+  return Buffer<char>::Copy(info.Env(), tail.data(), tail.size());
+}
+void
+Reader::SetTailCacheSize(const CallbackInfo& info)
+{
+  AssertCallbackInfo(info, { { 0, { option(napi_number) } } });
+  if (info.Env().IsExceptionPending()) {
+    return;
+  }
+  int64_t bytes = info[0].As<Number>().Int64Value();
+  if (bytes < 0) {
+    RangeError::New(info.Env(), "The tail cache size must not be negative")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  TailCache::Instance().SetCapacity(static_cast<uint64_t>(bytes));
+}
+void
+Reader::ClearTailCache(const CallbackInfo&)
+{
+  TailCache::Instance().Clear();
+}
+Napi::Value
 Reader::GetFormatVersion(const CallbackInfo& info)
 {
   return String::New(info.Env(), reader->getFormatVersion().toString());
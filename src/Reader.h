@@ -19,10 +19,17 @@
 #ifndef NORC_READER_H
 #define NORC_READER_H
 
+#include "Predicate.h"
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <napi.h>
 #include <orc/OrcFile.hh>
 
 using Napi::CallbackInfo;
+using std::list;
+using std::shared_ptr;
 using std::unique_ptr;
 using std::vector;
 using std::string;
@@ -32,8 +39,44 @@ namespace norc {
 struct NorcColumnMetadata {
 public:
   string title;
+  // position among the fields of the file schema
   unsigned int index;
   orc::TypeKind type;
+  // id of the column in the type tree, as used by orc statistics
+  uint32_t columnId;
+};
+
+/**
+ * Options shared by every scan of the file, parsed from the JS options object
+ * by Reader::ParseScanOptions.
+ */
+struct ScanOptions
+{
+  list<uint64_t> includes;
+  // rows per decoded batch
+  uint64_t chunkSize = 1024;
+  // stripes and row groups that cannot match are skipped, the rows of the
+  // others are filtered
+  shared_ptr<const Predicate> where;
+  // titles of the columns only decoded to evaluate where, left out of rows
+  vector<string> hidden;
+  // threads decoding disjoint ranges of stripes
+  uint64_t parallel = 1;
+  // emit the batches of a parallel read in file order
+  bool ordered = true;
+  // row number of the file the scan starts at
+  uint64_t offset = 0;
+  // maximum number of rows returned
+  uint64_t limit = std::numeric_limits<uint64_t>::max();
+  // decode dictionary encoded strings lazily, as EncodedStringVectorBatch,
+  // only for scans whose batches are buffered in a RowBuffer
+  bool lazyStrings = false;
+  /**
+   * Capacity of the decoded batches, never more than the limit so a small
+   * page does not decode a full chunk.
+   */
+  uint64_t BatchSize() const;
+  orc::RowReaderOptions ToRowReaderOptions() const;
 };
 
 class Reader : public Napi::ObjectWrap<Reader>
@@ -43,15 +86,84 @@ public:
   static void Initialize(Napi::Env&, Napi::Object&);
   explicit Reader(const CallbackInfo&);
   void Read(const CallbackInfo&);
+  void ReadColumns(const CallbackInfo&);
+  Napi::Value CreateCursor(const CallbackInfo&);
+  /**
+   * Rows whose column equals one of the given keys. Only the row groups that
+   * may hold a key, according to the bloom filters (or the row index when the
+   * column has none), are decoded.
+   */
+  void Lookup(const CallbackInfo&);
+  /**
+   * Count, sum, min, max and avg of columns. Stripes the statistics answer,
+   * with the where option true or false for all of their rows, are not
+   * decoded.
+   */
+  void Aggregate(const CallbackInfo&);
+  /**
+   * Totals of columns for every distinct combination of the values of key
+   * columns, grouped natively in a hash table per range of stripes.
+   */
+  void GroupBy(const CallbackInfo&);
+  /**
+   * The first k rows ordered by a column. Only the ordered column is decoded
+   * to rank the rows, the other columns are decoded for the winning rows.
+   */
+  void TopK(const CallbackInfo&);
+  /**
+   * Null ratio, approximate distinct count, approximate quantiles and string
+   * lengths of columns, from a single pass over the file.
+   */
+  void Profile(const CallbackInfo&);
+  /**
+   * Hash join of two readers on key columns of the same titles. The smaller
+   * file is decoded into a hash table, the larger one is probed batch by
+   * batch.
+   */
+  static void Join(const CallbackInfo&);
   Napi::Value GetColumnStatistics(const CallbackInfo&);
+  void Statistics(const CallbackInfo&);
+  Napi::Value GetStripes(const CallbackInfo&);
   Napi::Value GetWriterVersion(const CallbackInfo&);
   Napi::Value GetFormatVersion(const CallbackInfo&);
   Napi::Value GetCompression(const CallbackInfo&);
   Napi::Value GetType(const CallbackInfo&);
+  /**
+   * The serialized file tail, to be passed back as the tail option when the
+   * same file is opened again.
+   */
+  Napi::Value GetSerializedTail(const CallbackInfo&);
+  static void SetTailCacheSize(const CallbackInfo&);
+  static void ClearTailCache(const CallbackInfo&);
+  /**
+   * Resolve column titles to their field index. Throws a JS exception and
+   * returns false when a title is not a column of this file.
+   */
+  bool ResolveColumns(const Napi::Env&, const Napi::Array&, list<uint64_t>&);
+  /**
+   * Parse the options common to all scans (columns, chunkSize, where,
+   * parallel, ordered, offset, limit). Throws a JS exception and returns false
+   * on invalid options.
+   */
+  bool ParseScanOptions(const Napi::Env&, const Napi::Object&, ScanOptions&);
+  /**
+   * Read the stripe statistics of the file, once. orc::Reader loads them on
+   * first use without a lock, so the workers that need them (a where pushed
+   * down as a search argument, statistics, aggregate, lookup) call this first
+   * and only read them afterwards. Opening a reader only parses the footer.
+   */
+  void LoadStripeStatistics();
+  /**
+   * The orc reader for a scan, with the stripe statistics loaded when the
+   * scan has a where.
+   */
+  const orc::Reader& ScanFile(const ScanOptions&);
   orc::ReaderOptions readerOptions;
+  // Buffer input, referenced for as long as reader reads from its memory
+  Napi::ObjectReference source;
   unique_ptr<orc::Reader> reader;
+  std::once_flag stripeStatistics;
   vector<NorcColumnMetadata> fileMeta;
-  uint64_t chunkSize = 8 << 10;
 };
 }
 
@@ -0,0 +1,148 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Sketch.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace norc {
+
+HyperLogLog::HyperLogLog()
+  : registers(size_t(1) << PRECISION, 0)
+{}
+void
+HyperLogLog::Merge(const HyperLogLog& other)
+{
+  for (size_t i = 0; i < registers.size(); i++) {
+    registers[i] = std::max(registers[i], other.registers[i]);
+  }
+}
+double
+HyperLogLog::Estimate() const
+{
+  const double m = static_cast<double>(registers.size());
+  double sum = 0;
+  uint64_t zeros = 0;
+  for (auto rank : registers) {
+    sum += std::ldexp(1.0, -rank);
+    zeros += rank == 0;
+  }
+  const double alpha = 0.7213 / (1 + 1.079 / m);
+  const double estimate = alpha * m * m / sum;
+  if (estimate <= 2.5 * m && zeros > 0) {
+    // linear counting is more accurate while registers are still empty
+    return m * std::log(m / static_cast<double>(zeros));
+  }
+  return estimate;
+}
+
+KllSketch::KllSketch(uint32_t k)
+  : k(k)
+  , min(std::numeric_limits<double>::infinity())
+  , max(-std::numeric_limits<double>::infinity())
+{
+  AddLevel();
+}
+void
+KllSketch::AddLevel()
+{
+  levels.emplace_back();
+  capacities.resize(levels.size());
+  // the top level holds k values, each level below it 2/3 of the one above
+  double capacity = k;
+  for (size_t h = levels.size(); h-- > 0;) {
+    capacities[h] = std::max<size_t>(2, static_cast<size_t>(capacity));
+    capacity *= 2.0 / 3.0;
+  }
+}
+void
+KllSketch::Compress()
+{
+  for (size_t h = 0; h < levels.size(); h++) {
+    if (levels[h].size() < capacities[h]) {
+      continue;
+    }
+    if (h + 1 == levels.size()) {
+      AddLevel();
+    }
+    vector<double>& level = levels[h];
+    std::sort(level.begin(), level.end());
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+    // an odd value out stays at this level
+    const size_t even = level.size() & ~size_t(1);
+    for (size_t i = random & 1; i < even; i += 2) {
+      levels[h + 1].emplace_back(level[i]);
+    }
+    level.erase(level.begin(), level.begin() + even);
+  }
+}
+void
+KllSketch::Merge(const KllSketch& other)
+{
+  while (levels.size() < other.levels.size()) {
+    AddLevel();
+  }
+  for (size_t h = 0; h < other.levels.size(); h++) {
+    levels[h].insert(
+      levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+  }
+  count += other.count;
+  min = std::min(min, other.min);
+  max = std::max(max, other.max);
+  bool full = true;
+  while (full) {
+    Compress();
+    full = false;
+    for (size_t h = 0; h < levels.size(); h++) {
+      full = full || levels[h].size() >= capacities[h];
+    }
+  }
+}
+double
+KllSketch::Quantile(double q) const
+{
+  if (q <= 0) {
+    return min;
+  }
+  if (q >= 1) {
+    return max;
+  }
+  vector<std::pair<double, uint64_t>> weighted;
+  uint64_t total = 0;
+  for (size_t h = 0; h < levels.size(); h++) {
+    for (auto value : levels[h]) {
+      weighted.emplace_back(value, uint64_t(1) << h);
+      total += uint64_t(1) << h;
+    }
+  }
+  std::sort(weighted.begin(), weighted.end());
+  const double target = q * static_cast<double>(total);
+  uint64_t seen = 0;
+  for (auto& entry : weighted) {
+    seen += entry.second;
+    if (static_cast<double>(seen) >= target) {
+      return entry.first;
+    }
+  }
+  return max;
+}
+}
@@ -0,0 +1,106 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NORC_SKETCH_H
+#define NORC_SKETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+namespace norc {
+
+/**
+ * HyperLogLog estimate of the number of distinct 64 bit hashes added, with
+ * 2^14 one byte registers (a standard error of about 0.8%). Sketches of the
+ * same values merge by keeping the maximum of every register.
+ */
+class HyperLogLog
+{
+public:
+  static const uint32_t PRECISION = 14;
+  HyperLogLog();
+  void Add(uint64_t hash)
+  {
+    const uint64_t index = hash >> (64 - PRECISION);
+    // the bit set below bounds the rank when the remaining bits are zero
+    const uint64_t rest =
+      (hash << PRECISION) | (uint64_t(1) << (PRECISION - 1));
+    const uint8_t rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+    if (rank > registers[index]) {
+      registers[index] = rank;
+    }
+  }
+  void Merge(const HyperLogLog&);
+  double Estimate() const;
+
+private:
+  vector<uint8_t> registers;
+};
+
+/**
+ * KLL sketch of a stream of numbers, answering quantile queries with a rank
+ * error of about 1.7 / k using O(k) values. Values are kept in levels, a value
+ * at level h stands for 2^h values of the stream. A full level is sorted and
+ * every other value (starting at a random one of the first two) is promoted
+ * to the next level, the capacity of a level shrinks by 2/3 per level below
+ * the top one.
+ */
+class KllSketch
+{
+public:
+  explicit KllSketch(uint32_t k = 200);
+  void Add(double value)
+  {
+    levels[0].emplace_back(value);
+    count++;
+    min = value < min ? value : min;
+    max = value > max ? value : max;
+    if (levels[0].size() >= capacities[0]) {
+      Compress();
+    }
+  }
+  void Merge(const KllSketch&);
+  uint64_t Count() const { return count; }
+  /**
+   * The value at rank q (0 to 1) of the values added, the exact minimum and
+   * maximum for 0 and 1. Only valid once a value was added.
+   */
+  double Quantile(double q) const;
+
+private:
+  void AddLevel();
+  /**
+   * Compact every level that is at capacity into the level above it.
+   */
+  void Compress();
+
+  uint32_t k;
+  uint64_t count = 0;
+  double min;
+  double max;
+  vector<vector<double>> levels;
+  vector<size_t> capacities;
+  // xorshift state, fixed so profiles of the same file are reproducible
+  uint64_t random = 0x9e3779b97f4a7c15ULL;
+};
+}
+
+#endif // NORC_SKETCH_H
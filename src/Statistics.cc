@@ -0,0 +1,292 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Statistics.h"
+#include "Internal.h"
+#include <cstdlib>
+
+using namespace Napi;
+using namespace orc;
+
+namespace norc {
+
+static double
+DecimalToDouble(const orc::Decimal& value)
+{
+  return strtod(value.toString().c_str(), nullptr);
+}
+ColumnSummary
+ColumnSummary::From(const orc::ColumnStatistics& stats,
+                    const NorcColumnMetadata& meta)
+{
+  ColumnSummary out;
+  out.column = meta.title;
+  out.kind = meta.type;
+  out.count = stats.getNumberOfValues();
+  out.hasNull = stats.hasNull();
+  switch (meta.type) {
+    case TypeKind::BOOLEAN: {
+      auto s = dynamic_cast<const BooleanColumnStatistics*>(&stats);
+      if (s != nullptr && s->hasCount()) {
+        out.hasMinMax = out.count > 0;
+        out.minInteger = s->getFalseCount() > 0 ? 0 : 1;
+        out.maxInteger = s->getTrueCount() > 0 ? 1 : 0;
+        out.hasSum = true;
+        out.sumInteger = static_cast<int64_t>(s->getTrueCount());
+      }
+      break;
+    }
+    case TypeKind::BYTE:
+    case TypeKind::SHORT:
+    case TypeKind::INT:
+    case TypeKind::LONG: {
+      auto s = dynamic_cast<const IntegerColumnStatistics*>(&stats);
+      if (s != nullptr) {
+        out.hasMinMax = s->hasMinimum() && s->hasMaximum();
+        if (out.hasMinMax) {
+          out.minInteger = s->getMinimum();
+          out.maxInteger = s->getMaximum();
+        }
+        // orc drops the sum once it overflows
+        out.hasSum = s->hasSum();
+        if (out.hasSum) {
+          out.sumInteger = s->getSum();
+        }
+      }
+      break;
+    }
+    case TypeKind::DATE: {
+      auto s = dynamic_cast<const DateColumnStatistics*>(&stats);
+      if (s != nullptr) {
+        out.hasMinMax = s->hasMinimum() && s->hasMaximum();
+        if (out.hasMinMax) {
+          out.minInteger = s->getMinimum();
+          out.maxInteger = s->getMaximum();
+        }
+      }
+      break;
+    }
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE: {
+      auto s = dynamic_cast<const DoubleColumnStatistics*>(&stats);
+      if (s != nullptr) {
+        out.hasMinMax = s->hasMinimum() && s->hasMaximum();
+        if (out.hasMinMax) {
+          out.minReal = s->getMinimum();
+          out.maxReal = s->getMaximum();
+        }
+        out.hasSum = s->hasSum();
+        if (out.hasSum) {
+          out.sumReal = s->getSum();
+        }
+      }
+      break;
+    }
+    case TypeKind::DECIMAL: {
+      auto s = dynamic_cast<const DecimalColumnStatistics*>(&stats);
+      if (s != nullptr) {
+        out.hasMinMax = s->hasMinimum() && s->hasMaximum();
+        if (out.hasMinMax) {
+          out.minReal = DecimalToDouble(s->getMinimum());
+          out.maxReal = DecimalToDouble(s->getMaximum());
+        }
+        out.hasSum = s->hasSum();
+        if (out.hasSum) {
+          out.sumReal = DecimalToDouble(s->getSum());
+        }
+      }
+      break;
+    }
+    case TypeKind::TIMESTAMP: {
+      auto s = dynamic_cast<const TimestampColumnStatistics*>(&stats);
+      if (s != nullptr) {
+        out.hasMinMax = s->hasMinimum() && s->hasMaximum();
+        if (out.hasMinMax) {
+          out.minInteger = s->getMinimum();
+          out.maxInteger = s->getMaximum();
+          out.minNanos = s->getMinimumNanos();
+          out.maxNanos = s->getMaximumNanos();
+        }
+      }
+      break;
+    }
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR: {
+      auto s = dynamic_cast<const StringColumnStatistics*>(&stats);
+      if (s != nullptr) {
+        out.hasMinMax = s->hasMinimum() && s->hasMaximum();
+        if (out.hasMinMax) {
+          out.minText = s->getMinimum();
+          out.maxText = s->getMaximum();
+        }
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return out;
+}
+/**
+ * Format epoch milliseconds and the nanoseconds below them the way timestamps
+ * are read.
+ */
+static string
+FormatMillis(int64_t millis, int64_t nanos)
+{
+  int64_t seconds = millis / 1000;
+  int64_t remainder = millis % 1000;
+  if (remainder < 0) {
+    seconds--;
+    remainder += 1000;
+  }
+  return FormatTimestamp(seconds, remainder * 1000000 + nanos);
+}
+Napi::Value
+ColumnSummary::Min(Napi::Env env) const
+{
+  switch (kind) {
+    case TypeKind::BOOLEAN:
+      return Boolean::New(env, minInteger != 0);
+    case TypeKind::DATE:
+      return String::New(env, FormatDate(minInteger));
+    case TypeKind::TIMESTAMP:
+      return String::New(env, FormatMillis(minInteger, minNanos));
+    case TypeKind::FLOAT:
+      return Number::New(env, RoundFloat(minReal));
+    case TypeKind::DOUBLE:
+    case TypeKind::DECIMAL:
+      return Number::New(env, minReal);
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR:
+      return String::New(env, minText);
+    default:
+      return Number::New(env, static_cast<double>(minInteger));
+  }
+}
+Napi::Value
+ColumnSummary::Max(Napi::Env env) const
+{
+  switch (kind) {
+    case TypeKind::BOOLEAN:
+      return Boolean::New(env, maxInteger != 0);
+    case TypeKind::DATE:
+      return String::New(env, FormatDate(maxInteger));
+    case TypeKind::TIMESTAMP:
+      return String::New(env, FormatMillis(maxInteger, maxNanos));
+    case TypeKind::FLOAT:
+      return Number::New(env, RoundFloat(maxReal));
+    case TypeKind::DOUBLE:
+    case TypeKind::DECIMAL:
+      return Number::New(env, maxReal);
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR:
+      return String::New(env, maxText);
+    default:
+      return Number::New(env, static_cast<double>(maxInteger));
+  }
+}
+Napi::Object
+ColumnSummary::ToObject(Napi::Env env) const
+{
+  auto out = Object::New(env);
+  out.Set("count", Number::New(env, static_cast<double>(count)));
+  out.Set("hasNull", Boolean::New(env, hasNull));
+  if (hasMinMax) {
+    out.Set("min", Min(env));
+    out.Set("max", Max(env));
+  }
+  if (hasSum) {
+    switch (kind) {
+      case TypeKind::FLOAT:
+      case TypeKind::DOUBLE:
+      case TypeKind::DECIMAL:
+        out.Set("sum", sumReal);
+        break;
+      default:
+        out.Set("sum", static_cast<double>(sumInteger));
+        break;
+    }
+  }
+  return out;
+}
+
+vector<StatisticsEntry>
+CollectStatistics(const orc::Reader& reader,
+                  StatisticsLevel level,
+                  const vector<NorcColumnMetadata>& columns)
+{
+  vector<StatisticsEntry> out;
+  if (level == StatisticsLevel::File) {
+    unique_ptr<orc::Statistics> stats = reader.getStatistics();
+    StatisticsEntry entry;
+    entry.rows = reader.getNumberOfRows();
+    entry.length = reader.getContentLength();
+    for (auto& column : columns) {
+      entry.columns.emplace_back(ColumnSummary::From(
+        *stats->getColumnStatistics(column.columnId), column));
+    }
+    out.emplace_back(std::move(entry));
+    return out;
+  }
+  const uint64_t stride = reader.getRowIndexStride();
+  uint64_t firstRow = 0;
+  for (uint64_t i = 0; i < reader.getNumberOfStripes(); i++) {
+    unique_ptr<StripeInformation> stripe = reader.getStripe(i);
+    // the row indexes are only parsed when row group statistics are asked
+    unique_ptr<StripeStatistics> stats =
+      reader.getStripeStatistics(i, level != StatisticsLevel::Stripe);
+    if (level == StatisticsLevel::Stripe) {
+      StatisticsEntry entry;
+      entry.stripe = i;
+      entry.firstRow = firstRow;
+      entry.rows = stripe->getNumberOfRows();
+      entry.offset = stripe->getOffset();
+      entry.length = stripe->getLength();
+      for (auto& column : columns) {
+        entry.columns.emplace_back(ColumnSummary::From(
+          *stats->getColumnStatistics(column.columnId), column));
+      }
+      out.emplace_back(std::move(entry));
+    } else {
+      const uint64_t groups =
+        stride == 0 ? 0 : (stripe->getNumberOfRows() + stride - 1) / stride;
+      for (uint64_t g = 0; g < groups; g++) {
+        StatisticsEntry entry;
+        entry.stripe = i;
+        entry.rowGroup = g;
+        entry.firstRow = firstRow + g * stride;
+        entry.rows = std::min(stride, stripe->getNumberOfRows() - g * stride);
+        for (auto& column : columns) {
+          if (g >= stats->getNumberOfRowIndexStats(column.columnId)) {
+            continue;
+          }
+          entry.columns.emplace_back(ColumnSummary::From(
+            *stats->getRowIndexStatistics(column.columnId, g), column));
+        }
+        out.emplace_back(std::move(entry));
+      }
+    }
+    firstRow += stripe->getNumberOfRows();
+  }
+  return out;
+}
+}
@@ -0,0 +1,112 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NORC_STATISTICS_H
+#define NORC_STATISTICS_H
+
+#include "Reader.h"
+#include <napi.h>
+#include <orc/OrcFile.hh>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace norc {
+
+/**
+ * Statistics of one column copied out of orc::ColumnStatistics, so they can
+ * be collected on a worker thread and converted to JS on the main thread.
+ *
+ * Minimum, maximum and sum by kind:
+ *  - BOOLEAN: integer (0, 1), sum is the number of true values
+ *  - BYTE, SHORT, INT, LONG, DATE (days since epoch): integer
+ *  - FLOAT, DOUBLE, DECIMAL: real
+ *  - TIMESTAMP: integer (epoch milliseconds) and nanos (below a millisecond)
+ *  - STRING, VARCHAR, CHAR: text, no sum
+ */
+struct ColumnSummary
+{
+  string column;
+  orc::TypeKind kind;
+  // number of non null values
+  uint64_t count = 0;
+  bool hasNull = false;
+  bool hasMinMax = false;
+  bool hasSum = false;
+  int64_t minInteger = 0;
+  int64_t maxInteger = 0;
+  int64_t sumInteger = 0;
+  int64_t minNanos = 0;
+  int64_t maxNanos = 0;
+  double minReal = 0;
+  double maxReal = 0;
+  double sumReal = 0;
+  string minText;
+  string maxText;
+
+  static ColumnSummary From(const orc::ColumnStatistics&,
+                            const NorcColumnMetadata&);
+  /**
+   * The minimum or maximum with the type values of the column are read as.
+   */
+  Napi::Value Min(Napi::Env) const;
+  Napi::Value Max(Napi::Env) const;
+  /**
+   * {count, hasNull, min, max, sum}, min and max have the type values of the
+   * column are read as, min, max and sum are only set when orc recorded them.
+   */
+  Napi::Object ToObject(Napi::Env) const;
+};
+
+enum class StatisticsLevel
+{
+  File,
+  Stripe,
+  RowGroup
+};
+
+/**
+ * Statistics of the whole file, a stripe, or a row group of a stripe. Row
+ * counts and positions are in rows of the file, offset and length are the
+ * byte range of a stripe.
+ */
+struct StatisticsEntry
+{
+  uint64_t stripe = 0;
+  uint64_t rowGroup = 0;
+  uint64_t firstRow = 0;
+  uint64_t rows = 0;
+  uint64_t offset = 0;
+  uint64_t length = 0;
+  vector<ColumnSummary> columns;
+};
+
+/**
+ * Collect the statistics of the given columns. File and stripe statistics
+ * come from the file tail, row group statistics read the row index of every
+ * stripe.
+ */
+vector<StatisticsEntry>
+CollectStatistics(const orc::Reader&,
+                  StatisticsLevel,
+                  const vector<NorcColumnMetadata>& columns);
+}
+
+#endif // NORC_STATISTICS_H
@@ -0,0 +1,221 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "StripeScan.h"
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using namespace orc;
+
+using std::string;
+
+namespace norc {
+
+void
+TruncateBatch(orc::ColumnVectorBatch& batch, uint64_t rows)
+{
+  batch.numElements = rows;
+  if (auto fields = dynamic_cast<StructVectorBatch*>(&batch)) {
+    for (auto field : fields->fields) {
+      TruncateBatch(*field, rows);
+    }
+  }
+}
+
+void
+ResolveDictionaries(orc::ColumnVectorBatch& batch)
+{
+  if (auto fields = dynamic_cast<StructVectorBatch*>(&batch)) {
+    for (auto field : fields->fields) {
+      ResolveDictionaries(*field);
+    }
+    return;
+  }
+  auto encoded = dynamic_cast<EncodedStringVectorBatch*>(&batch);
+  if (!encoded || !encoded->isEncoded) {
+    return;
+  }
+  for (uint64_t i = 0; i < encoded->numElements; i++) {
+    if (!encoded->hasNulls || encoded->notNull[i]) {
+      encoded->dictionary->getValueByIndex(
+        encoded->index[i], encoded->data[i], encoded->length[i]);
+    }
+  }
+}
+
+StripeScan::StripeScan(const orc::Reader& reader, const ScanOptions& scan)
+  : batchSize(scan.BatchSize())
+  , threads(std::max<uint64_t>(1, scan.parallel))
+  , where(scan.where)
+  , offset(scan.offset)
+  , limit(scan.limit)
+{
+  const uint64_t stripes = reader.getNumberOfStripes();
+  const bool sliced =
+    offset > 0 || limit != std::numeric_limits<uint64_t>::max();
+  const uint64_t parts =
+    sliced ? 1
+           : std::max<uint64_t>(1, std::min<uint64_t>(scan.parallel, stripes));
+  // the first range starts at the file header and the last one runs to the
+  // end of the file, a stripe belongs to the range its offset falls in
+  uint64_t begin = 0;
+  uint64_t stripe = 0;
+  for (uint64_t part = 1; part <= parts; part++) {
+    const uint64_t last = part * stripes / parts;
+    uint64_t rows = 0;
+    for (; stripe < last; stripe++) {
+      rows += reader.getStripe(stripe)->getNumberOfRows();
+    }
+    uint64_t end = std::numeric_limits<uint64_t>::max();
+    if (part < parts) {
+      end = reader.getStripe(last)->getOffset();
+    }
+    ranges.emplace_back(StripeRange{ begin, end - begin, rows });
+    begin = end;
+  }
+  if (sliced && !where) {
+    const uint64_t rows = ranges[0].rows;
+    ranges[0].rows = offset < rows ? std::min(limit, rows - offset) : 0;
+  }
+  CreateRowReaders(reader, scan);
+}
+StripeScan::StripeScan(const orc::Reader& reader,
+                       const ScanOptions& scan,
+                       const vector<uint64_t>& stripes)
+  : batchSize(std::max<uint64_t>(1, scan.chunkSize))
+  , threads(std::max<uint64_t>(1, scan.parallel))
+  , where(scan.where)
+  , offset(0)
+  , limit(std::numeric_limits<uint64_t>::max())
+{
+  for (size_t i = 0; i < stripes.size(); i++) {
+    unique_ptr<StripeInformation> stripe = reader.getStripe(stripes[i]);
+    const uint64_t end = stripe->getOffset() + stripe->getLength();
+    if (i > 0 && stripes[i] == stripes[i - 1] + 1) {
+      ranges.back().length = end - ranges.back().offset;
+      ranges.back().rows += stripe->getNumberOfRows();
+    } else {
+      ranges.emplace_back(StripeRange{ stripe->getOffset(),
+                                       stripe->getLength(),
+                                       stripe->getNumberOfRows() });
+    }
+  }
+  CreateRowReaders(reader, scan);
+}
+void
+StripeScan::CreateRowReaders(const orc::Reader& reader, const ScanOptions& scan)
+{
+  for (auto& range : ranges) {
+    orc::RowReaderOptions options = scan.ToRowReaderOptions();
+    options.range(range.offset, range.length);
+    rowReaders.emplace_back(reader.createRowReader(options));
+  }
+}
+const orc::Type&
+StripeScan::SelectedType() const
+{
+  return rowReaders[0]->getSelectedType();
+}
+uint64_t
+StripeScan::RowNumber(size_t range) const
+{
+  return rowReaders[range]->getRowNumber();
+}
+void
+StripeScan::Run(const Visitor& visit, const Finished& finished)
+{
+  failed = false;
+  std::mutex lock;
+  string error;
+  auto decode = [&](size_t range) {
+    try {
+      RowReader& row = *rowReaders[range];
+      unique_ptr<ColumnVectorBatch> batch = row.createRowBatch(batchSize);
+      uint64_t remaining = limit;
+      if (where) {
+        // offset and limit count the rows that match, which are only known
+        // once decoded
+        Filter filter(*where, row.getSelectedType());
+        Selection selection;
+        uint64_t skip = offset;
+        while (remaining > 0 && !failed && row.next(*batch)) {
+          ResolveDictionaries(*batch);
+          filter.Select(*batch, selection);
+          const uint64_t skipped =
+            std::min<uint64_t>(skip, selection.rows.size());
+          if (skip > 0 || selection.rows.size() - skipped > remaining) {
+            selection.Slice(skipped, skipped + remaining);
+            skip -= skipped;
+          }
+          if (selection.rows.empty()) {
+            continue;
+          }
+          remaining -= selection.rows.size();
+          visit(range, *batch, &selection);
+        }
+      } else {
+        if (offset > 0) {
+          row.seekToRow(offset);
+        }
+        while (remaining > 0 && !failed && row.next(*batch)) {
+          if (batch->numElements > remaining) {
+            TruncateBatch(*batch, remaining);
+          }
+          remaining -= batch->numElements;
+          visit(range, *batch, nullptr);
+        }
+      }
+      if (!failed && finished) {
+        finished(range);
+      }
+    } catch (std::exception& ex) {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!failed.exchange(true)) {
+          error = ex.what();
+        }
+      }
+      if (finished) {
+        finished(range);
+      }
+    }
+  };
+  // every thread takes the next range that is not decoded yet
+  std::atomic<size_t> next{ 0 };
+  auto work = [&]() {
+    for (size_t range = next++; range < ranges.size(); range = next++) {
+      decode(range);
+    }
+  };
+  vector<std::thread> pool;
+  const uint64_t size = std::min<uint64_t>(threads, ranges.size());
+  for (uint64_t i = 1; i < size; i++) {
+    pool.emplace_back(work);
+  }
+  work();
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  if (failed) {
+    throw std::runtime_error(error);
+  }
+}
+}
@@ -0,0 +1,138 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NORC_STRIPESCAN_H
+#define NORC_STRIPESCAN_H
+
+#include "Filter.h"
+#include "Reader.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <orc/OrcFile.hh>
+#include <vector>
+
+using std::unique_ptr;
+using std::vector;
+
+namespace norc {
+
+/**
+ * A contiguous run of stripes, as the byte range passed to
+ * RowReaderOptions::range.
+ */
+struct StripeRange
+{
+  uint64_t offset;
+  uint64_t length;
+  uint64_t rows;
+};
+
+/**
+ * Set the number of rows of a struct batch and its fields, used to drop the
+ * rows of the last batch that are past the limit of a scan.
+ */
+void
+TruncateBatch(orc::ColumnVectorBatch&, uint64_t rows);
+
+/**
+ * Point data and length of the dictionary encoded strings of a struct batch
+ * at their dictionary entries, for the code that reads every string batch as
+ * plain strings (the Filter of a where). The codes are left in place.
+ */
+void
+ResolveDictionaries(orc::ColumnVectorBatch&);
+
+/**
+ * Scan of a file split into scan.parallel ranges of whole stripes, each range
+ * is decoded by its own RowReader on its own thread. A scan with an offset or
+ * a limit is always a single range, it seeks to the row group holding
+ * scan.offset and stops decoding once scan.limit rows were visited.
+ *
+ * With a where, every batch goes through a Filter and only batches with
+ * matching rows are visited, along with their Selection. The offset and the
+ * limit then count matching rows, the scan cannot seek.
+ *
+ * The row readers are all created by the constructor, usually on a worker
+ * thread while other workers use the same orc::Reader. That is safe when the
+ * reader comes from Reader::ScanFile: a scan with a where makes orc read the
+ * stripe statistics, the only state orc::Reader fills lazily, and ScanFile
+ * loads them once under a lock first. Creating a row reader then only reads
+ * the parsed footer, and row readers share the input stream through
+ * positional reads.
+ */
+class StripeScan
+{
+public:
+  /**
+   * Called from the thread decoding the range, batches of the same range are
+   * visited in file order. selection is null when every row of the batch is
+   * part of the scan.
+   */
+  using Visitor = std::function<void(size_t range,
+                                     const orc::ColumnVectorBatch& batch,
+                                     const Selection* selection)>;
+  /**
+   * Called once a range is done, also when it stopped on an error.
+   */
+  using Finished = std::function<void(size_t range)>;
+
+  StripeScan(const orc::Reader&, const ScanOptions&);
+  /**
+   * Scan of the listed stripes only, in increasing order, with one range per
+   * run of consecutive stripes. The offset and limit of the scan are not
+   * applied.
+   */
+  StripeScan(const orc::Reader&,
+             const ScanOptions&,
+             const vector<uint64_t>& stripes);
+  size_t Size() const { return ranges.size(); }
+  const StripeRange& Range(size_t range) const { return ranges[range]; }
+  const orc::Type& SelectedType() const;
+  /**
+   * Row number in the file of the first row of the batch a range last
+   * visited, only valid from within the visitor of that range.
+   */
+  uint64_t RowNumber(size_t range) const;
+  /**
+   * Decode every range, returns once all of them are exhausted. At most
+   * scan.parallel ranges are decoded at the same time. The first error stops
+   * the remaining ranges and is rethrown as a runtime_error.
+   */
+  void Run(const Visitor& visit, const Finished& finished = nullptr);
+  /**
+   * True once a range of the running scan failed, the other ranges stop at
+   * their next batch.
+   */
+  bool Failed() const { return failed; }
+
+private:
+  void CreateRowReaders(const orc::Reader&, const ScanOptions&);
+
+  uint64_t batchSize;
+  uint64_t threads;
+  shared_ptr<const Predicate> where;
+  uint64_t offset;
+  uint64_t limit;
+  vector<StripeRange> ranges;
+  vector<unique_ptr<orc::RowReader>> rowReaders;
+  std::atomic<bool> failed{ false };
+};
+}
+
+#endif // NORC_STRIPESCAN_H
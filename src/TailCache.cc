@@ -0,0 +1,96 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "TailCache.h"
+
+using std::lock_guard;
+using std::mutex;
+
+namespace norc {
+
+TailCache&
+TailCache::Instance()
+{
+  static TailCache cache;
+  return cache;
+}
+string
+TailCache::Key(const string& path, const struct stat& st)
+{
+  if (!S_ISREG(st.st_mode)) {
+    return "";
+  }
+  return path + '\0' + std::to_string(st.st_mtim.tv_sec) + '.' +
+         std::to_string(st.st_mtim.tv_nsec) + '\0' +
+         std::to_string(st.st_size);
+}
+bool
+TailCache::Get(const string& key, string& tail)
+{
+  lock_guard<mutex> guard(lock);
+  auto entry = index.find(key);
+  if (entry == index.end()) {
+    return false;
+  }
+  entries.splice(entries.begin(), entries, entry->second);
+  tail = entry->second->second;
+  return true;
+}
+void
+TailCache::Put(const string& key, string tail)
+{
+  lock_guard<mutex> guard(lock);
+  if (tail.size() > capacity) {
+    return;
+  }
+  auto entry = index.find(key);
+  if (entry != index.end()) {
+    used -= entry->second->second.size();
+    entries.erase(entry->second);
+    index.erase(entry);
+  }
+  used += tail.size();
+  entries.emplace_front(key, std::move(tail));
+  index[key] = entries.begin();
+  Evict();
+}
+void
+TailCache::SetCapacity(uint64_t bytes)
+{
+  lock_guard<mutex> guard(lock);
+  capacity = bytes;
+  Evict();
+}
+void
+TailCache::Clear()
+{
+  lock_guard<mutex> guard(lock);
+  entries.clear();
+  index.clear();
+  used = 0;
+}
+void
+TailCache::Evict()
+{
+  while (used > capacity && !entries.empty()) {
+    used -= entries.back().second.size();
+    index.erase(entries.back().first);
+    entries.pop_back();
+  }
+}
+}
@@ -0,0 +1,72 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NORC_TAILCACHE_H
+#define NORC_TAILCACHE_H
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+
+using std::list;
+using std::string;
+
+namespace norc {
+
+/**
+ * Process wide LRU cache of serialized file tails (postscript and footer, as
+ * returned by orc::Reader::getSerializedFileTail). Opening a cached file hands
+ * the tail to orc::ReaderOptions::setSerializedFileTail instead of reading it
+ * from disk again, orc still parses it. The file metadata (stripe statistics)
+ * is not part of the tail and is still read from the file.
+ *
+ * Entries are keyed by path, modification time and size so a rewritten file
+ * is never served a stale tail. The least recently used tails are evicted
+ * once the total size exceeds the byte budget.
+ */
+class TailCache
+{
+public:
+  static const uint64_t DEFAULT_CAPACITY = 32 * 1024 * 1024;
+  static TailCache& Instance();
+  /**
+   * Cache key of a local file from the fstat of the descriptor it was opened
+   * with, so a file replaced after its path was resolved gets its own key.
+   * Empty when st is not a regular file.
+   */
+  static string Key(const string& path, const struct stat& st);
+  bool Get(const string& key, string& tail);
+  void Put(const string& key, string tail);
+  void SetCapacity(uint64_t bytes);
+  void Clear();
+
+private:
+  void Evict();
+
+  std::mutex lock;
+  uint64_t capacity = DEFAULT_CAPACITY;
+  uint64_t used = 0;
+  // most recently used first
+  list<std::pair<string, string>> entries;
+  std::unordered_map<string, list<std::pair<string, string>>::iterator> index;
+};
+}
+
+#endif // NORC_TAILCACHE_H
@@ -0,0 +1,440 @@
+/**
+ * This file is part of the norc (R) project.
+ * Copyright (c) 2017-2018
+ * Authors: Cory Mickelson, et al.
+ *
+ * norc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * norc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ColumnBuffer.h"
+#include "Reader.h"
+#include "StripeScan.h"
+#include "ValidateArguments.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+using namespace Napi;
+using namespace orc;
+
+using std::make_unique;
+using std::numeric_limits;
+using std::pair;
+using std::string_view;
+
+namespace norc {
+
+/**
+ * The k first values of a column in the requested order along with the row
+ * numbers they were seen at. The entries are a binary heap with the last of
+ * them on top, so a value that does not rank before the top is rejected with
+ * a single comparison and nothing is copied.
+ */
+template<typename T>
+class BoundedHeap
+{
+public:
+  BoundedHeap(uint64_t k, bool descending)
+    : k(k)
+    , descending(descending)
+  {}
+  /**
+   * Offer the value of a row, V is T or a view that T is constructed from.
+   */
+  template<typename V>
+  void Offer(const V& value, uint64_t row)
+  {
+    if (entries.size() < k) {
+      entries.emplace_back(T(value), row);
+      std::push_heap(entries.begin(), entries.end(), Order());
+    } else if (k > 0 &&
+               Before(value, row, entries[0].first, entries[0].second)) {
+      std::pop_heap(entries.begin(), entries.end(), Order());
+      entries.back() = Entry(T(value), row);
+      std::push_heap(entries.begin(), entries.end(), Order());
+    }
+  }
+  void Merge(const BoundedHeap& other)
+  {
+    for (auto& entry : other.entries) {
+      Offer(entry.first, entry.second);
+    }
+  }
+  /**
+   * Row numbers of the entries, first ranked first.
+   */
+  vector<uint64_t> Rows()
+  {
+    std::sort_heap(entries.begin(), entries.end(), Order());
+    vector<uint64_t> rows;
+    for (auto& entry : entries) {
+      rows.emplace_back(entry.second);
+    }
+    return rows;
+  }
+
+private:
+  using Entry = pair<T, uint64_t>;
+
+  /**
+   * Whether a value ranks before another, equal values rank in file order.
+   */
+  template<typename A, typename B>
+  bool Before(const A& a, uint64_t rowA, const B& b, uint64_t rowB) const
+  {
+    if (a == b) {
+      return rowA < rowB;
+    }
+    return descending ? b < a : a < b;
+  }
+  auto Order() const
+  {
+    return [this](const Entry& a, const Entry& b) {
+      return Before(a.first, a.second, b.first, b.second);
+    };
+  }
+
+  uint64_t k;
+  bool descending;
+  vector<Entry> entries;
+};
+
+class TopKWorker : public AsyncWorker
+{
+public:
+  TopKWorker(Function& cb,
+             Napi::Value self,
+             NorcColumnMetadata column,
+             uint64_t k,
+             bool descending,
+             ScanOptions scan)
+    : AsyncWorker(cb, "top_k_worker", self.As<Object>())
+    , reader(Reader::Unwrap(self.As<Object>()))
+    , column(std::move(column))
+    , k(k)
+    , descending(descending)
+    , scan(std::move(scan))
+  {}
+
+protected:
+  void Execute() override
+  {
+    try {
+      const orc::Reader& file = *reader->reader;
+      // the first pass only decodes the ordered column and the columns of
+      // the where option
+      ScanOptions ranking = scan;
+      ranking.includes = { column.index };
+      ranking.hidden.clear();
+      if (ranking.where) {
+        ranking.where->CollectFields(ranking.includes);
+      }
+      StripeScan scanner(reader->ScanFile(ranking), ranking);
+      const orc::Type& selected = scanner.SelectedType();
+      size_t position = 0;
+      while (selected.getFieldName(position) != column.title) {
+        position++;
+      }
+      vector<uint64_t> ranked = Rank(scanner, position);
+      if (!ranked.empty()) {
+        Fetch(file, ranked);
+      }
+    } catch (std::exception& ex) {
+      SetError(ex.what());
+    }
+  }
+  void OnOK() override
+  {
+    auto env = Env();
+    auto out = Array::New(env, order.size());
+    if (rows) {
+      auto keys = rows->Keys(env);
+      for (uint32_t i = 0; i < order.size(); i++) {
+        out.Set(i, rows->Row(env, order[i], keys));
+      }
+    }
+    Callback().Call({ env.Null(), out });
+  }
+
+private:
+  Reader* reader;
+  NorcColumnMetadata column;
+  uint64_t k;
+  bool descending;
+  ScanOptions scan;
+  unique_ptr<RowBuffer> rows;
+  // position in rows of the i-th ranked row
+  vector<uint64_t> order;
+
+  /**
+   * Row numbers of the first k rows in order, nulls and NaN are left out.
+   */
+  vector<uint64_t> Rank(StripeScan& scanner, size_t position)
+  {
+    switch (column.type) {
+      case TypeKind::BOOLEAN:
+      case TypeKind::BYTE:
+      case TypeKind::SHORT:
+      case TypeKind::INT:
+      case TypeKind::LONG:
+      case TypeKind::DATE:
+        return Collect<int64_t>(
+          scanner,
+          position,
+          [](const ColumnVectorBatch& batch, uint64_t row, int64_t& value) {
+            value = static_cast<const LongVectorBatch&>(batch).data[row];
+            return true;
+          });
+      case TypeKind::FLOAT:
+      case TypeKind::DOUBLE:
+        return Collect<double>(
+          scanner,
+          position,
+          [](const ColumnVectorBatch& batch, uint64_t row, double& value) {
+            value = static_cast<const DoubleVectorBatch&>(batch).data[row];
+            return !std::isnan(value);
+          });
+      case TypeKind::DECIMAL: {
+        const orc::Type* type =
+          reader->reader->getType().getSubtype(column.index);
+        if (type->getPrecision() != 0 && type->getPrecision() <= 18) {
+          // the scale is the same for every value, unscaled values order the
+          // same way
+          return Collect<int64_t>(
+            scanner,
+            position,
+            [](const ColumnVectorBatch& batch, uint64_t row, int64_t& value) {
+              value =
+                static_cast<const Decimal64VectorBatch&>(batch).values[row];
+              return true;
+            });
+        }
+        return Collect<double>(
+          scanner,
+          position,
+          [](const ColumnVectorBatch& batch, uint64_t row, double& value) {
+            auto& d128 = static_cast<const Decimal128VectorBatch&>(batch);
+            value = strtod(
+              d128.values[row].toDecimalString(d128.scale).c_str(), nullptr);
+            return true;
+          });
+      }
+      case TypeKind::TIMESTAMP:
+        return Collect<pair<int64_t, int64_t>>(
+          scanner,
+          position,
+          [](const ColumnVectorBatch& batch,
+             uint64_t row,
+             pair<int64_t, int64_t>& value) {
+            auto& ts = static_cast<const TimestampVectorBatch&>(batch);
+            value = { ts.data[row], ts.nanoseconds[row] };
+            return true;
+          });
+      default:
+        // STRING, VARCHAR and CHAR are compared by their bytes, only copied
+        // once they enter the heap
+        return Collect<string, string_view>(
+          scanner,
+          position,
+          [](const ColumnVectorBatch& batch,
+             uint64_t row,
+             string_view& value) {
+            auto& strings = static_cast<const StringVectorBatch&>(batch);
+            value = string_view(strings.data[row],
+                                static_cast<size_t>(strings.length[row]));
+            return true;
+          });
+    }
+  }
+  /**
+   * Every range offers its rows to its own heap, the heaps are merged once
+   * the scan is done. read(batch, row, value) sets the value of a non null
+   * row and returns false for values that cannot be ordered.
+   */
+  template<typename T, typename V = T, typename Read>
+  vector<uint64_t> Collect(StripeScan& scanner, size_t position, Read read)
+  {
+    vector<BoundedHeap<T>> heaps(scanner.Size(),
+                                 BoundedHeap<T>(k, descending));
+    scanner.Run([&](size_t range,
+                    const ColumnVectorBatch& batch,
+                    const Selection* selection) {
+      auto& field =
+        *dynamic_cast<const StructVectorBatch&>(batch).fields[position];
+      const char* present = field.hasNulls ? field.notNull.data() : nullptr;
+      const uint64_t first = scanner.RowNumber(range);
+      BoundedHeap<T>& heap = heaps[range];
+      V value;
+      auto offer = [&](uint64_t row) {
+        if ((!present || present[row]) && read(field, row, value)) {
+          heap.Offer(value, first + row);
+        }
+      };
+      if (selection != nullptr) {
+        for (auto row : selection->rows) {
+          offer(row);
+        }
+      } else {
+        for (uint64_t row = 0; row < field.numElements; row++) {
+          offer(row);
+        }
+      }
+    });
+    BoundedHeap<T> merged(k, descending);
+    for (auto& heap : heaps) {
+      merged.Merge(heap);
+    }
+    return merged.Rows();
+  }
+  /**
+   * Decode the projected columns of the ranked rows only. The rows are read
+   * in file order, seeking to the row group of a row unless it is close
+   * enough to be reached by reading on.
+   */
+  void Fetch(const orc::Reader& file, const vector<uint64_t>& ranked)
+  {
+    // the columns only listed for the where option are not needed anymore
+    ScanOptions projection = scan;
+    projection.where.reset();
+    projection.includes.remove_if([this](uint64_t field) {
+      const string& title = reader->fileMeta[field].title;
+      return std::find(scan.hidden.begin(), scan.hidden.end(), title) !=
+             scan.hidden.end();
+    });
+    unique_ptr<RowReader> row =
+      file.createRowReader(projection.ToRowReaderOptions());
+    rows = make_unique<RowBuffer>(row->getSelectedType());
+    vector<uint64_t> sorted(ranked);
+    std::sort(sorted.begin(), sorted.end());
+    const uint64_t stride = std::max<uint64_t>(file.getRowIndexStride(), 1);
+    unique_ptr<ColumnVectorBatch> batch =
+      row->createRowBatch(std::min<uint64_t>(scan.chunkSize, stride));
+    Selection selection;
+    uint64_t next = 0;
+    bool positioned = false;
+    for (size_t i = 0; i < sorted.size();) {
+      if (!positioned || sorted[i] < next || sorted[i] - next >= stride) {
+        row->seekToRow(sorted[i]);
+        next = sorted[i];
+        positioned = true;
+      }
+      if (!row->next(*batch)) {
+        break;
+      }
+      selection.rows.clear();
+      while (i < sorted.size() && sorted[i] < next + batch->numElements) {
+        selection.rows.emplace_back(static_cast<uint32_t>(sorted[i] - next));
+        i++;
+      }
+      next += batch->numElements;
+      if (!selection.rows.empty()) {
+        rows->Append(*batch, &selection);
+      }
+    }
+    std::unordered_map<uint64_t, uint64_t> fetched;
+    for (size_t i = 0; i < sorted.size(); i++) {
+      fetched.emplace(sorted[i], i);
+    }
+    for (auto rowNumber : ranked) {
+      order.emplace_back(fetched[rowNumber]);
+    }
+  }
+};
+
+void
+Reader::TopK(const CallbackInfo& info)
+{
+  AssertCallbackInfo(info,
+                     { { 0, { option(napi_object) } },
+                       { 1, { option(napi_function) } } });
+  if (info.Env().IsExceptionPending()) {
+    return;
+  }
+  auto env = info.Env();
+  auto options = info[0].As<Object>();
+  auto cb = info[1].As<Function>();
+  if (!options.Has("column") || !options.Get("column").IsString()) {
+    TypeError::New(env, "column must be a column title")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  list<uint64_t> field;
+  auto title = Array::New(env, 1);
+  title.Set(0u, options.Get("column"));
+  if (!ResolveColumns(env, title, field)) {
+    return;
+  }
+  const NorcColumnMetadata& column = fileMeta[field.front()];
+  switch (column.type) {
+    case TypeKind::BOOLEAN:
+    case TypeKind::BYTE:
+    case TypeKind::SHORT:
+    case TypeKind::INT:
+    case TypeKind::LONG:
+    case TypeKind::DATE:
+    case TypeKind::FLOAT:
+    case TypeKind::DOUBLE:
+    case TypeKind::DECIMAL:
+    case TypeKind::TIMESTAMP:
+    case TypeKind::STRING:
+    case TypeKind::VARCHAR:
+    case TypeKind::CHAR:
+      break;
+    default:
+      TypeError::New(env,
+                     "Cannot order by column " + column.title + " of type " +
+                       reader->getType().getSubtype(column.index)->toString())
+        .ThrowAsJavaScriptException();
+      return;
+  }
+  int64_t k = 0;
+  if (options.Has("k")) {
+    k = options.Get("k").As<Number>().Int64Value();
+  }
+  if (k < 0) {
+    RangeError::New(env, "k must not be negative")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  bool descending = true;
+  if (options.Has("order")) {
+    string order = options.Get("order").ToString();
+    if (order != "asc" && order != "desc") {
+      RangeError::New(env, "order must be asc or desc")
+        .ThrowAsJavaScriptException();
+      return;
+    }
+    descending = order == "desc";
+  }
+  ScanOptions scan;
+  if (!ParseScanOptions(env, options, scan)) {
+    return;
+  }
+  if (scan.offset > 0 || scan.limit != numeric_limits<uint64_t>::max()) {
+    RangeError::New(env, "topK does not support offset and limit")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  auto worker = new TopKWorker(cb,
+                               info.This(),
+                               column,
+                               static_cast<uint64_t>(k),
+                               descending,
+                               std::move(scan));
+  worker->Queue();
+}
+}
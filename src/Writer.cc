@@ -17,6 +17,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "Writer.h"
+#include "Appender.h"
+#include "ColumnBuffer.h"
 #include "Internal.h"
 #include "MemoryFile.h"
 #include "ValidateArguments.h"
@@ -26,8 +28,9 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <orc/ColumnPrinter.hh>
+#include <set>
 #include <sstream>
+#include <stdexcept>
 #include <utility>
 
 #define NAPI_EXPERIMENTAL
@@ -59,9 +62,16 @@ Writer::Initialize(Napi::Env& env, Napi::Object& target)
   auto ctor = DefineClass(env,
                           "Writer",
                           { InstanceMethod("close", &norc::Writer::Close),
+                            InstanceMethod("closeSync",
+                                           &norc::Writer::CloseSync),
+                            InstanceMethod("flush", &norc::Writer::Flush),
                             InstanceMethod("schema", &norc::Writer::Schema),
                             InstanceMethod("fromCsv", &norc::Writer::ImportCSV),
                             InstanceMethod("add", &norc::Writer::Add),
+                            InstanceMethod("addRow", &norc::Writer::AddRow),
+                            InstanceMethod("addRows", &norc::Writer::AddRows),
+                            InstanceMethod("addColumns",
+                                           &norc::Writer::AddColumns),
                             InstanceMethod("data", &norc::Writer::Data),
                             InstanceMethod("merge", &norc::Writer::Merge) });
   constructor = Napi::Persistent(ctor);
@@ -72,7 +82,6 @@ Writer::Initialize(Napi::Env& env, Napi::Object& target)
 Writer::Writer(const CallbackInfo& info)
   : ObjectWrap(info)
 {
-  buffer = make_unique<DataBuffer<char>>(*getDefaultPool(), 4 * 1024 * 1024);
   options.setStripeSize((128 << 20));
   options.setCompressionBlockSize((64 << 10));
   options.setCompression(CompressionKind_ZLIB);
@@ -87,10 +96,18 @@ Writer::Writer(const CallbackInfo& info)
 void
 Writer::Schema(const CallbackInfo& info)
 {
-  if (info.Length() == 1 && info[0].IsString()) {
+  if (!EnsureOpen(info.Env())) {
+    return;
+  }
+  if (info.Length() >= 1 && info[0].IsString()) {
     string schema = info[0].As<String>();
     type = Type::buildTypeFromString(schema);
+    if (!ApplySchemaOptions(info)) {
+      return;
+    }
     writer = createWriter(*type, output.get(), options);
+    encoder = make_unique<BatchEncoder>(*writer, batchSize);
+    CompileRowPlan(info.Env());
     return;
   }
   if (info.Length() < 1 || !info[0].IsObject()) {
@@ -195,113 +212,349 @@ Writer::Schema(const CallbackInfo& info)
   typeStr << ">";
   cout << "Setting File Schema as: " << typeStr.str() << endl;
   type = Type::buildTypeFromString(typeStr.str());
+  if (!ApplySchemaOptions(info)) {
+    return;
+  }
   writer = createWriter(*type, output.get(), options);
-  batch = writer->createRowBatch(batchSize);
+  encoder = make_unique<BatchEncoder>(*writer, batchSize);
+  CompileRowPlan(info.Env());
+}
+bool
+Writer::ApplySchemaOptions(const CallbackInfo& info)
+{
+  if (info.Length() < 2 || !info[1].IsObject()) {
+    return true;
+  }
+  auto opts = info[1].As<Object>();
+  if (opts.Has("bloomFilter")) {
+    if (!opts.Get("bloomFilter").IsArray()) {
+      TypeError::New(info.Env(), "bloomFilter must be an array of columns")
+        .ThrowAsJavaScriptException();
+      return false;
+    }
+    auto columns = opts.Get("bloomFilter").As<Array>();
+    std::set<uint64_t> ids;
+    for (uint32_t i = 0; i < columns.Length(); i++) {
+      string title = columns.Get(i).ToString();
+      bool match = false;
+      for (uint64_t j = 0; j < type->getSubtypeCount(); j++) {
+        if (type->getFieldName(j) == title) {
+          ids.insert(type->getSubtype(j)->getColumnId());
+          match = true;
+          break;
+        }
+      }
+      if (!match) {
+        Error::New(info.Env(), title + " not a valid column header")
+          .ThrowAsJavaScriptException();
+        return false;
+      }
+    }
+    options.setColumnsUseBloomFilter(ids);
+  }
+  if (opts.Has("bloomFilterFpp")) {
+    options.setBloomFilterFPP(opts.Get("bloomFilterFpp").ToNumber());
+  }
+  return true;
 }
 
+void
+Writer::CompileRowPlan(Napi::Env env)
+{
+  if (schema.empty()) {
+    for (uint64_t i = 0; i < type->getSubtypeCount(); i++) {
+      schema.emplace_back(type->getFieldName(i),
+                          type->getSubtype(i)->getKind());
+    }
+  }
+  keys.clear();
+  for (auto& column : schema) {
+    keys.emplace_back(Persistent(String::New(env, column.first)));
+  }
+}
+vector<napi_value>
+Writer::Keys() const
+{
+  vector<napi_value> values;
+  values.reserve(keys.size());
+  for (auto& key : keys) {
+    values.emplace_back(key.Value());
+  }
+  return values;
+}
+template<typename Get>
+bool
+Writer::AppendRows(Napi::Env env, uint64_t count, Get get)
+{
+  for (uint64_t done = 0; done < count;) {
+    if (batchOffset == batchSize && !FlushRows(env)) {
+      return false;
+    }
+    auto& fields = static_cast<StructVectorBatch&>(encoder->Batch()).fields;
+    uint64_t n = std::min(count - done, batchSize - batchOffset);
+    // an invalid value cuts n to the rows before it, the later columns are
+    // only filled that far, so the rows before the first invalid one are kept
+    size_t invalid = fields.size();
+    bool missing = false;
+    for (size_t column = 0; column < fields.size(); column++) {
+      bool absent = false;
+      auto fill = [&](auto& appender) {
+        for (uint64_t i = 0; i < n; i++) {
+          Napi::Value value = get(done + i, column);
+          if (value.IsEmpty()) {
+            n = i;
+            absent = true;
+            return false;
+          }
+          if (IsNullValue(value)) {
+            appender.SetNull(batchOffset + i);
+          } else if (!appender.Set(batchOffset + i, value)) {
+            n = i;
+            return false;
+          }
+        }
+        return true;
+      };
+      try {
+        if (!VisitAppender(*type->getSubtype(column),
+                           *fields[column],
+                           encoder->Strings(),
+                           fill)) {
+          invalid = column;
+          missing = absent;
+        }
+      } catch (std::invalid_argument& ex) {
+        Error::New(env, ex.what()).ThrowAsJavaScriptException();
+        return false;
+      }
+    }
+    batchOffset += n;
+    done += n;
+    if (invalid < fields.size()) {
+      const string reason =
+        missing ? "Missing property: " : "Invalid value for column ";
+      TypeError::New(env, reason + schema[invalid].first)
+        .ThrowAsJavaScriptException();
+      return false;
+    }
+  }
+  return true;
+}
 void
 Writer::Add(const CallbackInfo& info)
 {
+  if (!EnsureOpen(info.Env())) {
+    return;
+  }
+  if (!writer) {
+    Error::New(info.Env(), "A schema must be defined before adding rows")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  vector<Object> rows;
   if (info.Length() > 0 && info[0].IsArray()) {
     auto chunk = info[0].As<Array>();
-    for (unsigned int i = 0; i < chunk.Length(); i++) {
-      AddObject(info, chunk.Get(static_cast<uint32_t>(i)).As<Object>());
+    rows.reserve(chunk.Length());
+    for (uint32_t i = 0; i < chunk.Length(); i++) {
+      Napi::Value row = chunk.Get(i);
+      if (!row.IsObject()) {
+        TypeError::New(info.Env(), "A row must be an object")
+          .ThrowAsJavaScriptException();
+        return;
+      }
+      rows.emplace_back(row.As<Object>());
     }
   } else if (info.Length() > 0 && info[0].IsObject()) {
-    AddObject(info, info[0].As<Object>());
+    rows.emplace_back(info[0].As<Object>());
   }
+  auto names = Keys();
+  AppendRows(info.Env(), rows.size(), [&](uint64_t row, size_t column) {
+    Napi::Value value = rows[row].Get(names[column]);
+    // a missing key is told apart from an undefined value on that path only
+    if (value.IsUndefined() && !rows[row].Has(names[column])) {
+      return Napi::Value();
+    }
+    return value;
+  });
 }
 void
-Writer::AddObject(const CallbackInfo& info, Object value)
+Writer::AddRow(const CallbackInfo& info)
 {
-  auto properties = value.GetPropertyNames();
-  auto row = dynamic_cast<StructVectorBatch*>(batch.get());
-  if (properties.Length() != schema.size()) {
-    Error::New(info.Env(), "Item does not match schema")
+  if (!EnsureOpen(info.Env())) {
+    return;
+  }
+  if (!writer) {
+    Error::New(info.Env(), "A schema must be defined before adding rows")
       .ThrowAsJavaScriptException();
     return;
   }
-  if (batchOffset == batchSize - 1) {
-    row->numElements = batchOffset;
-    writer->add(*batch);
-    batchOffset = 0;
+  if (info.Length() < 1 || !info[0].IsArray()) {
+    TypeError::New(info.Env(), "A row must be an array of column values")
+      .ThrowAsJavaScriptException();
+    return;
   }
-  for (uint32_t i = 0; i < properties.Length(); i++) {
-    string p = properties.Get(i).As<String>();
-    unsigned int idx = 0;
-    for (; idx < schema.size(); idx++) {
-      if (schema[idx].first == p) {
-        break;
-      }
-      if (idx == schema.size() - 1) {
-        TypeError::New(info.Env(), "Missing property: " + p)
-          .ThrowAsJavaScriptException();
-        return;
-      }
+  auto values = info[0].As<Array>();
+  if (values.Length() != schema.size()) {
+    RangeError::New(info.Env(), "Item does not match schema")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  AppendRows(info.Env(), 1, [&](uint64_t, size_t column) {
+    return values.Get(static_cast<uint32_t>(column));
+  });
+}
+void
+Writer::AddRows(const CallbackInfo& info)
+{
+  if (!EnsureOpen(info.Env())) {
+    return;
+  }
+  if (!writer) {
+    Error::New(info.Env(), "A schema must be defined before adding rows")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  if (info.Length() < 1 || !info[0].IsArray()) {
+    TypeError::New(info.Env(), "rows must be an array of rows")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  auto chunk = info[0].As<Array>();
+  vector<Array> rows;
+  rows.reserve(chunk.Length());
+  for (uint32_t i = 0; i < chunk.Length(); i++) {
+    Napi::Value row = chunk.Get(i);
+    if (!row.IsArray()) {
+      TypeError::New(info.Env(), "A row must be an array of column values")
+        .ThrowAsJavaScriptException();
+      return;
     }
-    switch (schema[idx].second) {
-      case TypeKind::BYTE:
-      case TypeKind::INT:
-      case TypeKind::SHORT:
-      case TypeKind::LONG: {
-        AddNumberType(
-          info.Env(), row->fields[idx], batchOffset, value.Get(p));
-        break;
-      }
-      case TypeKind::VARCHAR:
-      case TypeKind::CHAR:
-      case TypeKind::STRING:
-      case TypeKind::BINARY: {
-        AddStringType(info.Env(), row->fields[idx], buffer.get(), batchOffset, &bufferOffset, value.Get(p));
-        break;
-      }
-
-      case TypeKind::BOOLEAN: {
-        AddBoolType(info.Env(), row->fields[idx], batchOffset, value.Get(p));
-        break;
-      }
-      case TypeKind::FLOAT:
-      case TypeKind::DOUBLE: {
-        AddFloatType(info.Env(), row->fields[idx], batchOffset, value.Get(p));
-        break;
-      }
-      case TypeKind::TIMESTAMP: {
-        AddTimeType(info.Env(), row->fields[idx], batchOffset, value.Get(p));
-        break;
-      }
-      case TypeKind::DECIMAL: {
-        AddDecimalType(info.Env(),row->fields[idx], type->getSubtype(static_cast<uint64_t>(idx)), batchOffset, idx, value.Get(p));
-        break;
-      }
-      case TypeKind::DATE: {
-        AddDateType(info.Env(), row->fields[idx], batchOffset, value.Get(p));
-        break;
-      }
-      case TypeKind::LIST:
-      case TypeKind::MAP:
-      case TypeKind::STRUCT:
-      case TypeKind::UNION: {
-        Error::New(
-          info.Env(),
-          "List, Map, Struct, and Union types are not currently supported")
-          .ThrowAsJavaScriptException();
-        break;
-      }
+    if (row.As<Array>().Length() != schema.size()) {
+      RangeError::New(info.Env(), "Item does not match schema")
+        .ThrowAsJavaScriptException();
+      return;
     }
+    rows.emplace_back(row.As<Array>());
   }
+  AppendRows(info.Env(), rows.size(), [&](uint64_t row, size_t column) {
+    return rows[row].Get(static_cast<uint32_t>(column));
+  });
+}
 
-  batchOffset++;
+bool
+Writer::EnsureOpen(Napi::Env env)
+{
+  if (closed) {
+    Error::New(env, "The writer is closed").ThrowAsJavaScriptException();
+    return false;
+  }
+  return true;
 }
+bool
+Writer::FlushRows(Napi::Env env)
+{
+  if (batchOffset == 0) {
+    return true;
+  }
+  SealBatch(encoder->Batch(), batchOffset);
+  batchOffset = 0;
+  if (!encoder->Submit()) {
+    Error::New(env, encoder->Failure()).ThrowAsJavaScriptException();
+    return false;
+  }
+  return true;
+}
+/**
+ * Waits for the encoder on a worker thread, then closes the file when close
+ * is set.
+ */
+class EncodeWorker : public AsyncWorker
+{
+public:
+  EncodeWorker(Function& cb, norc::Writer& self, bool close)
+    : AsyncWorker(self.Value(), cb)
+    , writer(self)
+    , close(close)
+  {}
+
+private:
+  Writer& writer;
+  bool close;
 
+protected:
+  void Execute() override
+  {
+    if (!(close ? writer.encoder->Close() : writer.encoder->Wait())) {
+      SetError(writer.encoder->Failure());
+    }
+  }
+};
 void
-Writer::Close(const CallbackInfo&)
+Writer::Flush(const CallbackInfo& info)
 {
-  if (batchOffset > 0) {
-    auto row = dynamic_cast<StructVectorBatch*>(batch.get());
-    row->numElements = batchOffset;
-    writer->add(*batch);
+  if (!EnsureOpen(info.Env())) {
+    return;
+  }
+  if (info.Length() < 1 || !info[0].IsFunction()) {
+    TypeError::New(info.Env(), "A callback is required")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  if (!writer) {
+    Error::New(info.Env(), "A schema must be defined before flushing")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  if (!FlushRows(info.Env())) {
+    return;
+  }
+  auto cb = info[0].As<Function>();
+  auto worker = new EncodeWorker(cb, *this, false);
+  worker->Queue();
+}
+void
+Writer::Close(const CallbackInfo& info)
+{
+  if (!EnsureOpen(info.Env())) {
+    return;
+  }
+  if (info.Length() < 1 || !info[0].IsFunction()) {
+    TypeError::New(info.Env(), "A callback is required")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  if (!writer) {
+    Error::New(info.Env(), "A schema must be defined before closing")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  // nothing can be added once close was called, even before it called back
+  closed = true;
+  if (!FlushRows(info.Env())) {
+    return;
+  }
+  auto cb = info[0].As<Function>();
+  auto worker = new EncodeWorker(cb, *this, true);
+  worker->Queue();
+}
+void
+Writer::CloseSync(const CallbackInfo& info)
+{
+  if (!EnsureOpen(info.Env())) {
+    return;
+  }
+  if (!writer) {
+    Error::New(info.Env(), "A schema must be defined before closing")
+      .ThrowAsJavaScriptException();
+    return;
+  }
+  closed = true;
+  if (!FlushRows(info.Env())) {
+    return;
+  }
+  if (!encoder->Close()) {
+    Error::New(info.Env(), encoder->Failure()).ThrowAsJavaScriptException();
   }
-  writer->close();
 }
 class ImportCSVWorker : public AsyncWorker
 {
@@ -328,212 +581,6 @@ private:
     }
     return col == idx ? v.substr(start, end - start) : "";
   }
-  void setLongTypeValue(const vector<string>& data,
-                        ColumnVectorBatch* batch,
-                        uint64_t valuesRead,
-                        uint64_t idx)
-  {
-    auto longBatch = dynamic_cast<LongVectorBatch*>(batch);
-    auto hasNull = false;
-    for (uint64_t i = 0; i < valuesRead; i++) {
-      string csvCol = columnString(data[i], idx);
-      if (csvCol.empty()) {
-        batch->notNull[i] = 0;
-        hasNull = true;
-      } else {
-        batch->notNull[i] = 1;
-        char* out;
-        longBatch->data[i] = strtoll(csvCol.c_str(), nullptr, 10);
-      }
-    }
-    longBatch->hasNulls = hasNull;
-    longBatch->numElements = valuesRead;
-  }
-
-  void setStringTypeValue(const vector<string>& data,
-                          ColumnVectorBatch* batch,
-                          uint64_t valuesRead,
-                          uint64_t idx,
-                          DataBuffer<char>& buffer,
-                          uint64_t& offset)
-  {
-    auto stringBatch = dynamic_cast<StringVectorBatch*>(batch);
-    bool hasNull = false;
-    for (uint64_t i = 0; i < valuesRead; i++) {
-      auto csvCol = columnString(data[i], idx);
-      if (csvCol.empty()) {
-        batch->notNull[i] = 0;
-        hasNull = true;
-      } else {
-        batch->notNull[i] = 1;
-        if (buffer.size() - offset < csvCol.size()) {
-          buffer.reserve(buffer.size() * 2);
-        }
-        memcpy(buffer.data() + offset, csvCol.c_str(), csvCol.size());
-        stringBatch->data[i] = buffer.data() + offset;
-        stringBatch->length[i] = static_cast<uint64_t>(csvCol.size());
-        offset += csvCol.size();
-      }
-    }
-    stringBatch->hasNulls = hasNull;
-    stringBatch->numElements = valuesRead;
-  }
-  void setDoubleTypeValues(const vector<string>& data,
-                           ColumnVectorBatch* batch,
-                           uint64_t numValues,
-                           uint64_t colIndex)
-  {
-    auto dblBatch = dynamic_cast<DoubleVectorBatch*>(batch);
-    bool hasNull = false;
-    for (uint64_t i = 0; i < numValues; ++i) {
-      std::string col = columnString(data[i], colIndex);
-      if (col.empty()) {
-        batch->notNull[i] = 0;
-        hasNull = true;
-      } else {
-        batch->notNull[i] = 1;
-        dblBatch->data[i] = strtod(col.c_str(), nullptr); // atof(col.c_str());
-      }
-    }
-    dblBatch->hasNulls = hasNull;
-    dblBatch->numElements = numValues;
-  }
-
-  // parse fixed point decimal numbers
-  void setDecimalTypeValue(const vector<string>& data,
-                           ColumnVectorBatch* batch,
-                           uint64_t numValues,
-                           uint64_t colIndex,
-                           size_t scale,
-                           size_t precision)
-  {
-
-    Decimal128VectorBatch* d128Batch = nullptr;
-    Decimal64VectorBatch* d64Batch = nullptr;
-    if (precision <= 18) {
-      d64Batch = dynamic_cast<Decimal64VectorBatch*>(batch);
-      d64Batch->scale = static_cast<int32_t>(scale);
-    } else {
-      d128Batch = dynamic_cast<Decimal128VectorBatch*>(batch);
-      d128Batch->scale = static_cast<int32_t>(scale);
-    }
-    bool hasNull = false;
-    for (uint64_t i = 0; i < numValues; ++i) {
-      string col = columnString(data[i], colIndex);
-      if (col.empty()) {
-        batch->notNull[i] = 0;
-        hasNull = true;
-      } else {
-        batch->notNull[i] = 1;
-        size_t ptPos = col.find('.');
-        size_t curScale = 0;
-        string num = col;
-        if (ptPos != string::npos) {
-          curScale = col.length() - ptPos - 1;
-          num = col.substr(0, ptPos) + col.substr(ptPos + 1);
-        }
-        Int128 decimal(num);
-        while (curScale != scale) {
-          curScale++;
-          decimal *= 10;
-        }
-        if (precision <= 18) {
-          d64Batch->values[i] = decimal.toLong();
-        } else {
-          d128Batch->values[i] = decimal;
-        }
-      }
-    }
-    batch->hasNulls = hasNull;
-    batch->numElements = numValues;
-  }
-
-  void setBoolTypeValue(const vector<string>& data,
-                        ColumnVectorBatch* batch,
-                        uint64_t numValues,
-                        uint64_t colIndex)
-  {
-    auto boolBatch = dynamic_cast<LongVectorBatch*>(batch);
-    bool hasNull = false;
-    for (uint64_t i = 0; i < numValues; ++i) {
-      string col = columnString(data[i], colIndex);
-      if (col.empty()) {
-        batch->notNull[i] = 0;
-        hasNull = true;
-      } else {
-        batch->notNull[i] = 1;
-        std::transform(col.begin(), col.end(), col.begin(), ::tolower);
-        boolBatch->data[i] = col == "true" || col == "t";
-      }
-    }
-    boolBatch->hasNulls = hasNull;
-    boolBatch->numElements = numValues;
-  }
-
-  // parse date string from format YYYY-mm-dd
-  void setDateTypeValue(const std::vector<std::string>& data,
-                        orc::ColumnVectorBatch* batch,
-                        uint64_t numValues,
-                        uint64_t colIndex)
-  {
-    auto* longBatch = dynamic_cast<orc::LongVectorBatch*>(batch);
-    bool hasNull = false;
-    for (uint64_t i = 0; i < numValues; ++i) {
-      std::string col = columnString(data[i], colIndex);
-      if (col.empty()) {
-        batch->notNull[i] = 0;
-        hasNull = true;
-      } else {
-        batch->notNull[i] = 1;
-        struct tm tm
-        {};
-        memset(&tm, 0, sizeof(struct tm));
-        strptime(col.c_str(), "%Y-%m-%d", &tm);
-        time_t t = mktime(&tm);
-        time_t t1970 = 0;
-        double seconds = difftime(t, t1970);
-        auto days = static_cast<int64_t>(seconds / (60 * 60 * 24));
-        longBatch->data[i] = days;
-      }
-    }
-    longBatch->hasNulls = hasNull;
-    longBatch->numElements = numValues;
-  }
-  void setTimestampTypeValue(const std::vector<std::string>& data,
-                             orc::ColumnVectorBatch* batch,
-                             uint64_t numValues,
-                             uint64_t colIndex)
-  {
-    struct tm timeStruct
-    {};
-    auto* tsBatch = dynamic_cast<orc::TimestampVectorBatch*>(batch);
-    bool hasNull = false;
-    for (uint64_t i = 0; i < numValues; ++i) {
-      std::string col = columnString(data[i], colIndex);
-      if (col.empty()) {
-        batch->notNull[i] = 0;
-        hasNull = true;
-      } else {
-        memset(&timeStruct, 0, sizeof(timeStruct));
-        char* left = strptime(col.c_str(), "%Y-%m-%d %H:%M:%S", &timeStruct);
-        if (left == nullptr) {
-          batch->notNull[i] = 0;
-        } else {
-          batch->notNull[i] = 1;
-          tsBatch->data[i] = timegm(&timeStruct);
-          char* tail;
-          double d = strtod(left, &tail);
-          if (tail != left) {
-            tsBatch->nanoseconds[i] = static_cast<long>(d * 1000000000.0);
-          } else {
-            tsBatch->nanoseconds[i] = 0;
-          }
-        }
-      }
-    }
-    tsBatch->hasNulls = hasNull;
-    tsBatch->numElements = numValues;
-  }
 
 protected:
   void Execute() override
@@ -547,10 +594,10 @@ protected:
     string line;
     vector<string> data;
     unique_ptr<ColumnVectorBatch> row = writer.writer->createRowBatch(1024);
-    DataBuffer<char> buffer(*getDefaultPool(), 4 * 1024 * 1024);
+    StringArena strings;
     while (!eof) {
       uint64_t valuesRead = 0;
-      uint64_t bufferOffset = 0;
+      strings.Clear();
       data.clear();
       memset(row->notNull.data(), 1, 1024);
       for (uint64_t i = 0; i < 1024; i++) {
@@ -561,60 +608,35 @@ protected:
         data.emplace_back(line);
         ++valuesRead;
       }
-      if (valuesRead > 0) {
-        auto batch = dynamic_cast<StructVectorBatch*>(row.get());
-        batch->numElements = valuesRead;
-        for (uint64_t i = 0; i < batch->fields.size(); i++) {
-          auto subType = writer.type->getSubtype(i);
-          switch (subType->getKind()) {
-            case BYTE:
-            case TypeKind::INT:
-            case SHORT:
-            case LONG:
-              setLongTypeValue(data, batch->fields[i], valuesRead, i);
-              break;
-            case TypeKind::STRING:
-            case TypeKind::VARCHAR:
-            case TypeKind::CHAR:
-            case TypeKind::BINARY:
-              setStringTypeValue(
-                data, batch->fields[i], valuesRead, i, buffer, bufferOffset);
-              break;
-
-            case TypeKind::FLOAT:
-            case TypeKind::DOUBLE:
-              setDoubleTypeValues(data, batch->fields[i], valuesRead, i);
-              break;
-
-            case TypeKind::BOOLEAN:
-              setBoolTypeValue(data, batch->fields[i], valuesRead, i);
-              break;
-
-            case TypeKind::DECIMAL:
-              setDecimalTypeValue(data,
-                                  batch->fields[i],
-                                  valuesRead,
-                                  i,
-                                  subType->getScale(),
-                                  subType->getPrecision());
-              break;
-
-            case TypeKind::TIMESTAMP:
-              setTimestampTypeValue(data, batch->fields[i], valuesRead, i);
-              break;
-            case TypeKind::DATE:
-              setDateTypeValue(data, batch->fields[i], valuesRead, i);
-              break;
-
-            case LIST:
-            case TypeKind::MAP:
-            case TypeKind::STRUCT:
-            case TypeKind::UNION:
-              SetError(subType->toString() + " is not yet supported");
-              break;
+      if (valuesRead == 0) {
+        continue;
+      }
+      auto batch = static_cast<StructVectorBatch*>(row.get());
+      for (uint64_t i = 0; i < batch->fields.size(); i++) {
+        auto fill = [&](auto& appender) {
+          for (uint64_t r = 0; r < valuesRead; r++) {
+            string csvCol = columnString(data[r], i);
+            // an empty field, or one that does not parse, is a null
+            if (csvCol.empty() || !appender.Parse(r, csvCol)) {
+              appender.SetNull(r);
+            }
           }
+          return true;
+        };
+        auto subType = writer.type->getSubtype(i);
+        try {
+          VisitAppender(*subType, *batch->fields[i], strings, fill);
+        } catch (std::invalid_argument&) {
+          SetError(subType->toString() + " is not yet supported");
+          return;
         }
-        writer.writer->add(*row);
+      }
+      SealBatch(*row, valuesRead);
+      if (!writer.encoder->Encode(*row)) {
+        const string failure = writer.encoder->Failure();
+        SetError(failure.empty() ? "The writer was closed during the import"
+                                 : failure);
+        return;
       }
     }
   }
@@ -627,13 +649,18 @@ protected:
 void
 Writer::ImportCSV(const CallbackInfo& info)
 {
+  if (!EnsureOpen(info.Env())) {
+    return;
+  }
   if (!writer) {
     Error::New(info.Env(), "A schema must be defined before importing csv data")
       .ThrowAsJavaScriptException();
+    return;
   }
   if (info.Length() < 2 || !info[0].IsString() || !info[1].IsFunction()) {
     Error::New(info.Env(), "File path and callback are required")
       .ThrowAsJavaScriptException();
+    return;
   }
   auto cb = info[1].As<Function>();
   auto worker = new ImportCSVWorker(cb, *this, info[0].As<String>());
@@ -648,6 +675,9 @@ Writer::Data(const CallbackInfo& info)
 void
 Writer::Merge(const CallbackInfo& info)
 {
+  if (!EnsureOpen(info.Env())) {
+    return;
+  }
   string filepath;
   Buffer<char> buffer;
   Function condition;
@@ -665,13 +695,11 @@ Writer::Merge(const CallbackInfo& info)
       Error::New(info.Env(), "File not found").ThrowAsJavaScriptException();
       return;
     }
-    reader = createReader(readFile(filepath), options);
+    reader = createReader(OpenInputFile(filepath), options);
   } else if(info[0].IsBuffer()) {
     buffer = info[0].As<Buffer<char>>();
-    unique_ptr<InputStream> input(
-      new MemoryReader(buffer.Data(), buffer.Length()));
     options.setMemoryPool(*getDefaultPool());
-    reader = createReader(std::move(input), options);
+    reader = OpenMemoryReader(buffer.Data(), buffer.Length(), options);
   } else {
     Error::New(info.Env(), "A string or Buffer was expected").ThrowAsJavaScriptException();
     return;
@@ -682,24 +710,29 @@ Writer::Merge(const CallbackInfo& info)
   }
   rowReader = reader->createRowReader(rowReaderOptions);
   batch = rowReader->createRowBatch(1024);
-  string line;
-  unique_ptr<ColumnPrinter> printer =
-    createColumnPrinter(line, &rowReader->getSelectedType());
+  RowBuffer rows(rowReader->getSelectedType());
+  auto keys = rows.Keys(info.Env());
+  auto names = Keys();
   while (rowReader->next(*batch)) {
-    printer->reset(*batch);
-    for (unsigned int i = 0; i < batch->numElements; i++) {
-      printer->printRow(i);
-      auto target = Napi::Object::New(info.Env());
-      LineToJSON(info.Env(), line, target);
-      bool skip = false;
+    HandleScope scope(info.Env());
+    rows.Clear();
+    rows.Append(*batch);
+    vector<Object> kept;
+    kept.reserve(rows.Size());
+    for (uint32_t i = 0; i < rows.Size(); i++) {
+      auto target = rows.Row(info.Env(), i, keys);
       if (hasCondition) {
         Napi::Value keep = condition.Call({ target });
-        skip = !keep.As<Boolean>();
-      }
-      if(!skip) {
-        AddObject(info, target);
+        if (!keep.As<Boolean>()) {
+          continue;
+        }
       }
-      line = "";
+      kept.emplace_back(target);
+    }
+    if (!AppendRows(info.Env(), kept.size(), [&](uint64_t row, size_t column) {
+          return kept[row].Get(names[column]);
+        })) {
+      return;
     }
   }
 }
@@ -5,6 +5,8 @@
 #ifndef NORC_WRITER_H
 #define NORC_WRITER_H
 
+#include "BatchEncoder.h"
+#include "Internal.h"
 #include <map>
 #include <napi.h>
 #include <orc/OrcFile.hh>
@@ -44,24 +46,83 @@ public:
   explicit Writer(const CallbackInfo&);
   ~Writer() = default;
 
+  /**
+   * Encode the last rows and close the file on a worker thread, calls back
+   * once done.
+   */
   void Close(const CallbackInfo&);
+  void CloseSync(const CallbackInfo&);
+  /**
+   * Queue the rows added so far and call back once every queued batch was
+   * encoded.
+   */
+  void Flush(const CallbackInfo&);
   void ImportCSV(const CallbackInfo&);
   void Schema(const CallbackInfo&);
+  /**
+   * Apply the options passed after the schema (bloomFilter, bloomFilterFpp),
+   * throws a JS exception and returns false when they are invalid.
+   */
+  bool ApplySchemaOptions(const CallbackInfo&);
   void Add(const CallbackInfo&);
-  void AddObject(const CallbackInfo&, Napi::Object);
+  /**
+   * Add a row given as an array of values in schema order.
+   */
+  void AddRow(const CallbackInfo&);
+  /**
+   * Add an array of rows given as arrays of values in schema order.
+   */
+  void AddRows(const CallbackInfo&);
+  /**
+   * Append count rows, get(row, column) returning the value of each cell, or
+   * an empty value when the row lacks the column. The rows are written a
+   * column at a time, through the typed appender of the column. Throws a JS
+   * exception and returns false on a value the column cannot hold or a
+   * missing one, once the rows before it were appended.
+   */
+  template<typename Get>
+  bool AppendRows(Napi::Env, uint64_t count, Get get);
+  /**
+   * Resolve the columns of the schema once: their kinds and a persistent JS
+   * string per title, so a row object costs one property lookup per column.
+   */
+  void CompileRowPlan(Napi::Env);
+  /**
+   * The keys of the row plan, valid in the current handle scope.
+   */
+  vector<napi_value> Keys() const;
+  /**
+   * Append whole columns at once, {title: values} with typed arrays (or
+   * arrays) of the same length for every column of the schema. Each batch
+   * field is filled by a bulk copy instead of a conversion per row object.
+   */
+  void AddColumns(const CallbackInfo&);
+  /**
+   * Queue the rows added so far that did not fill a batch yet for encoding,
+   * throws a JS exception and returns false when encoding failed.
+   */
+  bool FlushRows(Napi::Env);
+  /**
+   * Throws a JS exception and returns false once close or closeSync was
+   * called.
+   */
+  bool EnsureOpen(Napi::Env);
   Napi::Value Data(const CallbackInfo&);
   void Merge(const CallbackInfo&);
 
   unique_ptr<orc::OutputStream> output;
   unique_ptr<orc::Writer> writer;
   unique_ptr<orc::Type> type;
-  unique_ptr<orc::ColumnVectorBatch> batch;
+  // destroyed before writer, the batches it still holds are encoded first
+  unique_ptr<BatchEncoder> encoder;
   orc::WriterOptions options;
-  unique_ptr<orc::DataBuffer<char>> buffer;
   std::vector<std::pair<std::string, orc::TypeKind>> schema;
+  // title of every column of schema, in order
+  vector<Napi::Reference<Napi::String>> keys;
   uint64_t batchSize = 1024;
-  uint64_t bufferOffset = 0;
   uint64_t batchOffset = 0;
+  // set as soon as close or closeSync is called
+  bool closed = false;
 };
 }
 #endif // NORC_WRITER_H
@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <napi.h>
+#include "Cursor.h"
 #include "Writer.h"
 #include "Reader.h"
 
@@ -26,6 +27,7 @@ Napi::Object
 Init(Napi::Env env, Napi::Object target) {
     norc::Writer::Initialize(env, target);
     norc::Reader::Initialize(env, target);
+    norc::Cursor::Initialize(env, target);
     return target;
 }
 